@@ -3,7 +3,9 @@
 // found in the LICENSE file.
 
 #include <blkid/blkid.h>
+#include <dlfcn.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,16 +13,64 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "blkid_utils.h"
 #include "cgpt.h"
+#include "copy_utils.h"
 #include "vboot_host.h"
 
+/* Most signatures live near one end or the other of a device, so these
+ * regions are cleared outright. */
+#define WIPE_END_BYTES (1024 * 1024)
+
+#ifdef CGPT_DLOPEN
+
+#define BLKID_SONAME "libblkid.so.1"
+
+#define BLKID_DEFINE_SYMBOL(name) __typeof__(name) *sym_##name;
+BLKID_SYMBOLS(BLKID_DEFINE_SYMBOL)
+
+static pthread_once_t blkid_once = PTHREAD_ONCE_INIT;
+static int blkid_status = CGPT_FAILED;
+
+static void dlopen_blkid(void) {
+  void *lib = dlopen(BLKID_SONAME, RTLD_NOW | RTLD_LOCAL);
+
+  if (!lib) {
+    Error("%s\n", dlerror());
+    return;
+  }
+#define BLKID_LOAD_SYMBOL(name) \
+  if (!(sym_##name = dlsym(lib, #name))) { \
+    Error("%s\n", dlerror()); \
+    return; \
+  }
+  BLKID_SYMBOLS(BLKID_LOAD_SYMBOL)
+  blkid_status = CGPT_OK;
+}
+
+int load_blkid(void) {
+  pthread_once(&blkid_once, dlopen_blkid);
+  return blkid_status;
+}
+
+#else
+
+#define BLKID_DEFINE_SYMBOL(name) __typeof__(name) *sym_##name = name;
+BLKID_SYMBOLS(BLKID_DEFINE_SYMBOL)
+
+int load_blkid(void) {
+  return CGPT_OK;
+}
+
+#endif
+
 /* Find the device id for a given blkid_dev.
  * FIXME: libblkid already has this info but lacks a function to expose it.
  */
 static dev_t dev_to_devno(blkid_dev dev) {
   struct stat dev_stat;
 
-  if (stat(blkid_dev_devname(dev), &dev_stat) < 0)
+  if (stat(sym_blkid_dev_devname(dev), &dev_stat) < 0)
     return -1;
 
   if (!S_ISBLK(dev_stat.st_mode))
@@ -37,10 +87,10 @@ char * dev_to_wholedevname(blkid_dev dev) {
   if ((devno = dev_to_devno(dev)) < 0)
     return NULL;
 
-  if (blkid_devno_to_wholedisk(devno, NULL, 0, &whole) < 0)
+  if (sym_blkid_devno_to_wholedisk(devno, NULL, 0, &whole) < 0)
     return NULL;
 
-  return blkid_devno_to_devname(whole);
+  return sym_blkid_devno_to_devname(whole);
 }
 
 static int devno_to_partno(dev_t devno) {
@@ -100,27 +150,27 @@ int translate_partition_dev(char **devname, uint32_t *partition) {
   if (!S_ISBLK(dev_stat.st_mode))
     return CGPT_OK;
 
-  if (blkid_devno_to_wholedisk(dev_stat.st_rdev, NULL, 0, &whole_devno) < 0) {
-    Error("unable to map %s to a whole disk device\n", *devname);
-    return CGPT_FAILED;
-  }
-
-  /* Nothing to check or translate if we already have the whole disk */
-  if (dev_stat.st_rdev == whole_devno)
+  /* Nothing to check or translate if we already have the whole disk. Only
+   * partitions have a partition number, so libblkid isn't needed for that. */
+  if ((partno = devno_to_partno(dev_stat.st_rdev)) < 0)
     return CGPT_OK;
 
-  if ((partno = devno_to_partno(dev_stat.st_rdev)) < 0) {
-    Error("unable to look up partition number for %s\n", *devname);
-    return CGPT_FAILED;
-  }
-
   if (*partition && *partition != partno) {
     Error("device %s is partition %d but %d was specified\n",
           *devname, partno, *partition);
     return CGPT_FAILED;
   }
 
-  if ((whole_devname = blkid_devno_to_devname(whole_devno)) == NULL) {
+  if (CGPT_OK != load_blkid())
+    return CGPT_FAILED;
+
+  if (sym_blkid_devno_to_wholedisk(dev_stat.st_rdev, NULL, 0,
+                                   &whole_devno) < 0) {
+    Error("unable to map %s to a whole disk device\n", *devname);
+    return CGPT_FAILED;
+  }
+
+  if ((whole_devname = sym_blkid_devno_to_devname(whole_devno)) == NULL) {
     Error("unable to map %s to a whole disk device name\n", *devname);
     return CGPT_FAILED;
   }
@@ -130,3 +180,72 @@ int translate_partition_dev(char **devname, uint32_t *partition) {
   *partition = partno;
   return CGPT_OK;
 }
+
+/* Zero the sectors covering a signature blkid reported at a probe location.
+ * Returns 0 if there is no such signature, 1 if it was wiped, -1 on error. */
+static int wipe_magic(blkid_probe pr, int fd, uint64_t offset,
+                      uint32_t sector_bytes, const char *offset_name,
+                      const char *magic_name) {
+  const char *value, *magic;
+  size_t magic_len;
+  uint64_t start, end;
+
+  if (sym_blkid_probe_lookup_value(pr, offset_name, &value, NULL) < 0 ||
+      sym_blkid_probe_lookup_value(pr, magic_name, &magic, &magic_len) < 0)
+    return 0;
+
+  start = strtoull(value, NULL, 10);
+  end = start + magic_len;
+  start -= start % sector_bytes;
+  end += (sector_bytes - end % sector_bytes) % sector_bytes;
+  if (CGPT_OK != zero_range(fd, offset + start, end - start))
+    return -1;
+  return 1;
+}
+
+/* Clear any filesystem, RAID or partition table signatures from the size
+ * bytes at offset of fd, which must be a multiple of sector_bytes. */
+int wipe_signatures(int fd, uint64_t offset, uint64_t size,
+                    uint32_t sector_bytes) {
+  uint64_t ends = size < 2 * WIPE_END_BYTES ? size : WIPE_END_BYTES;
+  blkid_probe pr;
+  int r = CGPT_OK;
+
+  if (CGPT_OK != load_blkid())
+    return CGPT_FAILED;
+
+  if (CGPT_OK != zero_range(fd, offset, ends) ||
+      CGPT_OK != zero_range(fd, offset + size - ends, ends)) {
+    Error("Cannot wipe signatures: %s\n", strerror(errno));
+    return CGPT_FAILED;
+  }
+
+  // Whatever is left is further in, look for it.
+  if ((pr = sym_blkid_new_probe()) == NULL ||
+      sym_blkid_probe_set_device(pr, fd, offset, size) < 0) {
+    Error("unable to probe for signatures\n");
+    r = CGPT_FAILED;
+    goto out;
+  }
+  sym_blkid_probe_enable_superblocks(pr, 1);
+  sym_blkid_probe_set_superblocks_flags(pr, BLKID_SUBLKS_MAGIC |
+                                    BLKID_SUBLKS_BADCSUM);
+  sym_blkid_probe_enable_partitions(pr, 1);
+  sym_blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC);
+
+  while (sym_blkid_do_probe(pr) == 0) {
+    if (wipe_magic(pr, fd, offset, sector_bytes,
+                   "SBMAGIC_OFFSET", "SBMAGIC") < 0 ||
+        wipe_magic(pr, fd, offset, sector_bytes,
+                   "PTMAGIC_OFFSET", "PTMAGIC") < 0) {
+      Error("Cannot wipe signatures: %s\n", strerror(errno));
+      r = CGPT_FAILED;
+      break;
+    }
+  }
+
+out:
+  if (pr)
+    sym_blkid_free_probe(pr);
+  return r;
+}
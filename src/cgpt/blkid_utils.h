@@ -4,6 +4,34 @@
 
 #include <blkid/blkid.h>
 
+/* The parts of libblkid cgpt uses. They are called through sym_ pointers,
+ * which are only valid once load_blkid() has succeeded. */
+#define BLKID_SYMBOLS(X) \
+  X(blkid_dev_devname) \
+  X(blkid_devno_to_devname) \
+  X(blkid_devno_to_wholedisk) \
+  X(blkid_do_probe) \
+  X(blkid_free_probe) \
+  X(blkid_get_cache) \
+  X(blkid_get_dev) \
+  X(blkid_new_probe) \
+  X(blkid_probe_enable_partitions) \
+  X(blkid_probe_enable_superblocks) \
+  X(blkid_probe_lookup_value) \
+  X(blkid_probe_set_device) \
+  X(blkid_probe_set_partitions_flags) \
+  X(blkid_probe_set_superblocks_flags) \
+  X(blkid_put_cache)
+
+#define BLKID_DECLARE_SYMBOL(name) extern __typeof__(name) *sym_##name;
+BLKID_SYMBOLS(BLKID_DECLARE_SYMBOL)
+#undef BLKID_DECLARE_SYMBOL
+
+/* Load libblkid if it isn't already, returns CGPT_OK or CGPT_FAILED. */
+int load_blkid(void);
+
 char * dev_to_wholedevname(blkid_dev dev);
 int dev_to_partno(blkid_dev dev);
 int translate_partition_dev(char **devname, uint32_t *partition);
+int wipe_signatures(int fd, uint64_t offset, uint64_t size,
+                    uint32_t sector_bytes);
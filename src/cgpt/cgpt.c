@@ -9,7 +9,6 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
-#include <uuid/uuid.h>
 
 #include "cgpt.h"
 #include "vboot_host.h"
@@ -34,6 +33,18 @@ struct {
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
   {"resize", cmd_resize, "Find and resize a partition"},
+  {"move", cmd_move, "Move a partition's data to a new location"},
+  {"clone", cmd_clone, "Copy a partition's data into another partition"},
+  {"assemble", cmd_assemble, "Build a disk image from partition payloads"},
+  {"stamp", cmd_stamp, "Copy a table to many images with fresh GUIDs"},
+  {"dump", cmd_dump, "Print the partition table as a manifest"},
+  {"apply", cmd_apply, "Make the partition table match a manifest"},
+  {"backup", cmd_backup, "Save the GPT headers and tables to a file"},
+  {"restore", cmd_restore, "Write back GPT headers and tables from a backup"},
+  {"sync", cmd_sync, "Copy a golden table to many drives, sector by sector"},
+  {"watch", cmd_watch, "Report disks and partition tables as they change"},
+  {"audit", cmd_audit, "Check many images and report problems as JSON"},
+  {"rescue", cmd_rescue, "Propose a partition table from filesystems found"},
 };
 
 void Usage(void) {
@@ -56,7 +67,7 @@ int main(int argc, char *argv[]) {
   int match_count = 0;
   int match_index = 0;
 
-  uuid_generator = uuid_generate;
+  uuid_generator = GenerateUuid;
 
   progname = strrchr(argv[0], '/');
   if (progname)
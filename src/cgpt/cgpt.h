@@ -45,18 +45,62 @@ void PMBRToStr(struct pmbr *pmbr, char *str, unsigned int buflen);
 char *IsWholeDev(const char *basename);
 
 // Handle to the drive storing the GPT.
+/* A run of sectors, first and last inclusive like GptEntry. */
+struct drive_range {
+  uint64_t first;
+  uint64_t last;
+};
+
 struct drive {
   int fd;           /* file descriptor */
   uint64_t size;    /* total size (in bytes) */
   GptData gpt;
   struct pmbr pmbr;
+  struct drive_range *discard;  /* partitions to discard if freed, or NULL */
+  uint32_t num_discard;
+  uint32_t header_crc32[2];     /* of the header sectors as first read */
+  int locked;                   /* holds the drive's write lock */
+  int lock_status;              /* what DriveLockUnchanged() found */
 };
 
 
 /* mode should be O_RDONLY or O_RDWR */
 int DriveOpen(const char *drive_path, struct drive *drive,
               off_t min_size, int mode);
+/* Writes back whatever was modified, but only if the headers on the drive
+ * are still the ones DriveOpen() read, see DriveLockUnchanged(). */
 int DriveClose(struct drive *drive, int update_as_needed);
+/* Take an exclusive flock() on the drive, held until DriveClose(), and check
+ * that its headers haven't changed since DriveOpen(). Returns CGPT_OK,
+ * CGPT_CONFLICT if another program changed them, or CGPT_FAILED. Readers
+ * never take the lock, so they never wait for it. */
+int DriveLockUnchanged(struct drive *drive);
+/* Only take the lock, for writers that replace the table regardless. */
+int DriveLock(struct drive *drive);
+/* The PMBR and table as read from the drive, to compare changes against. */
+struct drive_snapshot {
+  struct pmbr pmbr;
+  uint8_t *primary_header;
+  uint8_t *primary_entries;
+  uint8_t *secondary_entries;
+  uint8_t *secondary_header;
+};
+void DriveSnapshot(const struct drive *drive, struct drive_snapshot *snap);
+void DriveSnapshotFree(struct drive_snapshot *snap);
+/* Called with each run of sectors DriveWriteChanged() writes, or would. */
+typedef void (*drive_run_fn)(void *ctx, const char *what, uint64_t lba,
+                             uint64_t sectors);
+/* Write the sectors of the PMBR and table that differ from 'old', one write
+ * per run of adjacent sectors, or with dry_run only count them. Adds the
+ * number of sectors to *count and passes each run to 'report' if it isn't
+ * NULL. The caller must hold the lock, see DriveLockUnchanged(). Returns
+ * CGPT_FAILED with errno set if a write fails. */
+int DriveWriteChanged(struct drive *drive, const struct drive_snapshot *old,
+                      int dry_run, uint32_t *count,
+                      drive_run_fn report, void *ctx);
+/* Remember the partitions in the current table so that DriveClose() can
+ * discard whatever space the updated table no longer uses. */
+int DriveTrackFreed(struct drive *drive);
 int CheckValid(const struct drive *drive);
 
 /* Constant global type values to compare against */
@@ -79,9 +123,12 @@ extern const Guid guid_coreos_resize;
 extern const Guid guid_coreos_rootfs;
 extern const Guid guid_mswin_data;
 
+int InitGpt(struct drive *drive);
 void InitPMBR(struct drive *drive, int secondary);
 void UpdatePMBR(struct drive *drive, int secondary);
 int ReadPMBR(struct drive *drive);
+/* Takes the write lock first, so may return CGPT_CONFLICT, see
+ * DriveLockUnchanged(). */
 int WritePMBR(struct drive *drive);
 
 /* Convert possibly unterminated UTF16 string to UTF8.
@@ -103,12 +150,43 @@ int UTF16ToUTF8(const uint16_t *utf16, unsigned int maxinput,
  */
 int UTF8ToUTF16(const uint8_t *utf8, uint16_t *utf16, unsigned int maxoutput);
 
-/* Helper functions for supported GPT types. */
-int ResolveType(const Guid *type, char *buf);
+/* Convert the label of a partition entry to UTF8 in buf, or set it from
+ * UTF8. Both return CGPT_OK or CGPT_FAILED as the converters above, and
+ * SetEntryLabel() leaves the entry alone on failure. */
+int EntryLabel(const GptEntry *entry, char *buf, size_t len);
+int SetEntryLabel(GptEntry *entry, const char *label);
+
+/* Print a label in double quotes, escaping it for the manifest format of
+ * "cgpt dump" or for JSON. */
+void PrintQuoted(const char *str, int json);
+
+/* What cgpt does with a partition of a given type. */
+enum cgpt_type {
+  CGPT_TYPE_UNKNOWN = 0,        // not a known type
+  CGPT_TYPE_UNUSED,             // the entry is empty
+  CGPT_TYPE_KERNEL,             // ChromeOS kernel
+  CGPT_TYPE_ROOT,               // CoreOS root, chosen by next and prioritize
+  CGPT_TYPE_RESIZE,             // CoreOS auto-resize
+  CGPT_TYPE_OTHER,              // any other known type
+};
+
+/* Helper functions for supported GPT types. The built-in types may be
+ * extended by the file named in $CGPT_TYPES, or /etc/cgpt/types.
+ *
+ * ClassifyType() also points *description at the name of a known type, or
+ * at NULL, unless description is NULL. */
+enum cgpt_type ClassifyType(const Guid *type, const char **description);
 int SupportedType(const char *name, Guid *type);
 void PrintTypes(void);
 void EntryDetails(GptEntry *entry, uint32_t index, int raw);
 
+/* The digest printed by "cgpt show --fingerprint", as 16 hex digits. */
+#define FINGERPRINT_STRLEN 17
+void DriveFingerprint(struct drive *drive, char *buf);
+
+// Names of the CGPT_FIELD_* values, as used by "cgpt show --fields".
+extern const char *const show_field_names[];
+
 uint32_t GetNumberOfEntries(const struct drive *drive);
 GptEntry *GetEntry(GptData *gpt, int secondary, uint32_t entry_index);
 void SetLegacyBootable(struct drive *drive, int secondary,
@@ -143,6 +221,13 @@ extern const char* progname;
 extern const char* command;
 void Error(const char *format, ...);
 
+/* Work through count items with up to jobs threads running fn(arg), or one
+ * per CPU if jobs is 0. fn takes the items from a counter shared through
+ * arg, so however many threads start, the last ones finish the list. Runs
+ * fn in the calling thread if one is enough or none can be started. */
+void RunWorkers(uint32_t jobs, uint64_t count, void *(*fn)(void *),
+                void *arg);
+
 // The code paths that require uuid_generate are not used currently in
 // libcgpt-cc.a so using this method would create an unnecessary dependency
 // on libuuid which then requires us to build it for 32-bit for the static
@@ -150,6 +235,11 @@ void Error(const char *format, ...);
 // set to uuid_generate in case of the cgpt binary and can be null or some
 // no-op method in case of ilbcgpt-cc.a.
 extern void (*uuid_generator)(uint8_t* buffer);
+/* What the cgpt binary sets uuid_generator to: uuid_generate() from
+ * libuuid, loaded on first use, or RandomGuids() if it can't be. */
+void GenerateUuid(uint8_t *buffer);
+/* Fill guids with random version 4 GUIDs from getrandom(). */
+int RandomGuids(Guid *guids, uint32_t count);
 
 // Command functions.
 int cmd_show(int argc, char *argv[]);
@@ -162,6 +252,18 @@ int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
 int cmd_next(int argc, char *argv[]);
 int cmd_resize(int argc, char *argv[]);
+int cmd_move(int argc, char *argv[]);
+int cmd_clone(int argc, char *argv[]);
+int cmd_assemble(int argc, char *argv[]);
+int cmd_stamp(int argc, char *argv[]);
+int cmd_dump(int argc, char *argv[]);
+int cmd_apply(int argc, char *argv[]);
+int cmd_backup(int argc, char *argv[]);
+int cmd_restore(int argc, char *argv[]);
+int cmd_sync(int argc, char *argv[]);
+int cmd_watch(int argc, char *argv[]);
+int cmd_audit(int argc, char *argv[]);
+int cmd_rescue(int argc, char *argv[]);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
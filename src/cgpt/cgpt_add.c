@@ -9,6 +9,7 @@
 
 #define _STUB_IMPLEMENTATION_
 
+#include "blkid_utils.h"
 #include "cgpt.h"
 #include "cgpt_params.h"
 #include "cgptlib_internal.h"
@@ -71,6 +72,35 @@ static const char* DumpCgptAddParams(const CgptAddParams *params) {
   return buf;
 }
 
+/* Clear signatures from the sectors entry covers but old didn't. A new
+ * partition is wiped whole, an existing one only where it was moved or
+ * grown to, so the data it already holds is left alone. */
+static int WipeNewSectors(struct drive *drive, const GptEntry *old,
+                          const GptEntry *entry) {
+  uint64_t bytes = drive->gpt.sector_bytes;
+  uint64_t first = entry->starting_lba, last = entry->ending_lba;
+  uint64_t end;
+
+  if (GuidIsZero(&old->type))
+    return wipe_signatures(drive->fd, first * bytes,
+                           (last - first + 1) * bytes, bytes);
+
+  if (first < old->starting_lba) {
+    end = last < old->starting_lba ? last : old->starting_lba - 1;
+    if (CGPT_OK != wipe_signatures(drive->fd, first * bytes,
+                                   (end - first + 1) * bytes, bytes))
+      return CGPT_FAILED;
+  }
+  if (last > old->ending_lba) {
+    if (first <= old->ending_lba)
+      first = old->ending_lba + 1;
+    if (CGPT_OK != wipe_signatures(drive->fd, first * bytes,
+                                   (last - first + 1) * bytes, bytes))
+      return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
 // This is the implementation-specific helper function.
 static int GptSetEntryAttributes(struct drive *drive,
                                  uint32_t index,
@@ -94,8 +124,7 @@ static int GptSetEntryAttributes(struct drive *drive,
   if (params->set_type)
     memcpy(&entry->type, &params->type_guid, sizeof(Guid));
   if (params->label) {
-    if (CGPT_OK != UTF8ToUTF16((uint8_t *)params->label, entry->name,
-                               sizeof(entry->name) / sizeof(entry->name[0]))) {
+    if (CGPT_OK != SetEntryLabel(entry, params->label)) {
       Error("The label cannot be converted to UTF16.\n");
       return -1;
     }
@@ -300,6 +329,9 @@ int CgptAdd(CgptAddParams *params) {
     goto bad;
   }
 
+  if (params->discard && CGPT_OK != DriveTrackFreed(&drive))
+    goto bad;
+
   entry = GetEntry(&drive.gpt, PRIMARY, index);
   memcpy(&backup, entry, sizeof(backup));
 
@@ -323,11 +355,19 @@ int CgptAdd(CgptAddParams *params) {
   }
 
   UpdatePMBR(&drive, PRIMARY);
-  if (WritePMBR(&drive) != CGPT_OK) {
-    Error("Failed to write legacy MBR.\n");
-    goto bad;
+  if ((rv = WritePMBR(&drive)) != CGPT_OK) {
+    if (rv != CGPT_CONFLICT)
+      Error("Failed to write legacy MBR.\n");
+    DriveClose(&drive, 0);
+    return rv;
   }
 
+  // Clear stale signatures before the new table can make them visible.
+  // WritePMBR() has locked the drive and found the table unchanged, so
+  // nothing is wiped for a table that won't be written.
+  if (params->wipe && CGPT_OK != WipeNewSectors(&drive, &backup, entry))
+    goto bad;
+
   // Write it all out.
   return DriveClose(&drive, 1);
 
@@ -0,0 +1,347 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "vboot_host.h"
+
+typedef struct ManifestPart {
+  int present;
+  uint64_t start;
+  uint64_t size;
+  Guid type;
+  Guid unique;
+  int set_unique;
+  uint64_t attrs;
+  int set_attrs;
+  char label[GPT_PARTNAME_LEN];
+  int set_label;
+} ManifestPart;
+
+typedef struct Manifest {
+  Guid disk_guid;
+  int set_disk_guid;
+  ManifestPart parts[MAX_NUMBER_OF_ENTRIES];
+} Manifest;
+
+/* Split the next KEY=VALUE pair off *pos, undoing the quoting done by
+ * "cgpt dump". Returns 1 for a pair, 0 at the end of the line and -1 if
+ * the line is malformed. */
+static int NextPair(char **pos, char **key, char *value, size_t size) {
+  char *p = *pos;
+  size_t n = 0;
+  int c;
+
+  while (isspace((unsigned char)*p))
+    p++;
+  if (!*p)
+    return 0;
+
+  *key = p;
+  while (*p && *p != '=' && !isspace((unsigned char)*p))
+    p++;
+  if (*p != '=')
+    return -1;
+  *p++ = '\0';
+
+  if (*p == '"') {
+    for (p++; *p != '"'; value[n++] = c) {
+      if (!*p || n + 1 >= size)
+        return -1;
+      c = (unsigned char)*p++;
+      if (c != '\\')
+        continue;
+      if (*p == '"' || *p == '\\') {
+        c = (unsigned char)*p++;
+      } else if (p[0] == 'x' && isxdigit((unsigned char)p[1]) &&
+                 isxdigit((unsigned char)p[2])) {
+        char hex[3] = { p[1], p[2], '\0' };
+        c = (int)strtoul(hex, NULL, 16);
+        p += 3;
+      } else {
+        return -1;
+      }
+    }
+    p++;
+  } else {
+    while (*p && !isspace((unsigned char)*p)) {
+      if (n + 1 >= size)
+        return -1;
+      value[n++] = *p++;
+    }
+  }
+  value[n] = '\0';
+  *pos = p;
+  return 1;
+}
+
+static int ParsePartLine(char *line, ManifestPart *part) {
+  char *key, value[GPT_PARTNAME_LEN], *e;
+  int set_start = 0, set_size = 0, set_type = 0, rv;
+
+  while ((rv = NextPair(&line, &key, value, sizeof(value))) > 0) {
+    e = NULL;
+    if (!strcmp(key, "start")) {
+      part->start = strtoull(value, &e, 0);
+      set_start = 1;
+    } else if (!strcmp(key, "size")) {
+      part->size = strtoull(value, &e, 0);
+      set_size = 1;
+    } else if (!strcmp(key, "type")) {
+      if (CGPT_OK != SupportedType(value, &part->type) &&
+          CGPT_OK != StrToGuid(value, &part->type))
+        return CGPT_FAILED;
+      set_type = 1;
+    } else if (!strcmp(key, "guid")) {
+      if (CGPT_OK != StrToGuid(value, &part->unique))
+        return CGPT_FAILED;
+      part->set_unique = 1;
+    } else if (!strcmp(key, "attrs")) {
+      part->attrs = strtoull(value, &e, 0);
+      part->set_attrs = 1;
+    } else if (!strcmp(key, "label")) {
+      strcpy(part->label, value);
+      part->set_label = 1;
+    } else {
+      Error("unknown key \"%s\"\n", key);
+      return CGPT_FAILED;
+    }
+    if (e && (*e || e == value))
+      return CGPT_FAILED;
+  }
+  if (rv < 0 || !set_start || !set_size || !set_type || !part->size ||
+      GuidIsZero(&part->type))
+    return CGPT_FAILED;
+  return CGPT_OK;
+}
+
+static int ReadManifest(FILE *fp, const char *name, Manifest *manifest) {
+  char *line = NULL, *p, *e;
+  size_t len = 0;
+  ssize_t n;
+  unsigned long num;
+  int lineno = 0, result = CGPT_FAILED;
+
+  while ((n = getline(&line, &len, fp)) >= 0) {
+    lineno++;
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+      line[--n] = '\0';
+    for (p = line; isspace((unsigned char)*p); p++)
+      ;
+    if (!*p || *p == '#')
+      continue;
+
+    if (!strncmp(p, "disk-guid:", 10)) {
+      for (p += 10; isspace((unsigned char)*p); p++)
+        ;
+      if (CGPT_OK != StrToGuid(p, &manifest->disk_guid)) {
+        Error("%s:%d: invalid disk GUID\n", name, lineno);
+        goto out;
+      }
+      manifest->set_disk_guid = 1;
+      continue;
+    }
+
+    num = strtoul(p, &e, 10);
+    if (e == p || *e != ':' || num < 1 || num > MAX_NUMBER_OF_ENTRIES) {
+      Error("%s:%d: expected a partition number\n", name, lineno);
+      goto out;
+    }
+    if (manifest->parts[num - 1].present) {
+      Error("%s:%d: partition %lu is listed twice\n", name, lineno, num);
+      goto out;
+    }
+    if (CGPT_OK != ParsePartLine(e + 1, &manifest->parts[num - 1])) {
+      Error("%s:%d: invalid partition %lu\n", name, lineno, num);
+      goto out;
+    }
+    manifest->parts[num - 1].present = 1;
+  }
+  if (ferror(fp)) {
+    Error("Can't read %s: %s\n", name, strerror(errno));
+    goto out;
+  }
+  result = CGPT_OK;
+
+out:
+  free(line);
+  return result;
+}
+
+/* Rewrite the primary entry at index to match the manifest. A partition that
+ * is new to the table gets a fresh GUID and no attributes or label unless the
+ * manifest gives them. */
+static int ApplyPart(struct drive *drive, uint32_t index, ManifestPart *part) {
+  GptEntry *entry = GetEntry(&drive->gpt, PRIMARY, index);
+  int fresh = GuidIsZero(&entry->type);
+
+  if (!part->present) {
+    memset(entry, 0, sizeof(*entry));
+    return CGPT_OK;
+  }
+
+  memcpy(&entry->type, &part->type, sizeof(Guid));
+  entry->starting_lba = part->start;
+  entry->ending_lba = part->start + part->size - 1;
+  if (part->set_unique) {
+    memcpy(&entry->unique, &part->unique, sizeof(Guid));
+  } else if (fresh) {
+    if (!uuid_generator) {
+      Error("Unable to generate new GUID. uuid_generator not set.\n");
+      return CGPT_FAILED;
+    }
+    (*uuid_generator)((uint8_t *)&entry->unique);
+  }
+  if (part->set_attrs)
+    entry->attrs.whole = part->attrs;
+  else if (fresh)
+    entry->attrs.whole = 0;
+  if (part->set_label) {
+    if (CGPT_OK != SetEntryLabel(entry, part->label)) {
+      Error("The label of partition %d cannot be converted to UTF16.\n",
+            index + 1);
+      return CGPT_FAILED;
+    }
+  } else if (fresh) {
+    memset(entry->name, 0, sizeof(entry->name));
+  }
+  return CGPT_OK;
+}
+
+int CgptApply(CgptApplyParams *params) {
+  struct drive drive;
+  Manifest *manifest;
+  GptHeader *header;
+  GptEntry *entry, *old = NULL;
+  FILE *fp;
+  const char *name;
+  uint32_t i, max_part;
+  int gpt_retval, rv, changed = 0, result = CGPT_FAILED;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  manifest = calloc(1, sizeof(*manifest));
+  require(manifest);
+  if (!params->manifest || !strcmp(params->manifest, "-")) {
+    fp = stdin;
+    name = "<stdin>";
+  } else if (!(fp = fopen(params->manifest, "r"))) {
+    Error("Can't open %s: %s\n", params->manifest, strerror(errno));
+    free(manifest);
+    return CGPT_FAILED;
+  } else {
+    name = params->manifest;
+  }
+  rv = ReadManifest(fp, name, manifest);
+  if (fp != stdin)
+    fclose(fp);
+  if (CGPT_OK != rv) {
+    free(manifest);
+    return CGPT_FAILED;
+  }
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0,
+                           params->dry_run ? O_RDONLY : O_RDWR)) {
+    free(manifest);
+    return CGPT_FAILED;
+  }
+
+  if (CGPT_OK != ReadPMBR(&drive)) {
+    Error("Unable to read PMBR\n");
+    goto bad;
+  }
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+  if (((drive.gpt.valid_headers & MASK_BOTH) != MASK_BOTH) ||
+      ((drive.gpt.valid_entries & MASK_BOTH) != MASK_BOTH)) {
+    Error("one of the GPT header/entries is invalid.\n"
+          "please run 'cgpt repair' before applying a manifest.\n");
+    goto bad;
+  }
+
+  max_part = GetNumberOfEntries(&drive);
+  for (i = max_part; i < MAX_NUMBER_OF_ENTRIES; i++) {
+    if (manifest->parts[i].present) {
+      Error("invalid partition number: %d\n", i + 1);
+      goto bad;
+    }
+  }
+
+  // Build the new table in place, keeping the old one to compare against.
+  old = malloc(TOTAL_ENTRIES_SIZE);
+  require(old);
+  memcpy(old, drive.gpt.primary_entries, TOTAL_ENTRIES_SIZE);
+
+  header = (GptHeader *)drive.gpt.primary_header;
+  if (manifest->set_disk_guid &&
+      !GuidEqual(&header->disk_uuid, &manifest->disk_guid)) {
+    memcpy(&header->disk_uuid, &manifest->disk_guid, sizeof(Guid));
+    if (params->verbose)
+      printf("disk GUID changed\n");
+    changed = 1;
+  }
+
+  for (i = 0; i < max_part; i++) {
+    if (CGPT_OK != ApplyPart(&drive, i, &manifest->parts[i]))
+      goto bad;
+    entry = GetEntry(&drive.gpt, PRIMARY, i);
+    if (!memcmp(entry, &old[i], sizeof(*entry)))
+      continue;
+    if (params->verbose)
+      printf("partition %d %s\n", i + 1,
+             GuidIsZero(&old[i].type) ? "added" :
+             GuidIsZero(&entry->type) ? "removed" : "changed");
+    changed = 1;
+  }
+
+  if (!changed) {
+    if (params->verbose || params->dry_run)
+      printf("%s already matches the manifest\n", params->drive_name);
+    result = CGPT_OK;
+    goto bad;
+  }
+
+  UpdateAllEntries(&drive);
+
+  rv = CheckEntries((GptEntry*)drive.gpt.primary_entries,
+                    (GptHeader*)drive.gpt.primary_header);
+  if (0 != rv) {
+    Error("%s\n", GptErrorText(rv));
+    goto bad;
+  }
+
+  if (params->dry_run) {
+    printf("%s would be updated\n", params->drive_name);
+    result = CGPT_OK;
+    goto bad;
+  }
+
+  UpdatePMBR(&drive, PRIMARY);
+  if ((rv = WritePMBR(&drive)) != CGPT_OK) {
+    if (rv != CGPT_CONFLICT)
+      Error("Failed to write legacy MBR.\n");
+    result = rv;
+    goto bad;
+  }
+
+  free(old);
+  free(manifest);
+  // Write it all out.
+  return DriveClose(&drive, 1);
+
+bad:
+  free(old);
+  free(manifest);
+  DriveClose(&drive, 0);
+  return result;
+}
@@ -0,0 +1,412 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "copy_utils.h"
+#include "vboot_host.h"
+
+#define ASSEMBLE_SECTOR_BYTES 512
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* Where the image goes. Seekable outputs get holes for runs of zeros, pipes
+ * and the like get everything written out in order. */
+struct sink {
+  int fd;
+  int seekable;
+  int pipe;
+  int offload;        /* the kernel can copy into fd */
+  uint64_t pos;
+  uint8_t *buf;       /* COPY_CHUNK_BYTES, zeroed unless copying */
+};
+
+static int SinkWrite(struct sink *sink, const uint8_t *buf, size_t len) {
+  while (len) {
+    ssize_t n = sink->seekable ? pwrite(sink->fd, buf, len, sink->pos)
+                               : write(sink->fd, buf, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      Error("Cannot write image at offset %llu: %s\n",
+            (unsigned long long)sink->pos, strerror(errno));
+      return CGPT_FAILED;
+    }
+    buf += n;
+    len -= n;
+    sink->pos += n;
+  }
+  return CGPT_OK;
+}
+
+static int SinkZeros(struct sink *sink, uint64_t len) {
+  if (sink->seekable) {
+    sink->pos += len;
+    return CGPT_OK;
+  }
+  while (len) {
+    size_t n = MIN(len, COPY_CHUNK_BYTES);
+    if (CGPT_OK != SinkWrite(sink, sink->buf, n))
+      return CGPT_FAILED;
+    len -= n;
+  }
+  return CGPT_OK;
+}
+
+/* Let the kernel move the data if it can: copy_file_range() into files and
+ * splice() into pipes. Returns the bytes copied, 0 at the end of the
+ * payload, or -1 on error. Clears sink->offload and returns 0 if the caller
+ * has to copy the data itself. */
+static ssize_t SinkOffload(struct sink *sink, int in_fd, uint64_t offset,
+                           uint64_t len) {
+  loff_t in_off = offset, out_off = sink->pos;
+  ssize_t n;
+
+  if (!sink->seekable && !sink->pipe) {
+    sink->offload = 0;
+    return 0;
+  }
+
+  do {
+    if (sink->seekable)
+      n = copy_file_range(in_fd, &in_off, sink->fd, &out_off, len, 0);
+    else
+      n = splice(in_fd, &in_off, sink->fd, NULL, len, SPLICE_F_MORE);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                errno == EOPNOTSUPP)) {
+    sink->offload = 0;
+    return 0;
+  }
+  if (n < 0)
+    Error("Cannot copy payload into image: %s\n", strerror(errno));
+  return n;
+}
+
+static int SinkCopy(struct sink *sink, int in_fd, uint64_t offset,
+                    uint64_t len) {
+  int buffered = 0;
+
+  while (len) {
+    ssize_t n = 0;
+
+    if (sink->offload) {
+      n = SinkOffload(sink, in_fd, offset, len);
+      if (n < 0)
+        return CGPT_FAILED;
+      if (n == 0 && sink->offload) {
+        Error("Cannot read payload at offset %llu: unexpected end of file\n",
+              (unsigned long long)offset);
+        return CGPT_FAILED;
+      }
+      sink->pos += n;
+    }
+
+    if (!sink->offload) {
+      buffered = 1;
+      n = pread(in_fd, sink->buf, MIN(len, COPY_CHUNK_BYTES), offset);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        Error("Cannot read payload at offset %llu: %s\n",
+              (unsigned long long)offset, n ? strerror(errno) : "end of file");
+        return CGPT_FAILED;
+      }
+      if (CGPT_OK != SinkWrite(sink, sink->buf, n))
+        return CGPT_FAILED;
+    }
+
+    offset += n;
+    len -= n;
+  }
+
+  if (buffered)
+    memset(sink->buf, 0, COPY_CHUNK_BYTES);
+  return CGPT_OK;
+}
+
+/* Stream len bytes of the payload, turning its holes into zeros. */
+static int SinkPayload(struct sink *sink, int in_fd, uint64_t len) {
+  uint64_t pos = 0;
+
+  while (pos < len) {
+    uint64_t start = pos, stop;
+
+    find_data(in_fd, &start, &stop, len);
+    if (CGPT_OK != SinkZeros(sink, start - pos))
+      return CGPT_FAILED;
+    if (start == len)
+      break;
+    if (CGPT_OK != SinkCopy(sink, in_fd, start, stop - start))
+      return CGPT_FAILED;
+    pos = stop;
+  }
+  return CGPT_OK;
+}
+
+static int OpenSink(struct sink *sink, const char *output) {
+  struct stat st;
+
+  memset(sink, 0, sizeof(*sink));
+  if (output && strcmp(output, "-")) {
+    sink->fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0666);
+    if (sink->fd < 0) {
+      Error("Can't open %s: %s\n", output, strerror(errno));
+      return CGPT_FAILED;
+    }
+  } else {
+    sink->fd = STDOUT_FILENO;
+  }
+
+  if (fstat(sink->fd, &st) < 0) {
+    Error("Can't fstat output: %s\n", strerror(errno));
+    return CGPT_FAILED;
+  }
+  // Appending ignores the offsets given to pwrite().
+  sink->seekable = S_ISREG(st.st_mode) &&
+                   !(fcntl(sink->fd, F_GETFL) & O_APPEND);
+  sink->pipe = S_ISFIFO(st.st_mode);
+  sink->offload = sink->seekable || sink->pipe;
+  if (sink->seekable)
+    sink->pos = lseek(sink->fd, 0, SEEK_CUR);
+
+  sink->buf = calloc(1, COPY_CHUNK_BYTES);
+  if (!sink->buf) {
+    Error("Cannot allocate output buffer\n");
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+static int CloseSink(struct sink *sink, const char *output) {
+  int r = CGPT_OK;
+
+  if (sink->seekable && fsync(sink->fd) < 0) {
+    Error("Cannot flush image: %s\n", strerror(errno));
+    r = CGPT_FAILED;
+  }
+  if (output && strcmp(output, "-") && close(sink->fd) < 0) {
+    Error("Cannot close %s: %s\n", output, strerror(errno));
+    r = CGPT_FAILED;
+  }
+  free(sink->buf);
+  return r;
+}
+
+/* A partition together with its opened payload. */
+struct payload {
+  CgptAssemblePart *part;
+  int fd;             /* -1 if there is no payload */
+  uint64_t len;
+};
+
+static int ComparePayloads(const void *a, const void *b) {
+  const struct payload *x = a, *y = b;
+  if (x->part->begin != y->part->begin)
+    return x->part->begin < y->part->begin ? -1 : 1;
+  return 0;
+}
+
+static void FreeTable(struct drive *drive) {
+  free(drive->gpt.primary_header);
+  free(drive->gpt.primary_entries);
+  free(drive->gpt.secondary_header);
+  free(drive->gpt.secondary_entries);
+}
+
+/* Build the partition table for the image in memory, the same way create
+ * and add would on a real disk. */
+static int BuildTable(CgptAssembleParams *params, struct drive *drive,
+                      struct payload *payloads) {
+  uint32_t i;
+  int gpt_retval;
+
+  drive->fd = -1;
+  drive->gpt.sector_bytes = ASSEMBLE_SECTOR_BYTES;
+  drive->gpt.drive_sectors = params->size;
+  drive->size = params->size * ASSEMBLE_SECTOR_BYTES;
+  drive->gpt.primary_header = calloc(GPT_HEADER_SECTOR, ASSEMBLE_SECTOR_BYTES);
+  drive->gpt.secondary_header = calloc(GPT_HEADER_SECTOR,
+                                       ASSEMBLE_SECTOR_BYTES);
+  drive->gpt.primary_entries = calloc(GPT_ENTRIES_SECTORS,
+                                      ASSEMBLE_SECTOR_BYTES);
+  drive->gpt.secondary_entries = calloc(GPT_ENTRIES_SECTORS,
+                                        ASSEMBLE_SECTOR_BYTES);
+  require(drive->gpt.primary_header && drive->gpt.secondary_header &&
+          drive->gpt.primary_entries && drive->gpt.secondary_entries);
+  drive->gpt.modified |= (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1 |
+                          GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2);
+
+  if (CGPT_OK != InitGpt(drive))
+    return CGPT_FAILED;
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive->gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    return CGPT_FAILED;
+  }
+
+  for (i = 0; i < params->num_parts; i++) {
+    CgptAssemblePart *part = payloads[i].part;
+    uint64_t need = (payloads[i].len + ASSEMBLE_SECTOR_BYTES - 1) /
+                    ASSEMBLE_SECTOR_BYTES;
+    GptEntry *entry;
+
+    if (part->partition == 0 ||
+        part->partition > GetNumberOfEntries(drive)) {
+      Error("invalid partition number: %d\n", part->partition);
+      return CGPT_FAILED;
+    }
+    if (!IsUnused(drive, PRIMARY, part->partition - 1)) {
+      Error("partition %d is given more than once\n", part->partition);
+      return CGPT_FAILED;
+    }
+    if (GuidIsZero(&part->type_guid)) {
+      Error("partition %d must have a type other than \"unused\"\n",
+            part->partition);
+      return CGPT_FAILED;
+    }
+    if (!part->size)
+      part->size = need;
+    if (!part->size) {
+      Error("partition %d needs a size or a payload\n", part->partition);
+      return CGPT_FAILED;
+    }
+    if (need > part->size) {
+      Error("%s does not fit in partition %d\n", part->payload,
+            part->partition);
+      return CGPT_FAILED;
+    }
+
+    entry = GetEntry(&drive->gpt, PRIMARY, part->partition - 1);
+    memcpy(&entry->type, &part->type_guid, sizeof(Guid));
+    (*uuid_generator)((uint8_t *)&entry->unique);
+    entry->starting_lba = part->begin;
+    entry->ending_lba = part->begin + part->size - 1;
+    if (part->label && CGPT_OK != SetEntryLabel(entry, part->label)) {
+      Error("The label cannot be converted to UTF16.\n");
+      return CGPT_FAILED;
+    }
+  }
+
+  UpdateAllEntries(drive);
+  gpt_retval = CheckEntries((GptEntry*)drive->gpt.primary_entries,
+                            (GptHeader*)drive->gpt.primary_header);
+  if (gpt_retval != GPT_SUCCESS) {
+    Error("%s\n", GptErrorText(gpt_retval));
+    return CGPT_FAILED;
+  }
+
+  InitPMBR(drive, PRIMARY);
+  return CGPT_OK;
+}
+
+int CgptAssemble(CgptAssembleParams *params) {
+  struct drive drive;
+  struct sink sink;
+  struct payload *payloads;
+  int sink_open = 0;
+  int retval = CGPT_FAILED;
+  uint64_t base, end;
+  uint32_t i;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  if (params->size < 1 + 2 * (GPT_HEADER_SECTOR + GPT_ENTRIES_SECTORS)) {
+    Error("disk size of %llu sectors is too small\n",
+          (unsigned long long)params->size);
+    return CGPT_FAILED;
+  }
+
+  memset(&drive, 0, sizeof(drive));
+  payloads = calloc(params->num_parts + 1, sizeof(*payloads));
+  require(payloads);
+
+  // Open everything up front so a missing payload doesn't leave a partial
+  // image behind.
+  for (i = 0; i < params->num_parts; i++) {
+    payloads[i].part = &params->parts[i];
+    payloads[i].fd = -1;
+  }
+  for (i = 0; i < params->num_parts; i++) {
+    const char *path = payloads[i].part->payload;
+    off_t len;
+
+    if (!path)
+      continue;
+    if ((payloads[i].fd = open(path, O_RDONLY | O_LARGEFILE)) < 0) {
+      Error("Can't open %s: %s\n", path, strerror(errno));
+      goto out;
+    }
+    if ((len = lseek(payloads[i].fd, 0, SEEK_END)) < 0) {
+      Error("Can't size %s: %s\n", path, strerror(errno));
+      goto out;
+    }
+    payloads[i].len = len;
+  }
+
+  if (CGPT_OK != BuildTable(params, &drive, payloads))
+    goto out;
+
+  if (CGPT_OK != OpenSink(&sink, params->output))
+    goto out;
+  sink_open = 1;
+  base = sink.pos;
+
+  // Stream the image in disk order: PMBR, primary GPT, partitions with the
+  // gaps between them, then the backup GPT.
+  require(sizeof(drive.pmbr) == ASSEMBLE_SECTOR_BYTES);
+  if (CGPT_OK != SinkWrite(&sink, (uint8_t *)&drive.pmbr,
+                           sizeof(drive.pmbr)) ||
+      CGPT_OK != SinkWrite(&sink, drive.gpt.primary_header,
+                           GPT_HEADER_SECTOR * ASSEMBLE_SECTOR_BYTES) ||
+      CGPT_OK != SinkWrite(&sink, drive.gpt.primary_entries,
+                           GPT_ENTRIES_SECTORS * ASSEMBLE_SECTOR_BYTES))
+    goto out;
+
+  qsort(payloads, params->num_parts, sizeof(*payloads), ComparePayloads);
+  for (i = 0; i < params->num_parts; i++) {
+    CgptAssemblePart *part = payloads[i].part;
+
+    if (payloads[i].fd < 0)
+      continue;
+    if (params->verbose)
+      fprintf(stderr, "Writing %s to partition %d\n", part->payload,
+              part->partition);
+    if (CGPT_OK != SinkZeros(&sink, base + part->begin * ASSEMBLE_SECTOR_BYTES
+                             - sink.pos) ||
+        CGPT_OK != SinkPayload(&sink, payloads[i].fd, payloads[i].len))
+      goto out;
+  }
+
+  end = base + (params->size - GPT_HEADER_SECTOR - GPT_ENTRIES_SECTORS) *
+        ASSEMBLE_SECTOR_BYTES;
+  if (CGPT_OK != SinkZeros(&sink, end - sink.pos) ||
+      CGPT_OK != SinkWrite(&sink, drive.gpt.secondary_entries,
+                           GPT_ENTRIES_SECTORS * ASSEMBLE_SECTOR_BYTES) ||
+      CGPT_OK != SinkWrite(&sink, drive.gpt.secondary_header,
+                           GPT_HEADER_SECTOR * ASSEMBLE_SECTOR_BYTES))
+    goto out;
+
+  retval = CGPT_OK;
+
+out:
+  if (sink_open && CGPT_OK != CloseSink(&sink, params->output))
+    retval = CGPT_FAILED;
+  for (i = 0; i < params->num_parts; i++)
+    if (payloads[i].fd >= 0)
+      close(payloads[i].fd);
+  free(payloads);
+  FreeTable(&drive);
+  return retval;
+}
@@ -0,0 +1,413 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "output_utils.h"
+#include "vboot_host.h"
+
+#define AUDIT_DEFAULT_ALIGNMENT 8   /* sectors, one 4 KiB physical block */
+
+enum audit_result {
+  AUDIT_OK,
+  AUDIT_PROBLEMS,
+  AUDIT_ERROR,
+  AUDIT_SKIPPED,
+};
+
+/* An image to audit. Files found by walking a directory are skipped if they
+ * can't hold a GPT, files named on the command line are reported. */
+struct audit_file {
+  char *path;
+  int found;
+};
+
+struct audit_job {
+  CgptAuditParams *params;
+  struct audit_file *files;
+  uint32_t num_files;
+  uint32_t capacity;
+  uint32_t next;              /* next file to audit, shared */
+  uint32_t counts[AUDIT_SKIPPED + 1];
+};
+
+/* One image's record, built up and then written in a single call so that
+ * records from different workers never interleave. */
+struct audit_record {
+  struct output out;
+  int problems;
+};
+
+static void AddFile(struct audit_job *job, const char *path, int found) {
+  if (job->num_files == job->capacity) {
+    job->capacity = job->capacity ? job->capacity * 2 : 64;
+    job->files = realloc(job->files, job->capacity * sizeof(*job->files));
+    require(job->files);
+  }
+  job->files[job->num_files].path = strdup(path);
+  require(job->files[job->num_files].path);
+  job->files[job->num_files].found = found;
+  job->num_files++;
+}
+
+static void RecordStart(struct audit_record *rec, const char *path) {
+  out_init(&rec->out, stdout);
+  rec->problems = 0;
+  out_str(&rec->out, "{\"path\":");
+  out_json_str(&rec->out, path);
+}
+
+static void RecordError(struct audit_record *rec, const char *format, ...) {
+  char msg[256];
+  va_list ap;
+
+  va_start(ap, format);
+  vsnprintf(msg, sizeof(msg), format, ap);
+  va_end(ap);
+  out_str(&rec->out, ",\"ok\":false,\"error\":");
+  out_json_str(&rec->out, msg);
+  out_str(&rec->out, "}\n");
+  out_flush(&rec->out);
+}
+
+static void Problem(struct audit_record *rec, const char *format, ...) {
+  char msg[256];
+  va_list ap;
+
+  va_start(ap, format);
+  vsnprintf(msg, sizeof(msg), format, ap);
+  va_end(ap);
+  out_char(&rec->out, rec->problems++ ? ',' : '[');
+  out_json_str(&rec->out, msg);
+}
+
+static const char *MaskName(uint32_t mask) {
+  switch (mask & MASK_BOTH) {
+  case MASK_BOTH: return "both";
+  case MASK_PRIMARY: return "primary";
+  case MASK_SECONDARY: return "secondary";
+  default: return "none";
+  }
+}
+
+static int CompareStart(const void *a, const void *b) {
+  const GptEntry *x = *(const GptEntry * const *)a;
+  const GptEntry *y = *(const GptEntry * const *)b;
+  if (x->starting_lba != y->starting_lba)
+    return x->starting_lba < y->starting_lba ? -1 : 1;
+  return 0;
+}
+
+/* Check the protective MBR against the table, the way UpdatePMBR() would
+ * have written it: a 0xee partition from LBA 1, covering the whole drive
+ * unless a legacy bootable partition makes it a hybrid MBR. */
+static void CheckPMBR(struct audit_record *rec, const struct pmbr *pmbr,
+                      GptData *gpt, GptEntry *entries) {
+  uint32_t max = gpt->drive_sectors <= UINT32_MAX ?
+                 gpt->drive_sectors - 1 : UINT32_MAX;
+  const struct legacy_partition *protective = NULL;
+  uint32_t i, j;
+
+  if (pmbr->sig[0] != 0x55 || pmbr->sig[1] != 0xaa) {
+    Problem(rec, "protective MBR has no boot signature");
+    return;
+  }
+  for (i = 0; i < ARRAY_COUNT(pmbr->part); i++)
+    if (pmbr->part[i].type == 0xee && le32toh(pmbr->part[i].f_lba) == 1)
+      protective = &pmbr->part[i];
+  if (!protective) {
+    Problem(rec, "protective MBR has no GPT partition at LBA 1");
+    return;
+  }
+
+  for (i = 0; i < ARRAY_COUNT(pmbr->part); i++) {
+    const struct legacy_partition *part = &pmbr->part[i];
+    uint64_t first = le32toh(part->f_lba);
+    uint64_t last = first + le32toh(part->num_sect) - 1;
+
+    if (part->status != 0x80)
+      continue;
+    for (j = 0; entries && j < TOTAL_ENTRIES_SIZE / sizeof(GptEntry); j++)
+      if (!IsUnusedEntry(&entries[j]) &&
+          GetEntryLegacyBootable(&entries[j]) &&
+          entries[j].starting_lba == first && entries[j].ending_lba == last)
+        break;
+    if (!entries || j == TOTAL_ENTRIES_SIZE / sizeof(GptEntry))
+      Problem(rec, "protective MBR partition %u matches no legacy bootable "
+              "partition", i + 1);
+    return;
+  }
+  if (le32toh(protective->num_sect) != max)
+    Problem(rec, "protective MBR covers %u sectors, not %u",
+            le32toh(protective->num_sect), max);
+}
+
+/* Report partitions that overlap or start off the alignment boundary. */
+static void CheckLayout(struct audit_record *rec, GptEntry *entries,
+                        uint32_t alignment) {
+  GptEntry *used[TOTAL_ENTRIES_SIZE / sizeof(GptEntry)];
+  const GptEntry *last = NULL;
+  uint32_t count = 0, i;
+
+  for (i = 0; i < ARRAY_COUNT(used); i++) {
+    if (IsUnusedEntry(&entries[i]))
+      continue;
+    used[count++] = &entries[i];
+    if (entries[i].starting_lba % alignment)
+      Problem(rec, "partition %u is not aligned to %u sectors",
+              i + 1, alignment);
+  }
+
+  // In order of start, a partition overlaps whichever earlier one reaches
+  // furthest if it overlaps any.
+  qsort(used, count, sizeof(used[0]), CompareStart);
+  for (i = 0; i < count; i++) {
+    if (last && used[i]->starting_lba <= last->ending_lba)
+      Problem(rec, "partitions %u and %u overlap",
+              (uint32_t)(last - entries) + 1,
+              (uint32_t)(used[i] - entries) + 1);
+    if (!last || used[i]->ending_lba > last->ending_lba)
+      last = used[i];
+  }
+}
+
+static enum audit_result AuditImage(const CgptAuditParams *params,
+                                    const struct audit_file *file,
+                                    struct audit_record *rec) {
+  struct stat st;
+  GptData gpt;
+  GptHeader *h1, *h2;
+  GptEntry *entries;
+  uint8_t *head = NULL, *tail;
+  uint64_t size, head_bytes, tail_bytes;
+  uint32_t sector_bytes = 512;
+  int fd, gpt_retval, headers = 0;
+  int r1 = GPT_ERROR_CRC_CORRUPTED, r2 = GPT_ERROR_CRC_CORRUPTED;
+  enum audit_result result = AUDIT_ERROR;
+
+  // Reading a whole fleet shouldn't rewrite the inode of every image.
+  fd = open(file->path, O_RDONLY | O_CLOEXEC | O_NOATIME);
+  if (fd < 0 && errno == EPERM)
+    fd = open(file->path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    RecordStart(rec, file->path);
+    RecordError(rec, "cannot open: %s", strerror(errno));
+    return AUDIT_ERROR;
+  }
+
+  if (fstat(fd, &st) < 0) {
+    RecordStart(rec, file->path);
+    RecordError(rec, "cannot stat: %s", strerror(errno));
+    goto done;
+  }
+  if (S_ISBLK(st.st_mode)) {
+    if (ioctl(fd, BLKGETSIZE64, &size) < 0 ||
+        ioctl(fd, BLKSSZGET, &sector_bytes) < 0) {
+      RecordStart(rec, file->path);
+      RecordError(rec, "cannot read drive size: %s", strerror(errno));
+      goto done;
+    }
+  } else if (S_ISREG(st.st_mode)) {
+    size = st.st_size;
+  } else {
+    result = AUDIT_SKIPPED;
+    if (!file->found) {
+      RecordStart(rec, file->path);
+      RecordError(rec, "not a file or block device");
+      result = AUDIT_ERROR;
+    }
+    goto done;
+  }
+
+  head_bytes = GPT_VIEW_HEAD_SECTORS * (uint64_t)sector_bytes;
+  tail_bytes = GPT_VIEW_TAIL_SECTORS * (uint64_t)sector_bytes;
+  if (size % sector_bytes || size < head_bytes + tail_bytes) {
+    result = AUDIT_SKIPPED;
+    if (!file->found) {
+      RecordStart(rec, file->path);
+      RecordError(rec, "too small to hold a GPT");
+      result = AUDIT_ERROR;
+    }
+    goto done;
+  }
+
+  // Two reads per image, the head first, and no readahead past them.
+  posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+  head = malloc(head_bytes + tail_bytes);
+  require(head);
+  tail = head + head_bytes;
+  RecordStart(rec, file->path);
+  errno = 0;
+  if (pread(fd, head, head_bytes, 0) != head_bytes ||
+      pread(fd, tail, tail_bytes, size - tail_bytes) != tail_bytes) {
+    RecordError(rec, "cannot read: %s", errno ? strerror(errno) : "short read");
+    goto done;
+  }
+
+  GptSetView(&gpt, head, tail, sector_bytes, size / sector_bytes);
+  gpt_retval = GptSanityCheck(&gpt);
+  h1 = (GptHeader *)gpt.primary_header;
+  h2 = (GptHeader *)gpt.secondary_header;
+
+  out_str(&rec->out, ",\"sectors\":");
+  out_uint(&rec->out, gpt.drive_sectors, 0);
+  out_str(&rec->out, ",\"headers\":\"");
+  out_str(&rec->out, MaskName(gpt.valid_headers));
+  out_str(&rec->out, "\",\"entries\":\"");
+  out_str(&rec->out, MaskName(gpt.valid_entries));
+  out_str(&rec->out, "\",\"problems\":");
+
+  if (gpt_retval == GPT_ERROR_INVALID_SECTOR_SIZE) {
+    Problem(rec, "%u-byte sectors are not supported", sector_bytes);
+    goto finish;
+  }
+
+  // Headers that are fine on their own, but not together.
+  if (0 == CheckHeader(h1, 0, gpt.drive_sectors))
+    headers |= MASK_PRIMARY;
+  else
+    Problem(rec, "primary header is invalid");
+  if (0 == CheckHeader(h2, 1, gpt.drive_sectors))
+    headers |= MASK_SECONDARY;
+  else
+    Problem(rec, "secondary header is invalid");
+  if (headers == MASK_BOTH && HeaderFieldsSame(h1, h2))
+    Problem(rec, "primary and secondary headers differ");
+
+  // Each table against its own header, or the other one if it has none.
+  if (headers) {
+    r1 = CheckEntries((GptEntry *)gpt.primary_entries,
+                      (headers & MASK_PRIMARY) ? h1 : h2);
+    r2 = CheckEntries((GptEntry *)gpt.secondary_entries,
+                      (headers & MASK_SECONDARY) ? h2 : h1);
+    if (r1)
+      Problem(rec, "primary entries: %s", GptErrorText(r1));
+    if (r2)
+      Problem(rec, "secondary entries: %s", GptErrorText(r2));
+    if (!r1 && !r2 && memcmp(gpt.primary_entries, gpt.secondary_entries,
+                             TOTAL_ENTRIES_SIZE))
+      Problem(rec, "primary and secondary entries differ");
+  }
+
+  // The rest is checked against the table a reader would use.
+  entries = NULL;
+  if (gpt_retval == GPT_SUCCESS)
+    entries = (GptEntry *)((gpt.valid_entries & MASK_PRIMARY) ?
+                           gpt.primary_entries : gpt.secondary_entries);
+  else if (r1 != GPT_ERROR_CRC_CORRUPTED || r2 != GPT_ERROR_CRC_CORRUPTED)
+    entries = (GptEntry *)(r1 != GPT_ERROR_CRC_CORRUPTED ?
+                           gpt.primary_entries : gpt.secondary_entries);
+  if (entries)
+    CheckLayout(rec, entries, params->alignment ? params->alignment :
+                                                   AUDIT_DEFAULT_ALIGNMENT);
+  CheckPMBR(rec, (const struct pmbr *)head, &gpt, entries);
+
+finish:
+  if (!rec->problems)
+    out_char(&rec->out, '[');
+  out_str(&rec->out, rec->problems ? "],\"ok\":false}\n" : "],\"ok\":true}\n");
+  out_flush(&rec->out);
+  result = rec->problems ? AUDIT_PROBLEMS : AUDIT_OK;
+
+done:
+  free(head);
+  close(fd);
+  return result;
+}
+
+static void *AuditWorker(void *arg) {
+  struct audit_job *job = arg;
+  struct audit_record *rec = malloc(sizeof(*rec));
+  uint32_t i;
+
+  require(rec);
+  while ((i = __sync_fetch_and_add(&job->next, 1)) < job->num_files) {
+    enum audit_result r = AuditImage(job->params, &job->files[i], rec);
+    __sync_fetch_and_add(&job->counts[r], 1);
+  }
+  free(rec);
+  return NULL;
+}
+
+/* Add every regular file below dir to the job. */
+static void WalkDir(struct audit_job *job, const char *dir) {
+  struct dirent *ent;
+  DIR *d = opendir(dir);
+  char *path;
+
+  if (!d) {
+    struct audit_record rec;
+
+    RecordStart(&rec, dir);
+    RecordError(&rec, "cannot read directory: %s", strerror(errno));
+    job->counts[AUDIT_ERROR]++;
+    return;
+  }
+  while ((ent = readdir(d))) {
+    int type = ent->d_type;
+
+    if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+      continue;
+    require(asprintf(&path, "%s/%s", dir, ent->d_name) > 0);
+    if (type == DT_UNKNOWN) {
+      struct stat st;
+      type = lstat(path, &st) < 0 ? DT_UNKNOWN :
+             S_ISDIR(st.st_mode) ? DT_DIR :
+             S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+    }
+    if (type == DT_DIR)
+      WalkDir(job, path);
+    else if (type == DT_REG)
+      AddFile(job, path, 1);
+    free(path);
+  }
+  closedir(d);
+}
+
+int CgptAudit(CgptAuditParams *params) {
+  struct audit_job job;
+  uint32_t i;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  // Collect the files first, walking directories costs no data reads.
+  memset(&job, 0, sizeof(job));
+  job.params = params;
+  for (i = 0; i < params->num_paths; i++) {
+    struct stat st;
+
+    if (stat(params->paths[i], &st) == 0 && S_ISDIR(st.st_mode))
+      WalkDir(&job, params->paths[i]);
+    else
+      AddFile(&job, params->paths[i], 0);
+  }
+
+  RunWorkers(params->jobs, job.num_files, AuditWorker, &job);
+
+  printf("{\"summary\":{\"images\":%u,\"ok\":%u,\"problems\":%u,"
+         "\"errors\":%u,\"skipped\":%u}}\n",
+         job.counts[AUDIT_OK] + job.counts[AUDIT_PROBLEMS] +
+         job.counts[AUDIT_ERROR], job.counts[AUDIT_OK],
+         job.counts[AUDIT_PROBLEMS], job.counts[AUDIT_ERROR],
+         job.counts[AUDIT_SKIPPED]);
+
+  for (i = 0; i < job.num_files; i++)
+    free(job.files[i].path);
+  free(job.files);
+  return (job.counts[AUDIT_PROBLEMS] || job.counts[AUDIT_ERROR]) ?
+         CGPT_FAILED : CGPT_OK;
+}
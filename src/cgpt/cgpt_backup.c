@@ -0,0 +1,321 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "vboot_host.h"
+
+#define BACKUP_MAGIC "CGPTBKUP"
+#define BACKUP_VERSION 1
+
+/* The secondary entries are identical to the primary ones and aren't
+ * stored again. */
+#define BACKUP_SAME_ENTRIES 0x1
+
+/* A backup file is this header, little endian like the GPT itself,
+ * followed by the PMBR sector, the primary header and entries, the
+ * secondary entries (unless BACKUP_SAME_ENTRIES) and the secondary header,
+ * all as they were on the drive. */
+struct backup_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t sector_bytes;
+  uint32_t entries_sectors;
+  uint64_t drive_sectors;
+  uint32_t data_crc32;        /* of everything after this header */
+  uint32_t header_crc32;      /* of this header with header_crc32 zero */
+};
+
+/* Convert a header between host and file byte order, both ways. */
+static void SwapHeader(struct backup_header *header) {
+  header->version = htole32(header->version);
+  header->flags = htole32(header->flags);
+  header->sector_bytes = htole32(header->sector_bytes);
+  header->entries_sectors = htole32(header->entries_sectors);
+  header->drive_sectors = htole64(header->drive_sectors);
+  header->data_crc32 = htole32(header->data_crc32);
+  header->header_crc32 = htole32(header->header_crc32);
+}
+
+static uint64_t BackupDataBytes(const struct backup_header *header) {
+  uint64_t sectors = GPT_PMBR_SECTOR + 2 * GPT_HEADER_SECTOR +
+                     header->entries_sectors;
+
+  if (!(header->flags & BACKUP_SAME_ENTRIES))
+    sectors += header->entries_sectors;
+  return sectors * header->sector_bytes;
+}
+
+/* Read up to len bytes, stopping early only at the end of the file.
+ * Returns the number of bytes read or -1. */
+static ssize_t ReadFull(int fd, void *buf, size_t len) {
+  size_t done = 0;
+  ssize_t n;
+
+  while (done < len) {
+    n = read(fd, (uint8_t *)buf + done, len - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return -1;
+    if (n == 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+static int WriteFull(int fd, const void *buf, size_t len) {
+  ssize_t n;
+
+  while (len) {
+    n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return CGPT_FAILED;
+    buf = (const uint8_t *)buf + n;
+    len -= n;
+  }
+  return CGPT_OK;
+}
+
+int CgptBackup(CgptBackupParams *params) {
+  struct drive drive;
+  struct backup_header *header;
+  uint8_t *buf = NULL, *p;
+  uint64_t sector_bytes, entries_bytes, data_bytes;
+  int fd = -1, gpt_retval, result = CGPT_FAILED;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDONLY))
+    return CGPT_FAILED;
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+
+  sector_bytes = drive.gpt.sector_bytes;
+  entries_bytes = GPT_ENTRIES_SECTORS * sector_bytes;
+
+  // Lay the whole file out in memory so it can be written in one go.
+  buf = calloc(1, sizeof(*header) + (GPT_PMBR_SECTOR + 2 * GPT_HEADER_SECTOR +
+                                     2 * GPT_ENTRIES_SECTORS) * sector_bytes);
+  require(buf);
+  header = (struct backup_header *)buf;
+  memcpy(header->magic, BACKUP_MAGIC, sizeof(header->magic));
+  header->version = BACKUP_VERSION;
+  header->sector_bytes = sector_bytes;
+  header->entries_sectors = GPT_ENTRIES_SECTORS;
+  header->drive_sectors = drive.gpt.drive_sectors;
+  if (!memcmp(drive.gpt.primary_entries, drive.gpt.secondary_entries,
+              entries_bytes))
+    header->flags |= BACKUP_SAME_ENTRIES;
+
+  p = buf + sizeof(*header);
+  if (pread(drive.fd, p, sector_bytes, 0) != sector_bytes) {
+    Error("Unable to read PMBR\n");
+    goto bad;
+  }
+  p += sector_bytes;
+  memcpy(p, drive.gpt.primary_header, sector_bytes);
+  p += sector_bytes;
+  memcpy(p, drive.gpt.primary_entries, entries_bytes);
+  p += entries_bytes;
+  if (!(header->flags & BACKUP_SAME_ENTRIES)) {
+    memcpy(p, drive.gpt.secondary_entries, entries_bytes);
+    p += entries_bytes;
+  }
+  memcpy(p, drive.gpt.secondary_header, sector_bytes);
+
+  data_bytes = BackupDataBytes(header);
+  header->data_crc32 = Crc32(buf + sizeof(*header), data_bytes);
+  SwapHeader(header);
+  header->header_crc32 = htole32(Crc32(header, sizeof(*header)));
+
+  if (!params->file || !strcmp(params->file, "-")) {
+    fd = STDOUT_FILENO;
+  } else {
+    fd = open(params->file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+      Error("Can't open %s: %s\n", params->file, strerror(errno));
+      goto bad;
+    }
+  }
+  if (CGPT_OK != WriteFull(fd, buf, sizeof(*header) + data_bytes) ||
+      (fd != STDOUT_FILENO && (fsync(fd) < 0 || close(fd) < 0))) {
+    Error("Cannot write backup: %s\n", strerror(errno));
+    goto bad;
+  }
+  fd = -1;
+  result = CGPT_OK;
+
+bad:
+  if (fd >= 0 && fd != STDOUT_FILENO)
+    close(fd);
+  free(buf);
+  DriveClose(&drive, 0);
+  return result;
+}
+
+/* Read and check a backup file, returning it in a malloc()ed buffer. */
+static uint8_t *ReadBackup(const char *name) {
+  struct backup_header header;
+  uint8_t *buf = NULL, extra;
+  uint64_t data_bytes;
+  uint32_t crc;
+  int fd;
+
+  if (!name || !strcmp(name, "-")) {
+    fd = STDIN_FILENO;
+    name = "<stdin>";
+  } else if ((fd = open(name, O_RDONLY)) < 0) {
+    Error("Can't open %s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+
+  if (ReadFull(fd, &header, sizeof(header)) != sizeof(header) ||
+      memcmp(header.magic, BACKUP_MAGIC, sizeof(header.magic))) {
+    Error("%s is not a cgpt backup\n", name);
+    goto bad;
+  }
+  if (le32toh(header.version) != BACKUP_VERSION) {
+    Error("%s is a version %u backup, only version %d is supported\n",
+          name, le32toh(header.version), BACKUP_VERSION);
+    goto bad;
+  }
+  crc = header.header_crc32;
+  header.header_crc32 = 0;
+  if (htole32(Crc32(&header, sizeof(header))) != crc) {
+    Error("%s has a corrupt header\n", name);
+    goto bad;
+  }
+  header.header_crc32 = crc;
+  SwapHeader(&header);
+  if (header.sector_bytes < 512 || header.sector_bytes > 65536 ||
+      header.entries_sectors != GPT_ENTRIES_SECTORS) {
+    Error("%s has an unsupported layout\n", name);
+    goto bad;
+  }
+
+  data_bytes = BackupDataBytes(&header);
+  buf = malloc(sizeof(header) + data_bytes);
+  require(buf);
+  memcpy(buf, &header, sizeof(header));
+  if (ReadFull(fd, buf + sizeof(header), data_bytes) != data_bytes ||
+      ReadFull(fd, &extra, 1) != 0) {
+    Error("%s has the wrong size\n", name);
+    goto bad;
+  }
+  if (Crc32(buf + sizeof(header), data_bytes) != header.data_crc32) {
+    Error("%s is corrupt\n", name);
+    goto bad;
+  }
+
+  if (fd != STDIN_FILENO)
+    close(fd);
+  return buf;
+
+bad:
+  if (fd != STDIN_FILENO)
+    close(fd);
+  free(buf);
+  return NULL;
+}
+
+int CgptRestore(CgptBackupParams *params) {
+  struct drive drive;
+  struct backup_header *header;
+  struct iovec iov[2];
+  uint8_t *buf, *pmbr, *primary_header, *primary_entries;
+  uint8_t *secondary_entries, *secondary_header;
+  uint64_t sector_bytes, entries_bytes, head_bytes;
+  int gpt_retval, result = CGPT_FAILED;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  if (!(buf = ReadBackup(params->file)))
+    return CGPT_FAILED;
+  header = (struct backup_header *)buf;
+  sector_bytes = header->sector_bytes;
+  entries_bytes = header->entries_sectors * sector_bytes;
+  pmbr = buf + sizeof(*header);
+  primary_header = pmbr + sector_bytes;
+  primary_entries = primary_header + sector_bytes;
+  secondary_entries = (header->flags & BACKUP_SAME_ENTRIES) ?
+                      primary_entries : primary_entries + entries_bytes;
+  secondary_header = secondary_entries + entries_bytes;
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDWR)) {
+    free(buf);
+    return CGPT_FAILED;
+  }
+
+  if (drive.gpt.sector_bytes != sector_bytes ||
+      drive.gpt.drive_sectors != header->drive_sectors) {
+    Error("The backup is of a drive with %llu %llu-byte sectors, "
+          "%s has %llu %u-byte sectors\n",
+          (unsigned long long)header->drive_sectors,
+          (unsigned long long)sector_bytes, params->drive_name,
+          (unsigned long long)drive.gpt.drive_sectors,
+          drive.gpt.sector_bytes);
+    goto bad;
+  }
+
+  // Check the saved table the same way as one read from the drive.
+  memcpy(drive.gpt.primary_header, primary_header, sector_bytes);
+  memcpy(drive.gpt.primary_entries, primary_entries, entries_bytes);
+  memcpy(drive.gpt.secondary_entries, secondary_entries, entries_bytes);
+  memcpy(drive.gpt.secondary_header, secondary_header, sector_bytes);
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("The backup holds no valid table: %s\n", GptError(gpt_retval));
+    goto bad;
+  }
+
+  // The backup replaces whatever is on the drive, so only wait for other
+  // writers rather than checking the table is unchanged.
+  if (CGPT_OK != DriveLock(&drive))
+    goto bad;
+
+  // The PMBR, primary header and entries are contiguous in the backup, the
+  // secondary entries and header are gathered into a second write.
+  head_bytes = (GPT_PMBR_SECTOR + GPT_HEADER_SECTOR) * sector_bytes +
+               entries_bytes;
+  iov[0].iov_base = secondary_entries;
+  iov[0].iov_len = entries_bytes;
+  iov[1].iov_base = secondary_header;
+  iov[1].iov_len = sector_bytes;
+  if (pwrite(drive.fd, pmbr, head_bytes, 0) != head_bytes ||
+      pwritev(drive.fd, iov, 2, (drive.gpt.drive_sectors - GPT_HEADER_SECTOR) *
+              sector_bytes - entries_bytes) != entries_bytes + sector_bytes) {
+    Error("Cannot write %s: %s\n", params->drive_name, strerror(errno));
+    goto bad;
+  }
+  if (fsync(drive.fd) < 0) {
+    Error("Cannot flush %s: %s\n", params->drive_name, strerror(errno));
+    goto bad;
+  }
+  result = CGPT_OK;
+
+bad:
+  free(buf);
+  DriveClose(&drive, 0);
+  return result;
+}
@@ -129,8 +129,10 @@ int CgptBoot(CgptBootParams *params) {
   printf("%s\n", buf);
 
   // Write it all out, if needed.
-  if (mode == O_RDONLY || CGPT_OK == WritePMBR(&drive))
+  if (mode == O_RDONLY)
     retval = 0;
+  else
+    retval = WritePMBR(&drive);
 
 done:
   (void) DriveClose(&drive, 1);
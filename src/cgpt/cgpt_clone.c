@@ -0,0 +1,110 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "copy_utils.h"
+#include "vboot_host.h"
+
+static int CheckPartition(struct drive *drive, uint32_t partition) {
+  if (partition == 0 || partition > GetNumberOfEntries(drive)) {
+    Error("invalid partition number: %d\n", partition);
+    return CGPT_FAILED;
+  }
+  if (IsUnused(drive, PRIMARY, partition - 1)) {
+    Error("partition %d does not exist\n", partition);
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+int CgptClone(CgptCloneParams *params) {
+  struct drive drive;
+  GptEntry *src, *dst;
+  uint64_t sector_bytes, src_sectors, dst_sectors;
+  uint32_t dst_index;
+  int gpt_retval;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDWR))
+    return CGPT_FAILED;
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+
+  if (((drive.gpt.valid_headers & MASK_BOTH) != MASK_BOTH) ||
+      ((drive.gpt.valid_entries & MASK_BOTH) != MASK_BOTH)) {
+    Error("one of the GPT header/entries is invalid.\n"
+          "please run 'cgpt repair' before cloning anything.\n");
+    goto bad;
+  }
+
+  if (CGPT_OK != CheckPartition(&drive, params->src_partition) ||
+      CGPT_OK != CheckPartition(&drive, params->dst_partition))
+    goto bad;
+
+  if (params->src_partition == params->dst_partition) {
+    Error("cannot clone partition %d onto itself\n", params->src_partition);
+    goto bad;
+  }
+
+  dst_index = params->dst_partition - 1;
+  src = GetEntry(&drive.gpt, PRIMARY, params->src_partition - 1);
+  dst = GetEntry(&drive.gpt, PRIMARY, dst_index);
+  sector_bytes = drive.gpt.sector_bytes;
+  src_sectors = src->ending_lba - src->starting_lba + 1;
+  dst_sectors = dst->ending_lba - dst->starting_lba + 1;
+
+  if (dst_sectors < src_sectors) {
+    Error("partition %d (%llu sectors) is smaller than partition %d "
+          "(%llu sectors)\n", params->dst_partition,
+          (unsigned long long)dst_sectors, params->src_partition,
+          (unsigned long long)src_sectors);
+    goto bad;
+  }
+
+  if (params->verbose)
+    printf("Copying %llu sectors from partition %d to partition %d\n",
+           (unsigned long long)src_sectors, params->src_partition,
+           params->dst_partition);
+
+  // The table is only touched once the data is safely in place, so an
+  // interrupted clone leaves the destination's old attributes alone.
+  if (CGPT_OK != copy_sparse_range(drive.fd, src->starting_lba * sector_bytes,
+                                   drive.fd, dst->starting_lba * sector_bytes,
+                                   src_sectors * sector_bytes)) {
+    Error("Failed to copy partition %d, table left unchanged\n",
+          params->src_partition);
+    goto bad;
+  }
+
+  memcpy(&dst->type, &src->type, sizeof(Guid));
+  dst->attrs.whole = src->attrs.whole;
+  if (params->set_raw) {
+    SetRaw(&drive, PRIMARY, dst_index, params->raw_value);
+  } else {
+    if (params->set_successful)
+      SetSuccessful(&drive, PRIMARY, dst_index, params->successful);
+    if (params->set_tries)
+      SetTries(&drive, PRIMARY, dst_index, params->tries);
+    if (params->set_priority)
+      SetPriority(&drive, PRIMARY, dst_index, params->priority);
+  }
+
+  UpdateAllEntries(&drive);
+
+  // Write it all out.
+  return DriveClose(&drive, 1);
+
+bad:
+  DriveClose(&drive, 0);
+  return CGPT_FAILED;
+}
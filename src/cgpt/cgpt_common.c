@@ -9,12 +9,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/file.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -22,6 +24,7 @@
 
 #include "cgpt.h"
 #include "cgptlib_internal.h"
+#include "copy_utils.h"
 #include "crc32.h"
 #include "vboot_host.h"
 
@@ -33,6 +36,40 @@ void Error(const char *format, ...) {
   va_end(ap);
 }
 
+void RunWorkers(uint32_t jobs, uint64_t count, void *(*fn)(void *),
+                void *arg) {
+  pthread_t *threads;
+  uint32_t i;
+  int err;
+
+  if (jobs == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cpus > 0 ? cpus : 1;
+  }
+  if (jobs > count)
+    jobs = count;
+  if (jobs <= 1) {
+    fn(arg);
+    return;
+  }
+
+  threads = calloc(jobs, sizeof(pthread_t));
+  require(threads);
+  for (i = 0; i < jobs; i++) {
+    if ((err = pthread_create(&threads[i], NULL, fn, arg))) {
+      Error("Cannot start worker thread: %s\n", strerror(err));
+      break;
+    }
+  }
+  // Whatever was started finishes the list, even if that's only one.
+  jobs = i;
+  if (jobs == 0)
+    fn(arg);
+  for (i = 0; i < jobs; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+}
+
 
 int CheckValid(const struct drive *drive) {
   if ((drive->gpt.valid_headers != MASK_BOTH) ||
@@ -111,6 +148,10 @@ int ReadPMBR(struct drive *drive) {
 }
 
 int WritePMBR(struct drive *drive) {
+  int r = DriveLockUnchanged(drive);
+  if (r != CGPT_OK)
+    return r;
+
   if (-1 == lseek(drive->fd, 0, SEEK_SET))
     return CGPT_FAILED;
 
@@ -151,6 +192,27 @@ static int Save(const int fd, const uint8_t *buf,
   return CGPT_OK;
 }
 
+/* Saves a copy of the entries starting at 'sector', or only the sectors of it
+ * in gpt.modified_entry_sectors if that narrows them down. */
+static int SaveEntries(struct drive *drive, const uint8_t *entries,
+                       uint64_t sector) {
+  uint32_t dirty = drive->gpt.modified_entry_sectors;
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+  uint32_t i, n;
+
+  if (!dirty)
+    return Save(drive->fd, entries, sector, sector_bytes,
+                GPT_ENTRIES_SECTORS);
+
+  for (i = 0; i < GPT_ENTRIES_SECTORS; i += n ? n : 1) {
+    for (n = 0; i + n < GPT_ENTRIES_SECTORS && (dirty >> (i + n)) & 1; n++)
+      ;
+    if (n && CGPT_OK != Save(drive->fd, entries + i * sector_bytes,
+                             sector + i, sector_bytes, n))
+      return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
 
 // Opens a block device or file, loads raw GPT data from it.
 // If the drive is a file or doesn't exist and min_size is not zero then
@@ -241,6 +303,12 @@ int DriveOpen(const char *drive_path, struct drive *drive,
     goto error_close;
   }
 
+  // Remember the headers as read, see DriveLockUnchanged().
+  drive->header_crc32[0] = Crc32(drive->gpt.primary_header,
+                                 drive->gpt.sector_bytes);
+  drive->header_crc32[1] = Crc32(drive->gpt.secondary_header,
+                                 drive->gpt.sector_bytes);
+
   // We just load the data. Caller must validate it.
   return CGPT_OK;
 
@@ -250,8 +318,233 @@ error_close:
 }
 
 
+static int CompareRanges(const void *a, const void *b) {
+  const struct drive_range *x = a, *y = b;
+  if (x->first != y->first)
+    return x->first < y->first ? -1 : 1;
+  return 0;
+}
+
+// Collects the sectors used by partitions in the in-memory table, sorted by
+// starting sector. A table that doesn't pass the sanity check uses nothing.
+static struct drive_range *UsedRanges(struct drive *drive, uint32_t *count) {
+  struct drive_range *ranges;
+  uint32_t i, n;
+  int secondary;
+
+  *count = 0;
+  if (GPT_SUCCESS != GptSanityCheck(&drive->gpt) || !drive->gpt.valid_entries)
+    return NULL;
+  secondary = (drive->gpt.valid_entries & MASK_PRIMARY) ? PRIMARY : SECONDARY;
+
+  n = GetNumberOfEntries(drive);
+  ranges = calloc(n ? n : 1, sizeof(*ranges));
+  require(ranges);
+  for (i = 0; i < n; i++) {
+    GptEntry *entry = GetEntry(&drive->gpt, secondary, i);
+    if (GuidIsZero(&entry->type))
+      continue;
+    ranges[*count].first = entry->starting_lba;
+    ranges[*count].last = entry->ending_lba;
+    (*count)++;
+  }
+  qsort(ranges, *count, sizeof(*ranges), CompareRanges);
+  return ranges;
+}
+
+int DriveTrackFreed(struct drive *drive) {
+  free(drive->discard);
+  drive->discard = UsedRanges(drive, &drive->num_discard);
+  if (!drive->discard)
+    drive->discard = calloc(1, sizeof(*drive->discard));
+  return drive->discard ? CGPT_OK : CGPT_FAILED;
+}
+
+static int DiscardSectors(struct drive *drive, uint64_t first, uint64_t last) {
+  uint64_t bytes = drive->gpt.sector_bytes;
+  int r = discard_range(drive->fd, first * bytes, (last - first + 1) * bytes);
+
+  if (r == CGPT_FAILED)
+    Error("Cannot discard sectors %llu-%llu: %s\n", (unsigned long long)first,
+          (unsigned long long)last, strerror(errno));
+  else if (r == CGPT_NOOP)
+    Error("Discard is not supported, freed space left as is\n");
+  return r;
+}
+
+// Discards the parts of the remembered ranges that the table no longer uses.
+// Returns the number of errors.
+static int DiscardFreed(struct drive *drive) {
+  struct drive_range *used;
+  uint32_t i, j, num_used;
+  int r = CGPT_OK;
+
+  used = UsedRanges(drive, &num_used);
+  for (i = 0; i < drive->num_discard && r == CGPT_OK; i++) {
+    uint64_t next = drive->discard[i].first;
+    uint64_t last = drive->discard[i].last;
+
+    for (j = 0; j < num_used && next <= last && r == CGPT_OK; j++) {
+      if (used[j].last < next || used[j].first > last)
+        continue;
+      if (used[j].first > next)
+        r = DiscardSectors(drive, next, used[j].first - 1);
+      if (used[j].last >= next)
+        next = used[j].last + 1;
+    }
+    if (next <= last && r == CGPT_OK)
+      r = DiscardSectors(drive, next, last);
+  }
+  free(used);
+  return r == CGPT_FAILED;
+}
+
+int DriveLock(struct drive *drive) {
+  if (drive->locked)
+    return CGPT_OK;
+  while (flock(drive->fd, LOCK_EX) < 0) {
+    if (errno != EINTR) {
+      Error("Cannot lock the drive: %s\n", strerror(errno));
+      return CGPT_FAILED;
+    }
+  }
+  drive->locked = 1;
+  drive->lock_status = CGPT_OK;
+  return CGPT_OK;
+}
+
+int DriveLockUnchanged(struct drive *drive) {
+  uint8_t *primary = NULL, *secondary = NULL;
+  int r = CGPT_OK;
+
+  if (drive->locked)
+    return drive->lock_status;
+  if (CGPT_OK != DriveLock(drive))
+    return CGPT_FAILED;
+
+  if (CGPT_OK != Load(drive->fd, &primary, GPT_PMBR_SECTOR,
+                      drive->gpt.sector_bytes, GPT_HEADER_SECTOR) ||
+      CGPT_OK != Load(drive->fd, &secondary,
+                      drive->gpt.drive_sectors - GPT_PMBR_SECTOR,
+                      drive->gpt.sector_bytes, GPT_HEADER_SECTOR)) {
+    r = CGPT_FAILED;
+  } else if (Crc32(primary, drive->gpt.sector_bytes) !=
+             drive->header_crc32[0] ||
+             Crc32(secondary, drive->gpt.sector_bytes) !=
+             drive->header_crc32[1]) {
+    Error("The partition table was changed by another program since it "
+          "was read, try again\n");
+    r = CGPT_CONFLICT;
+  }
+  free(primary);
+  free(secondary);
+  drive->lock_status = r;
+  return r;
+}
+
+void DriveSnapshot(const struct drive *drive, struct drive_snapshot *snap) {
+  uint64_t sector_bytes = drive->gpt.sector_bytes;
+  uint64_t entries_bytes = GPT_ENTRIES_SECTORS * sector_bytes;
+
+  memcpy(&snap->pmbr, &drive->pmbr, sizeof(snap->pmbr));
+  snap->primary_header = malloc(sector_bytes);
+  snap->primary_entries = malloc(entries_bytes);
+  snap->secondary_entries = malloc(entries_bytes);
+  snap->secondary_header = malloc(sector_bytes);
+  require(snap->primary_header && snap->primary_entries &&
+          snap->secondary_entries && snap->secondary_header);
+  memcpy(snap->primary_header, drive->gpt.primary_header, sector_bytes);
+  memcpy(snap->primary_entries, drive->gpt.primary_entries, entries_bytes);
+  memcpy(snap->secondary_entries, drive->gpt.secondary_entries,
+         entries_bytes);
+  memcpy(snap->secondary_header, drive->gpt.secondary_header, sector_bytes);
+}
+
+void DriveSnapshotFree(struct drive_snapshot *snap) {
+  free(snap->primary_header);
+  free(snap->primary_entries);
+  free(snap->secondary_entries);
+  free(snap->secondary_header);
+  memset(snap, 0, sizeof(*snap));
+}
+
+/* Write the sectors of buf that differ from old, one pwrite() per run of
+ * adjacent differing sectors. 'sector' is where buf lives on the drive. */
+static int WriteChanged(struct drive *drive, const char *what,
+                        const uint8_t *old, const uint8_t *buf,
+                        uint64_t sector, uint64_t sectors, int dry_run,
+                        uint32_t *count, drive_run_fn report, void *ctx) {
+  uint64_t sector_bytes = drive->gpt.sector_bytes;
+  uint64_t start, end, len = sectors * sector_bytes;
+
+  for (start = 0; start < len; start = end) {
+    if (!memcmp(old + start, buf + start, sector_bytes)) {
+      end = start + sector_bytes;
+      continue;
+    }
+    for (end = start + sector_bytes;
+         end < len && memcmp(old + end, buf + end, sector_bytes);
+         end += sector_bytes)
+      ;
+    *count += (end - start) / sector_bytes;
+    if (report)
+      report(ctx, what, sector + start / sector_bytes,
+             (end - start) / sector_bytes);
+    if (!dry_run &&
+        pwrite(drive->fd, buf + start, end - start,
+               sector * sector_bytes + start) != end - start)
+      return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+int DriveWriteChanged(struct drive *drive, const struct drive_snapshot *old,
+                      int dry_run, uint32_t *count,
+                      drive_run_fn report, void *ctx) {
+  uint64_t sectors = drive->gpt.drive_sectors;
+
+  if (memcmp(&old->pmbr, &drive->pmbr, sizeof(old->pmbr))) {
+    (*count)++;
+    if (report)
+      report(ctx, "PMBR", 0, 1);
+    if (!dry_run && CGPT_OK != WritePMBR(drive))
+      return CGPT_FAILED;
+  }
+  if (CGPT_OK != WriteChanged(drive, "primary header", old->primary_header,
+                              drive->gpt.primary_header, GPT_PMBR_SECTOR,
+                              GPT_HEADER_SECTOR, dry_run, count,
+                              report, ctx) ||
+      CGPT_OK != WriteChanged(drive, "primary entries", old->primary_entries,
+                              drive->gpt.primary_entries,
+                              GPT_PMBR_SECTOR + GPT_HEADER_SECTOR,
+                              GPT_ENTRIES_SECTORS, dry_run, count,
+                              report, ctx) ||
+      CGPT_OK != WriteChanged(drive, "secondary entries",
+                              old->secondary_entries,
+                              drive->gpt.secondary_entries,
+                              sectors - GPT_HEADER_SECTOR -
+                              GPT_ENTRIES_SECTORS,
+                              GPT_ENTRIES_SECTORS, dry_run, count,
+                              report, ctx) ||
+      CGPT_OK != WriteChanged(drive, "secondary header",
+                              old->secondary_header,
+                              drive->gpt.secondary_header,
+                              sectors - GPT_HEADER_SECTOR,
+                              GPT_HEADER_SECTOR, dry_run, count,
+                              report, ctx))
+    return CGPT_FAILED;
+  return CGPT_OK;
+}
+
 int DriveClose(struct drive *drive, int update_as_needed) {
   int errors = 0;
+  int status = CGPT_OK;
+
+  // Nothing is written over a table someone else changed in the meantime.
+  // The lock is only held from here until the drive is closed.
+  if (update_as_needed && drive->gpt.modified &&
+      CGPT_OK != (status = DriveLockUnchanged(drive)))
+    update_as_needed = 0;
 
   if (update_as_needed) {
     if (drive->gpt.modified & GPT_MODIFIED_HEADER1) {
@@ -272,18 +565,16 @@ int DriveClose(struct drive *drive, int update_as_needed) {
       }
     }
     if (drive->gpt.modified & GPT_MODIFIED_ENTRIES1) {
-      if (CGPT_OK != Save(drive->fd, drive->gpt.primary_entries,
-                          GPT_PMBR_SECTOR + GPT_HEADER_SECTOR,
-                          drive->gpt.sector_bytes, GPT_ENTRIES_SECTORS)) {
+      if (CGPT_OK != SaveEntries(drive, drive->gpt.primary_entries,
+                                 GPT_PMBR_SECTOR + GPT_HEADER_SECTOR)) {
         errors++;
         Error("Cannot write primary entries: %s\n", strerror(errno));
       }
     }
     if (drive->gpt.modified & GPT_MODIFIED_ENTRIES2) {
-      if (CGPT_OK != Save(drive->fd, drive->gpt.secondary_entries,
-                          drive->gpt.drive_sectors - GPT_HEADER_SECTOR
-                          - GPT_ENTRIES_SECTORS,
-                          drive->gpt.sector_bytes, GPT_ENTRIES_SECTORS)) {
+      if (CGPT_OK != SaveEntries(drive, drive->gpt.secondary_entries,
+                                 drive->gpt.drive_sectors - GPT_HEADER_SECTOR
+                                 - GPT_ENTRIES_SECTORS)) {
         errors++;
         Error("Cannot write secondary entries: %s\n", strerror(errno));
       }
@@ -295,6 +586,14 @@ int DriveClose(struct drive *drive, int update_as_needed) {
   // and timeout tests.
   fsync(drive->fd);
 
+  // Only throw data away once the table that no longer references it is on
+  // disk.
+  if (update_as_needed && !errors && drive->discard)
+    errors += DiscardFreed(drive);
+  free(drive->discard);
+  drive->discard = 0;
+  drive->num_discard = 0;
+
   close(drive->fd);
 
   if (drive->gpt.primary_header)
@@ -309,289 +608,14 @@ int DriveClose(struct drive *drive, int update_as_needed) {
   if (drive->gpt.secondary_entries)
     free(drive->gpt.secondary_entries);
   drive->gpt.secondary_entries = 0;
+  drive->locked = 0;
 
+  if (status != CGPT_OK)
+    return status;
   return errors ? CGPT_FAILED : CGPT_OK;
 }
 
 
-/* GUID conversion functions. Accepted format:
- *
- *   "C12A7328-F81F-11D2-BA4B-00A0C93EC93B"
- *
- * Returns CGPT_OK if parsing is successful; otherwise CGPT_FAILED.
- */
-#define GUID_FMT_UPPER "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X"
-#define GUID_FMT_LOWER "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x"
-int StrToGuid(const char *str, Guid *guid) {
-  uint32_t time_low;
-  uint16_t time_mid;
-  uint16_t time_high_and_version;
-  unsigned int chunk[11];
-
-  if (11 != sscanf(str, GUID_FMT_UPPER,
-                   chunk+0,
-                   chunk+1,
-                   chunk+2,
-                   chunk+3,
-                   chunk+4,
-                   chunk+5,
-                   chunk+6,
-                   chunk+7,
-                   chunk+8,
-                   chunk+9,
-                   chunk+10)) {
-    printf("FAILED\n");
-    return CGPT_FAILED;
-  }
-
-  time_low = chunk[0] & 0xffffffff;
-  time_mid = chunk[1] & 0xffff;
-  time_high_and_version = chunk[2] & 0xffff;
-
-  guid->u.Uuid.time_low = htole32(time_low);
-  guid->u.Uuid.time_mid = htole16(time_mid);
-  guid->u.Uuid.time_high_and_version = htole16(time_high_and_version);
-
-  guid->u.Uuid.clock_seq_high_and_reserved = chunk[3] & 0xff;
-  guid->u.Uuid.clock_seq_low = chunk[4] & 0xff;
-  guid->u.Uuid.node[0] = chunk[5] & 0xff;
-  guid->u.Uuid.node[1] = chunk[6] & 0xff;
-  guid->u.Uuid.node[2] = chunk[7] & 0xff;
-  guid->u.Uuid.node[3] = chunk[8] & 0xff;
-  guid->u.Uuid.node[4] = chunk[9] & 0xff;
-  guid->u.Uuid.node[5] = chunk[10] & 0xff;
-
-  return CGPT_OK;
-}
-static void GuidToStrGeneric(const char *fmt, const Guid *guid,
-                             char *str, unsigned int buflen) {
-  require(buflen >= GUID_STRLEN);
-  require(snprintf(str, buflen, fmt,
-                  le32toh(guid->u.Uuid.time_low),
-                  le16toh(guid->u.Uuid.time_mid),
-                  le16toh(guid->u.Uuid.time_high_and_version),
-                  guid->u.Uuid.clock_seq_high_and_reserved,
-                  guid->u.Uuid.clock_seq_low,
-                  guid->u.Uuid.node[0], guid->u.Uuid.node[1],
-                  guid->u.Uuid.node[2], guid->u.Uuid.node[3],
-                  guid->u.Uuid.node[4], guid->u.Uuid.node[5]) == GUID_STRLEN-1);
-}
-void GuidToStrUpper(const Guid *guid, char *str, unsigned int buflen) {
-  GuidToStrGeneric(GUID_FMT_UPPER, guid, str, buflen);
-}
-void GuidToStrLower(const Guid *guid, char *str, unsigned int buflen) {
-  GuidToStrGeneric(GUID_FMT_LOWER, guid, str, buflen);
-}
-
-/* Convert possibly unterminated UTF16 string to UTF8.
- * Caller must prepare enough space for UTF8, which could be up to
- * twice the byte length of UTF16 string plus the terminating '\0'.
- * See the following table for encoding lengths.
- *
- *     Code point       UTF16       UTF8
- *   0x0000-0x007F     2 bytes     1 byte
- *   0x0080-0x07FF     2 bytes     2 bytes
- *   0x0800-0xFFFF     2 bytes     3 bytes
- *  0x10000-0x10FFFF   4 bytes     4 bytes
- *
- * This function uses a simple state meachine to convert UTF-16 char(s) to
- * a code point. Once a code point is parsed out, the state machine throws
- * out sequencial UTF-8 chars in one time.
- *
- * Return: CGPT_OK --- all character are converted successfully.
- *         CGPT_FAILED --- convert error, i.e. output buffer is too short.
- */
-int UTF16ToUTF8(const uint16_t *utf16, unsigned int maxinput,
-                uint8_t *utf8, unsigned int maxoutput)
-{
-  size_t s16idx, s8idx;
-  uint32_t code_point = 0;
-  int code_point_ready = 1;  // code point is ready to output.
-  int retval = CGPT_OK;
-
-  if (!utf16 || !maxinput || !utf8 || !maxoutput)
-    return CGPT_FAILED;
-
-  maxoutput--;                             /* plan for termination now */
-
-  for (s16idx = s8idx = 0;
-       s16idx < maxinput && utf16[s16idx] && maxoutput;
-       s16idx++) {
-    uint16_t codeunit = le16toh(utf16[s16idx]);
-
-    if (code_point_ready) {
-      if (codeunit >= 0xD800 && codeunit <= 0xDBFF) {
-        /* high surrogate, need the low surrogate. */
-        code_point_ready = 0;
-        code_point = (codeunit & 0x03FF) + 0x0040;
-      } else {
-        /* BMP char, output it. */
-        code_point = codeunit;
-      }
-    } else {
-      /* expect the low surrogate */
-      if (codeunit >= 0xDC00 && codeunit <= 0xDFFF) {
-        code_point = (code_point << 10) | (codeunit & 0x03FF);
-        code_point_ready = 1;
-      } else {
-        /* the second code unit is NOT the low surrogate. Unexpected. */
-        code_point_ready = 0;
-        retval = CGPT_FAILED;
-        break;
-      }
-    }
-
-    /* If UTF code point is ready, output it. */
-    if (code_point_ready) {
-      require(code_point <= 0x10FFFF);
-      if (code_point <= 0x7F && maxoutput >= 1) {
-        maxoutput -= 1;
-        utf8[s8idx++] = code_point & 0x7F;
-      } else if (code_point <= 0x7FF && maxoutput >= 2) {
-        maxoutput -= 2;
-        utf8[s8idx++] = 0xC0 | (code_point >> 6);
-        utf8[s8idx++] = 0x80 | (code_point & 0x3F);
-      } else if (code_point <= 0xFFFF && maxoutput >= 3) {
-        maxoutput -= 3;
-        utf8[s8idx++] = 0xE0 | (code_point >> 12);
-        utf8[s8idx++] = 0x80 | ((code_point >> 6) & 0x3F);
-        utf8[s8idx++] = 0x80 | (code_point & 0x3F);
-      } else if (code_point <= 0x10FFFF && maxoutput >= 4) {
-        maxoutput -= 4;
-        utf8[s8idx++] = 0xF0 | (code_point >> 18);
-        utf8[s8idx++] = 0x80 | ((code_point >> 12) & 0x3F);
-        utf8[s8idx++] = 0x80 | ((code_point >> 6) & 0x3F);
-        utf8[s8idx++] = 0x80 | (code_point & 0x3F);
-      } else {
-        /* buffer underrun */
-        retval = CGPT_FAILED;
-        break;
-      }
-    }
-  }
-  utf8[s8idx++] = 0;
-  return retval;
-}
-
-/* Convert UTF8 string to UTF16. The UTF8 string must be null-terminated.
- * Caller must prepare enough space for UTF16, including a terminating 0x0000.
- * See the following table for encoding lengths. In any case, the caller
- * just needs to prepare the byte length of UTF8 plus the terminating 0x0000.
- *
- *     Code point       UTF16       UTF8
- *   0x0000-0x007F     2 bytes     1 byte
- *   0x0080-0x07FF     2 bytes     2 bytes
- *   0x0800-0xFFFF     2 bytes     3 bytes
- *  0x10000-0x10FFFF   4 bytes     4 bytes
- *
- * This function converts UTF8 chars to a code point first. Then, convrts it
- * to UTF16 code unit(s).
- *
- * Return: CGPT_OK --- all character are converted successfully.
- *         CGPT_FAILED --- convert error, i.e. output buffer is too short.
- */
-int UTF8ToUTF16(const uint8_t *utf8, uint16_t *utf16, unsigned int maxoutput)
-{
-  size_t s16idx, s8idx;
-  uint32_t code_point = 0;
-  unsigned int expected_units = 1;
-  unsigned int decoded_units = 1;
-  int retval = CGPT_OK;
-
-  if (!utf8 || !utf16 || !maxoutput)
-    return CGPT_FAILED;
-
-  maxoutput--;                             /* plan for termination */
-
-  for (s8idx = s16idx = 0;
-       utf8[s8idx] && maxoutput;
-       s8idx++) {
-    uint8_t code_unit;
-    code_unit = utf8[s8idx];
-
-    if (expected_units != decoded_units) {
-      /* Trailing bytes of multi-byte character */
-      if ((code_unit & 0xC0) == 0x80) {
-        code_point = (code_point << 6) | (code_unit & 0x3F);
-        ++decoded_units;
-      } else {
-        /* Unexpected code unit. */
-        retval = CGPT_FAILED;
-        break;
-      }
-    } else {
-      /* parsing a new code point. */
-      decoded_units = 1;
-      if (code_unit <= 0x7F) {
-        code_point = code_unit;
-        expected_units = 1;
-      } else if (code_unit <= 0xBF) {
-        /* 0x80-0xBF must NOT be the heading byte unit of a new code point. */
-        retval = CGPT_FAILED;
-        break;
-      } else if (code_unit >= 0xC2 && code_unit <= 0xDF) {
-        code_point = code_unit & 0x1F;
-        expected_units = 2;
-      } else if (code_unit >= 0xE0 && code_unit <= 0xEF) {
-        code_point = code_unit & 0x0F;
-        expected_units = 3;
-      } else if (code_unit >= 0xF0 && code_unit <= 0xF4) {
-        code_point = code_unit & 0x07;
-        expected_units = 4;
-      } else {
-        /* illegal code unit: 0xC0-0xC1, 0xF5-0xFF */
-        retval = CGPT_FAILED;
-        break;
-      }
-    }
-
-    /* If no more unit is needed, output the UTF16 unit(s). */
-    if ((retval == CGPT_OK) &&
-        (expected_units == decoded_units)) {
-      /* Check if the encoding is the shortest possible UTF-8 sequence. */
-      switch (expected_units) {
-        case 2:
-          if (code_point <= 0x7F) retval = CGPT_FAILED;
-          break;
-        case 3:
-          if (code_point <= 0x7FF) retval = CGPT_FAILED;
-          break;
-        case 4:
-          if (code_point <= 0xFFFF) retval = CGPT_FAILED;
-          break;
-      }
-      if (retval == CGPT_FAILED) break;  /* leave immediately */
-
-      if ((code_point <= 0xD7FF) ||
-          (code_point >= 0xE000 && code_point <= 0xFFFF)) {
-        utf16[s16idx++] = code_point;
-        maxoutput -= 1;
-      } else if (code_point >= 0x10000 && code_point <= 0x10FFFF &&
-                 maxoutput >= 2) {
-        utf16[s16idx++] = 0xD800 | ((code_point >> 10) - 0x0040);
-        utf16[s16idx++] = 0xDC00 | (code_point & 0x03FF);
-        maxoutput -= 2;
-      } else {
-        /* Three possibilities fall into here. Both are failure cases.
-         *   a. surrogate pair (non-BMP characters; 0xD800~0xDFFF)
-         *   b. invalid code point > 0x10FFFF
-         *   c. buffer underrun
-         */
-        retval = CGPT_FAILED;
-        break;
-      }
-    }
-  }
-
-  /* A null-terminator shows up before the UTF8 sequence ends. */
-  if (expected_units != decoded_units) {
-    retval = CGPT_FAILED;
-  }
-
-  utf16[s16idx++] = 0;
-  return retval;
-}
-
 /* global types to compare against */
 const Guid guid_chromeos_firmware = GPT_ENT_TYPE_CHROMEOS_FIRMWARE;
 const Guid guid_chromeos_kernel =   GPT_ENT_TYPE_CHROMEOS_KERNEL;
@@ -612,78 +636,6 @@ const Guid guid_coreos_resize =     GPT_ENT_TYPE_COREOS_RESIZE;
 const Guid guid_coreos_rootfs =     GPT_ENT_TYPE_COREOS_ROOTFS;
 const Guid guid_mswin_data =        GPT_ENT_TYPE_MSWIN_DATA;
 
-static struct {
-  const Guid *type;
-  char *name;
-  char *description;
-} supported_types[] = {
-  // ChromeOS (prefix-less names for backwards compatibility)
-  {&guid_chromeos_firmware, "firmware", "ChromeOS firmware"},
-  {&guid_chromeos_kernel, "kernel", "ChromeOS kernel"},
-  {&guid_chromeos_rootfs, "rootfs", "ChromeOS rootfs"},
-  {&guid_linux_data, "data", "Alias for linux-data"},
-  {&guid_mswin_data, "chromeos-data", "Alias for mswin-data"},
-  {&guid_chromeos_reserved, "reserved", "ChromeOS reserved"},
-
-  // MS Windows (data used to use this GUID instead of linux-data)
-  {&guid_mswin_data, "mswin-data", "MS Windows data"},
-
-  // GPT/UEFI standard types
-  {&guid_efi, "efi", "EFI System Partition"},
-  {&guid_bios, "bios", "BIOS Boot Partition"},
-  {&guid_unused, "unused", "Unused (nonexistent) partition"},
-
-  // General Linux
-  {&guid_linux_data, "linux-data", "Linux data"},
-  {&guid_linux_swap, "linux-swap", "Linux swap"},
-  {&guid_linux_boot, "linux-boot", "Linux /boot"},
-  {&guid_linux_home, "linux-home", "Linux /home"},
-  {&guid_linux_lvm, "linux-lvm", "Linux LVM"},
-  {&guid_linux_raid, "linux-raid", "Linux RAID"},
-  {&guid_linux_reserved, "linux-reserved", "Linux reserved"},
-
-  // CoreOS
-  {&guid_coreos_rootfs, "coreos-usr", "Alias for coreos-rootfs"},
-  {&guid_coreos_rootfs, "coreos-rootfs", "CoreOS rootfs"},
-  {&guid_coreos_resize, "coreos-resize", "CoreOS auto-resize"},
-  {&guid_coreos_reserved, "coreos-reserved", "CoreOS reserved"},
-};
-
-/* Resolves human-readable GPT type.
- * Returns CGPT_OK if found.
- * Returns CGPT_FAILED if no known type found. */
-int ResolveType(const Guid *type, char *buf) {
-  int i;
-  for (i = 0; i < ARRAY_COUNT(supported_types); ++i) {
-    if (!memcmp(type, supported_types[i].type, sizeof(Guid))) {
-      strcpy(buf, supported_types[i].description);
-      return CGPT_OK;
-    }
-  }
-  return CGPT_FAILED;
-}
-
-int SupportedType(const char *name, Guid *type) {
-  int i;
-  for (i = 0; i < ARRAY_COUNT(supported_types); ++i) {
-    if (!strcmp(name, supported_types[i].name)) {
-      memcpy(type, supported_types[i].type, sizeof(Guid));
-      return CGPT_OK;
-    }
-  }
-  return CGPT_FAILED;
-}
-
-void PrintTypes(void) {
-  int i;
-  printf("The partition type may also be given as one of these aliases:\n\n");
-  for (i = 0; i < ARRAY_COUNT(supported_types); ++i) {
-    printf("    %-16s  %s\n", supported_types[i].name,
-                          supported_types[i].description);
-  }
-  printf("\n");
-}
-
 GptHeader* GetGptHeader(const GptData *gpt) {
   if (gpt->valid_headers & MASK_PRIMARY)
     return (GptHeader*)gpt->primary_header;
@@ -702,11 +654,19 @@ uint32_t GetNumberOfEntries(const struct drive *drive) {
 
 
 GptEntry *GetEntry(GptData *gpt, int secondary, uint32_t entry_index) {
-  GptHeader *header = GetGptHeader(gpt);
   uint8_t *entries;
-  uint32_t stride = header->size_of_entry;
-  require(stride);
-  require(entry_index < header->number_of_entries);
+  uint32_t stride;
+
+  // Checked tables are always canonical, so only others need the header.
+  if (gpt->canonical_layout) {
+    stride = sizeof(GptEntry);
+    require(entry_index < TOTAL_ENTRIES_SIZE / sizeof(GptEntry));
+  } else {
+    GptHeader *header = GetGptHeader(gpt);
+    stride = header->size_of_entry;
+    require(stride);
+    require(entry_index < header->number_of_entries);
+  }
 
   if (secondary == PRIMARY) {
     entries = gpt->primary_entries;
@@ -725,6 +685,27 @@ GptEntry *GetEntry(GptData *gpt, int secondary, uint32_t entry_index) {
   return (GptEntry*)(&entries[stride * entry_index]);
 }
 
+// GptEntry is packed, so its name may not be aligned for the UTF16
+// converters. They work on an aligned copy instead.
+int EntryLabel(const GptEntry *entry, char *buf, size_t len) {
+  uint16_t name[ARRAY_COUNT(entry->name)];
+
+  memcpy(name, entry->name, sizeof(name));
+  return UTF16ToUTF8(name, ARRAY_COUNT(name), (uint8_t *)buf, len);
+}
+
+int SetEntryLabel(GptEntry *entry, const char *label) {
+  uint16_t name[ARRAY_COUNT(entry->name)];
+
+  // The converter doesn't clear what follows the terminator, so start from
+  // the current name to leave unchanged labels byte for byte the same.
+  memcpy(name, entry->name, sizeof(name));
+  if (CGPT_OK != UTF8ToUTF16((const uint8_t *)label, name, ARRAY_COUNT(name)))
+    return CGPT_FAILED;
+  memcpy(entry->name, name, sizeof(name));
+  return CGPT_OK;
+}
+
 void SetLegacyBootable(struct drive *drive, int secondary,
                        uint32_t entry_index, int bootable) {
   GptEntry *entry;
@@ -796,25 +777,26 @@ void UpdateAllEntries(struct drive *drive) {
 
   drive->gpt.modified |= (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1 |
                          GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2);
+  drive->gpt.modified_entry_sectors = 0;
   UpdateCrc(&drive->gpt);
 }
 
 int IsUnused(struct drive *drive, int secondary, uint32_t index) {
   GptEntry *entry;
   entry = GetEntry(&drive->gpt, secondary, index);
-  return GuidIsZero(&entry->type);
+  return ClassifyType(&entry->type, NULL) == CGPT_TYPE_UNUSED;
 }
 
 int IsKernel(struct drive *drive, int secondary, uint32_t index) {
   GptEntry *entry;
   entry = GetEntry(&drive->gpt, secondary, index);
-  return GuidEqual(&entry->type, &guid_chromeos_kernel);
+  return ClassifyType(&entry->type, NULL) == CGPT_TYPE_KERNEL;
 }
 
 int IsRoot(struct drive *drive, int secondary, uint32_t index) {
   GptEntry *entry;
   entry = GetEntry(&drive->gpt, secondary, index);
-  return GuidEqual(&entry->type, &guid_coreos_rootfs);
+  return ClassifyType(&entry->type, NULL) == CGPT_TYPE_ROOT;
 }
 
 
@@ -979,6 +961,33 @@ int GuidIsZero(const Guid *gp) {
   return GuidEqual(gp, &guid_unused);
 }
 
+// Fill in an empty GPT header for the drive, and copy it to the secondary.
+int InitGpt(struct drive *drive) {
+  GptHeader *h = (GptHeader *)drive->gpt.primary_header;
+  memcpy(h->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+  h->revision = GPT_HEADER_REVISION;
+  h->size = sizeof(GptHeader);
+  h->my_lba = 1;
+  h->alternate_lba = drive->gpt.drive_sectors - 1;
+  h->first_usable_lba = 1 + 1 + GPT_ENTRIES_SECTORS;
+  h->last_usable_lba = drive->gpt.drive_sectors - 1 - GPT_ENTRIES_SECTORS - 1;
+  if (!uuid_generator) {
+    Error("Unable to generate new GUID. uuid_generator not set.\n");
+    return CGPT_FAILED;
+  }
+  (*uuid_generator)((uint8_t *)&h->disk_uuid);
+  h->entries_lba = 2;
+  h->number_of_entries = 128;
+  h->size_of_entry = sizeof(GptEntry);
+
+  // Copy to secondary
+  RepairHeader(&drive->gpt, MASK_PRIMARY);
+
+  UpdateCrc(&drive->gpt);
+
+  return CGPT_OK;
+}
+
 void InitPMBR(struct drive *drive, int secondary) {
   memset(&drive->pmbr, 0, sizeof(drive->pmbr));
   UpdatePMBR(drive, secondary);
@@ -1126,6 +1135,23 @@ void PMBRToStr(struct pmbr *pmbr, char *str, unsigned int buflen) {
   }
 }
 
+/* Print a label in double quotes, escaping it for the manifest format or
+ * for JSON. */
+void PrintQuoted(const char *str, int json) {
+  const unsigned char *c;
+
+  putchar('"');
+  for (c = (const unsigned char *)str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      printf("\\%c", *c);
+    else if (*c < 0x20 || *c == 0x7f)
+      printf(json ? "\\u%04x" : "\\x%02x", *c);
+    else
+      putchar(*c);
+  }
+  putchar('"');
+}
+
 #define DEV_DIR "/dev"
 #define SYS_BLOCK_DIR "/sys/block"
 #define BUFSIZE 1024
@@ -9,35 +9,10 @@
 #include "cgptlib_internal.h"
 #include "vboot_host.h"
 
-static int initialize_gpt(struct drive *drive) {
-  GptHeader *h = (GptHeader *)drive->gpt.primary_header;
-  memcpy(h->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
-  h->revision = GPT_HEADER_REVISION;
-  h->size = sizeof(GptHeader);
-  h->my_lba = 1;
-  h->alternate_lba = drive->gpt.drive_sectors - 1;
-  h->first_usable_lba = 1 + 1 + GPT_ENTRIES_SECTORS;
-  h->last_usable_lba = drive->gpt.drive_sectors - 1 - GPT_ENTRIES_SECTORS - 1;
-  if (!uuid_generator) {
-    Error("Unable to generate new GUID. uuid_generator not set.\n");
-    return CGPT_FAILED;
-  }
-  (*uuid_generator)((uint8_t *)&h->disk_uuid);
-  h->entries_lba = 2;
-  h->number_of_entries = 128;
-  h->size_of_entry = sizeof(GptEntry);
-
-  // Copy to secondary
-  RepairHeader(&drive->gpt, MASK_PRIMARY);
-
-  UpdateCrc(&drive->gpt);
-
-  return CGPT_OK;
-}
-
 int CgptCreate(CgptCreateParams *params) {
   struct drive drive;
   int mode = O_RDWR;
+  int rv;
 
   if (params == NULL)
     return CGPT_FAILED;
@@ -48,6 +23,9 @@ int CgptCreate(CgptCreateParams *params) {
   if (CGPT_OK != DriveOpen(params->drive_name, &drive, params->min_size, mode))
     return CGPT_FAILED;
 
+  if (params->discard && CGPT_OK != DriveTrackFreed(&drive))
+    goto bad;
+
   // Erase the data
   memset(drive.gpt.primary_header, 0,
          drive.gpt.sector_bytes * GPT_HEADER_SECTOR);
@@ -65,14 +43,16 @@ int CgptCreate(CgptCreateParams *params) {
   // Initialize a blank set
   if (!params->zap)
   {
-    if (CGPT_OK != initialize_gpt(&drive))
+    if (CGPT_OK != InitGpt(&drive))
       goto bad;
 
     InitPMBR(&drive, PRIMARY);
   }
 
-  if (CGPT_OK != WritePMBR(&drive))
-    goto bad;
+  if (CGPT_OK != (rv = WritePMBR(&drive))) {
+    DriveClose(&drive, 0);
+    return rv;
+  }
 
   // Write it all out
   return DriveClose(&drive, 1);
@@ -0,0 +1,81 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "vboot_host.h"
+
+int CgptDump(CgptDumpParams *params) {
+  struct drive drive;
+  GptHeader *header;
+  char disk_guid[GUID_STRLEN], type[GUID_STRLEN], unique[GUID_STRLEN];
+  char label[GPT_PARTNAME_LEN];
+  uint32_t i;
+  int gpt_retval, first = 1;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDONLY))
+    return CGPT_FAILED;
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    DriveClose(&drive, 0);
+    return CGPT_FAILED;
+  }
+
+  header = (GptHeader *)((drive.gpt.valid_headers & MASK_PRIMARY) ?
+                          drive.gpt.primary_header :
+                          drive.gpt.secondary_header);
+  GuidToStr(&header->disk_uuid, disk_guid, sizeof(disk_guid));
+  if (params->json) {
+    printf("{\"disk_guid\":\"%s\",\"first_lba\":%llu,\"last_lba\":%llu,"
+           "\"partitions\":[", disk_guid,
+           (unsigned long long)header->first_usable_lba,
+           (unsigned long long)header->last_usable_lba);
+  } else {
+    printf("# first-lba: %llu\n# last-lba: %llu\ndisk-guid: %s\n",
+           (unsigned long long)header->first_usable_lba,
+           (unsigned long long)header->last_usable_lba, disk_guid);
+  }
+
+  for (i = 0; i < GetNumberOfEntries(&drive); i++) {
+    GptEntry *entry = GetEntry(&drive.gpt, ANY_VALID, i);
+
+    if (GuidIsZero(&entry->type))
+      continue;
+
+    GuidToStr(&entry->type, type, sizeof(type));
+    GuidToStr(&entry->unique, unique, sizeof(unique));
+    EntryLabel(entry, label, sizeof(label));
+    if (params->json) {
+      printf("%s{\"number\":%d,\"start\":%llu,\"size\":%llu,\"type\":\"%s\","
+             "\"guid\":\"%s\",\"attrs\":\"0x%llx\",\"label\":",
+             first ? "" : ",", i + 1,
+             (unsigned long long)entry->starting_lba,
+             (unsigned long long)(entry->ending_lba - entry->starting_lba + 1),
+             type, unique, (unsigned long long)entry->attrs.whole);
+      PrintQuoted(label, 1);
+      putchar('}');
+    } else {
+      printf("%d: start=%llu size=%llu type=%s guid=%s attrs=0x%llx label=",
+             i + 1, (unsigned long long)entry->starting_lba,
+             (unsigned long long)(entry->ending_lba - entry->starting_lba + 1),
+             type, unique, (unsigned long long)entry->attrs.whole);
+      PrintQuoted(label, 0);
+      putchar('\n');
+    }
+    first = 0;
+  }
+
+  if (params->json)
+    printf("]}\n");
+
+  DriveClose(&drive, 0);
+  return CGPT_OK;
+}
@@ -105,7 +105,7 @@ static int do_search(CgptFindParams *params, char *fileName) {
   for (i = 0; i < GetNumberOfEntries(&drive); ++i) {
     entry = GetEntry(&drive.gpt, ANY_VALID, i);
 
-    if (GuidIsZero(&entry->type))
+    if (ClassifyType(&entry->type, NULL) == CGPT_TYPE_UNUSED)
       continue;
 
     int found = 0;
@@ -113,9 +113,7 @@ static int do_search(CgptFindParams *params, char *fileName) {
         || (params->set_type && GuidEqual(&params->type_guid, &entry->type))) {
       found = 1;
     } else if (params->set_label) {
-      if (CGPT_OK != UTF16ToUTF8(entry->name,
-                                 sizeof(entry->name) / sizeof(entry->name[0]),
-                                 (uint8_t *)partlabel, sizeof(partlabel))) {
+      if (CGPT_OK != EntryLabel(entry, partlabel, sizeof(partlabel))) {
         Error("The label cannot be converted from UTF16, so abort.\n");
         return 0;
       }
@@ -0,0 +1,260 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "copy_utils.h"
+#include "crc32.h"
+#include "vboot_host.h"
+
+#define MOVE_CHECKPOINT_MAGIC "CGPTMOVE"
+#define MOVE_CHECKPOINT_VERSION 1
+
+/* Progress of an interrupted move. The partition table is only updated once
+ * the copy is complete, so the table still describes the old location and
+ * the record only has to identify which move it belongs to. */
+struct move_checkpoint {
+  char magic[8];
+  uint32_t version;
+  uint32_t partition;
+  Guid disk_uuid;
+  Guid unique;
+  uint64_t old_start;
+  uint64_t new_start;
+  uint64_t sectors;
+  uint64_t done;          /* bytes copied, in copy order */
+  uint32_t data_crc32;    /* CRC32 of those bytes */
+  uint32_t crc32;         /* CRC32 of this record, computed with this 0 */
+} __attribute__((packed));
+
+struct move_ctx {
+  int fd;                 /* checkpoint file, or -1 */
+  struct move_checkpoint record;
+};
+
+static uint32_t CheckpointCrc(struct move_checkpoint *record) {
+  uint32_t orig = record->crc32, crc;
+  record->crc32 = 0;
+  crc = Crc32(record, sizeof(*record));
+  record->crc32 = orig;
+  return crc;
+}
+
+static int SaveCheckpoint(const struct copy_state *state, void *arg) {
+  struct move_ctx *ctx = arg;
+
+  ctx->record.done = htole64(state->done);
+  ctx->record.data_crc32 = htole32(state->crc);
+  ctx->record.crc32 = htole32(CheckpointCrc(&ctx->record));
+  if (pwrite(ctx->fd, &ctx->record, sizeof(ctx->record), 0) !=
+      sizeof(ctx->record) || fdatasync(ctx->fd) < 0) {
+    Error("Cannot write checkpoint: %s\n", strerror(errno));
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+/* Open the checkpoint file and pick up the state of a previous attempt at
+ * the same move, if there is one. */
+static int LoadCheckpoint(const char *path, struct move_ctx *ctx,
+                          uint64_t len, struct copy_state *state) {
+  struct move_checkpoint saved;
+  ssize_t n;
+
+  ctx->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (ctx->fd < 0) {
+    Error("Can't open checkpoint %s: %s\n", path, strerror(errno));
+    return CGPT_FAILED;
+  }
+
+  n = pread(ctx->fd, &saved, sizeof(saved), 0);
+  if (n == 0)
+    return CGPT_OK;   /* fresh move */
+  if (n != sizeof(saved) ||
+      memcmp(saved.magic, MOVE_CHECKPOINT_MAGIC, sizeof(saved.magic)) ||
+      le32toh(saved.version) != MOVE_CHECKPOINT_VERSION ||
+      le32toh(saved.crc32) != CheckpointCrc(&saved)) {
+    Error("Checkpoint %s is not valid\n", path);
+    return CGPT_FAILED;
+  }
+
+  // Everything but the progress has to match the move being requested.
+  if (memcmp(&saved, &ctx->record,
+             offsetof(struct move_checkpoint, done))) {
+    Error("Checkpoint %s belongs to a different move\n", path);
+    return CGPT_FAILED;
+  }
+
+  state->done = le64toh(saved.done);
+  state->crc = le32toh(saved.data_crc32);
+  if (state->done > len) {
+    Error("Checkpoint %s is not valid\n", path);
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+static void CloseCheckpoint(const char *path, struct move_ctx *ctx,
+                            int finished) {
+  if (ctx->fd < 0)
+    return;
+  close(ctx->fd);
+  ctx->fd = -1;
+  if (finished && unlink(path) < 0)
+    Error("Can't remove checkpoint %s: %s\n", path, strerror(errno));
+}
+
+int CgptMove(CgptMoveParams *params) {
+  struct drive drive;
+  struct move_ctx ctx;
+  struct copy_state state;
+  GptEntry *entry, backup;
+  uint64_t sector_bytes, old_start, sectors, src, dst, len;
+  uint32_t index, copied_crc, dst_crc;
+  int backward, gpt_retval, rv;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  memset(&ctx, 0, sizeof(ctx));
+  memset(&state, 0, sizeof(state));
+  ctx.fd = -1;
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDWR))
+    return CGPT_FAILED;
+
+  if (CGPT_OK != ReadPMBR(&drive)) {
+    Error("Unable to read PMBR\n");
+    goto bad;
+  }
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+
+  if (((drive.gpt.valid_headers & MASK_BOTH) != MASK_BOTH) ||
+      ((drive.gpt.valid_entries & MASK_BOTH) != MASK_BOTH)) {
+    Error("one of the GPT header/entries is invalid.\n"
+          "please run 'cgpt repair' before moving anything.\n");
+    goto bad;
+  }
+
+  if (params->partition == 0 ||
+      params->partition > GetNumberOfEntries(&drive)) {
+    Error("invalid partition number: %d\n", params->partition);
+    goto bad;
+  }
+  index = params->partition - 1;
+
+  if (IsUnused(&drive, PRIMARY, index)) {
+    Error("partition %d does not exist\n", params->partition);
+    goto bad;
+  }
+
+  entry = GetEntry(&drive.gpt, PRIMARY, index);
+  memcpy(&backup, entry, sizeof(backup));
+  sector_bytes = drive.gpt.sector_bytes;
+  old_start = entry->starting_lba;
+  sectors = entry->ending_lba - entry->starting_lba + 1;
+
+  if (old_start == params->begin)
+    return DriveClose(&drive, 0);
+
+  // Check the new location against the rest of the table before touching
+  // any data; the entry is only written out after the copy is verified.
+  entry->starting_lba = params->begin;
+  entry->ending_lba = params->begin + sectors - 1;
+  UpdateAllEntries(&drive);
+  gpt_retval = CheckEntries((GptEntry*)drive.gpt.primary_entries,
+                            (GptHeader*)drive.gpt.primary_header);
+  if (gpt_retval != GPT_SUCCESS) {
+    memcpy(entry, &backup, sizeof(*entry));
+    Error("%s\n", GptErrorText(gpt_retval));
+    goto bad;
+  }
+
+  src = old_start * sector_bytes;
+  dst = params->begin * sector_bytes;
+  len = sectors * sector_bytes;
+  backward = copy_is_backward(src, dst, len);
+
+  if (params->checkpoint) {
+    GptHeader *header = (GptHeader*)drive.gpt.primary_header;
+
+    memcpy(ctx.record.magic, MOVE_CHECKPOINT_MAGIC, sizeof(ctx.record.magic));
+    ctx.record.version = htole32(MOVE_CHECKPOINT_VERSION);
+    ctx.record.partition = htole32(params->partition);
+    memcpy(&ctx.record.disk_uuid, &header->disk_uuid, sizeof(Guid));
+    memcpy(&ctx.record.unique, &entry->unique, sizeof(Guid));
+    ctx.record.old_start = htole64(old_start);
+    ctx.record.new_start = htole64(params->begin);
+    ctx.record.sectors = htole64(sectors);
+    if (CGPT_OK != LoadCheckpoint(params->checkpoint, &ctx, len, &state))
+      goto bad;
+    if (state.done && params->verbose)
+      printf("Resuming move of partition %d at byte %llu of %llu\n",
+             params->partition, (unsigned long long)state.done,
+             (unsigned long long)len);
+  }
+
+  if (CGPT_OK != copy_range(drive.fd, src, drive.fd, dst, len, &state,
+                            params->checkpoint ? SaveCheckpoint : NULL,
+                            &ctx)) {
+    Error("Failed to copy partition %d, table left unchanged\n",
+          params->partition);
+    goto bad;
+  }
+  // The data has to be on disk before the table points at it.
+  if (!params->checkpoint && fdatasync(drive.fd) < 0) {
+    Error("Cannot flush copied data: %s\n", strerror(errno));
+    goto bad;
+  }
+
+  // Overlapping copies destroy part of the source, so they are checked
+  // against the CRC accumulated while copying. Otherwise compare both sides.
+  if (src < dst + len && dst < src + len) {
+    copied_crc = state.crc;
+  } else if (CGPT_OK != crc_range(drive.fd, src, len, 0, state.chunk,
+                                  &copied_crc)) {
+    goto bad;
+  }
+  if (CGPT_OK != crc_range(drive.fd, dst, len, backward, state.chunk,
+                           &dst_crc))
+    goto bad;
+  if (copied_crc != dst_crc) {
+    Error("Verification of partition %d data failed, table left unchanged\n",
+          params->partition);
+    goto bad;
+  }
+
+  UpdatePMBR(&drive, PRIMARY);
+  if ((rv = WritePMBR(&drive)) != CGPT_OK) {
+    if (rv != CGPT_CONFLICT)
+      Error("Failed to write legacy MBR.\n");
+    CloseCheckpoint(params->checkpoint, &ctx, 0);
+    DriveClose(&drive, 0);
+    return rv;
+  }
+
+  if (CGPT_OK != DriveClose(&drive, 1)) {
+    CloseCheckpoint(params->checkpoint, &ctx, 0);
+    return CGPT_FAILED;
+  }
+  CloseCheckpoint(params->checkpoint, &ctx, 1);
+  return CGPT_OK;
+
+bad:
+  CloseCheckpoint(params->checkpoint, &ctx, 0);
+  DriveClose(&drive, 0);
+  return CGPT_FAILED;
+}
@@ -90,7 +90,7 @@ static int scan_real_devs(CgptNextParams *params) {
 
 int CgptNext(CgptNextParams *params) {
   struct drive drive;
-  GptEntry *entry;
+  GptEntry *entry, old;
   char tmp[64];
   int tries;
   next_index = -1;
@@ -117,6 +117,7 @@ int CgptNext(CgptNextParams *params) {
     }
 
     // Decrement tries if we selected on that criteria
+    memcpy(&old, GetEntry(&drive.gpt, PRIMARY, next_index), sizeof(old));
     tries = GetTries(&drive, PRIMARY, next_index);
     if (tries > 0) {
       tries--;
@@ -128,8 +129,10 @@ int CgptNext(CgptNextParams *params) {
     GuidToStrLower(&entry->unique, tmp, sizeof(tmp));
     printf("%s\n", tmp);
 
-    // Write it all out
-    UpdateAllEntries(&drive);
+    // Write it out, only the one changed entry sector if the table was
+    // consistent to begin with
+    if (GPT_SUCCESS != GptEntryModified(&drive.gpt, next_index, &old))
+      UpdateAllEntries(&drive);
     return DriveClose(&drive, 1);
   }
 
@@ -3,44 +3,374 @@
 // found in the LICENSE file.
 
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "cgpt.h"
 #include "cgptlib_internal.h"
+#include "output_utils.h"
 #include "vboot_host.h"
 
-int CgptRepair(CgptRepairParams *params) {
-  struct drive drive;
+#define PROC_PARTITIONS "/proc/partitions"
 
-  if (params == NULL)
-    return CGPT_FAILED;
+// How far back from the end of a drive to look for a displaced backup
+// header, and how much of that to read at once.
+#define DISCOVER_SCAN_BYTES (8ULL << 30)
+#define DISCOVER_CHUNK_BYTES (1 << 20)
+
+struct repair_drive {
+  char *path;
+  int found;                  /* by --all, so not having a GPT is fine */
+};
+
+struct repair_job {
+  CgptRepairParams *params;
+  struct repair_drive *drives;
+  uint32_t num_drives;
+  int single;                 /* one drive, reported the way it always was */
+  uint32_t next;              /* next drive to repair, shared */
+  uint32_t failed;
+  int status;                 /* of the failure, for a single drive */
+};
+
+/* Where the plan of one drive goes, see ReportRun(). */
+struct repair_plan {
+  struct output *out;
+  const char *path;
+  int dry_run;
+};
+
+static void ReportRun(void *ctx, const char *what, uint64_t lba,
+                      uint64_t sectors) {
+  struct repair_plan *plan = ctx;
+
+  out_str(plan->out, plan->path);
+  out_str(plan->out, plan->dry_run ? ": would write " : ": wrote ");
+  out_str(plan->out, what);
+  out_str(plan->out, ", ");
+  out_uint(plan->out, sectors, 0);
+  out_str(plan->out, sectors == 1 ? " sector at LBA " : " sectors at LBA ");
+  out_uint(plan->out, lba, 0);
+  if (sectors > 1) {
+    out_char(plan->out, '-');
+    out_uint(plan->out, lba + sectors - 1, 0);
+  }
+  out_char(plan->out, '\n');
+}
+
+/* Sizes drives and images commonly had before they grew, in MB (10^6). */
+static const uint64_t media_mb[] = {
+  128, 256, 512, 1000, 2000, 4000, 8000, 16000, 32000, 64000, 120000,
+  128000, 240000, 250000, 256000, 480000, 500000, 512000, 1000000,
+  2000000, 3000000, 4000000, 6000000, 8000000, 10000000, 12000000,
+  14000000, 16000000, 18000000, 20000000,
+};
+
+/* Is there a valid backup header at 'lba', with valid entries right below
+ * it, for a drive that ended there? If so, it is kept as the secondary. */
+static int TryBackupAt(struct drive *drive, uint64_t lba,
+                       uint8_t *header, uint8_t *entries) {
+  GptData *gpt = &drive->gpt;
+  uint32_t sector_bytes = gpt->sector_bytes;
+
+  if (lba <= GPT_PMBR_SECTOR + GPT_HEADER_SECTOR + 2 * GPT_ENTRIES_SECTORS ||
+      lba >= gpt->drive_sectors - 1)
+    return 0;
+  if (pread(drive->fd, header, sector_bytes, lba * sector_bytes) !=
+      sector_bytes)
+    return 0;
+  if (CheckHeader((GptHeader *)header, 1, lba + 1))
+    return 0;
+  if (pread(drive->fd, entries, TOTAL_ENTRIES_SIZE,
+            (lba - GPT_ENTRIES_SECTORS) * sector_bytes) != TOTAL_ENTRIES_SIZE)
+    return 0;
+  if (CheckEntries((GptEntry *)entries, (GptHeader *)header))
+    return 0;
+
+  memcpy(gpt->secondary_header, header, sector_bytes);
+  memcpy(gpt->secondary_entries, entries, TOTAL_ENTRIES_SIZE);
+  return 1;
+}
+
+static int HasSignature(const uint8_t *sector) {
+  return !memcmp(sector, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE - 1) ||
+         !memcmp(sector, GPT_HEADER_SIGNATURE2, GPT_HEADER_SIGNATURE_SIZE - 1);
+}
+
+/* Look for the backup header a drive had before it grew, which is no longer
+ * at the end. The likely places are tried first: where a damaged primary
+ * still says it is, then the ends of drives of common sizes. Failing that,
+ * the end of the drive is scanned backwards, in large reads. Returns the
+ * LBA of the backup header, or 0 if there isn't one. */
+static uint64_t DiscoverBackup(struct drive *drive) {
+  GptData *gpt = &drive->gpt;
+  GptHeader *primary = (GptHeader *)gpt->primary_header;
+  uint32_t sector_bytes = gpt->sector_bytes;
+  uint64_t chunk_sectors = DISCOVER_CHUNK_BYTES / sector_bytes;
+  uint64_t lba = 0, floor, start, end, s, bytes;
+  uint8_t *header, *entries, *buf = NULL;
+  uint32_t i;
+
+  header = malloc(sector_bytes);
+  entries = malloc(TOTAL_ENTRIES_SIZE);
+  require(header && entries);
+
+  // The primary's CRC may be off, but its pointers may still be right.
+  if (HasSignature(gpt->primary_header)) {
+    if (TryBackupAt(drive, primary->alternate_lba, header, entries)) {
+      lba = primary->alternate_lba;
+      goto done;
+    }
+    s = primary->last_usable_lba + GPT_ENTRIES_SECTORS + 1;
+    if (TryBackupAt(drive, s, header, entries)) {
+      lba = s;
+      goto done;
+    }
+  }
 
-  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDWR))
+  for (i = 0; i < ARRAY_COUNT(media_mb); i++) {
+    s = media_mb[i] * 1000000 / sector_bytes - 1;
+    if (TryBackupAt(drive, s, header, entries)) {
+      lba = s;
+      goto done;
+    }
+  }
+  for (bytes = 1 << 20; bytes / sector_bytes < gpt->drive_sectors;
+       bytes <<= 1) {
+    s = bytes / sector_bytes - 1;
+    if (TryBackupAt(drive, s, header, entries)) {
+      lba = s;
+      goto done;
+    }
+  }
+
+  buf = malloc(chunk_sectors * sector_bytes);
+  require(buf);
+  posix_fadvise(drive->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  floor = GPT_PMBR_SECTOR + GPT_HEADER_SECTOR + 2 * GPT_ENTRIES_SECTORS;
+  if (gpt->drive_sectors - floor > DISCOVER_SCAN_BYTES / sector_bytes)
+    floor = gpt->drive_sectors - DISCOVER_SCAN_BYTES / sector_bytes;
+  for (end = gpt->drive_sectors - 1; end > floor; end = start) {
+    start = end - floor > chunk_sectors ? end - chunk_sectors : floor;
+    bytes = (end - start) * sector_bytes;
+    if (pread(drive->fd, buf, bytes, start * sector_bytes) != (ssize_t)bytes)
+      break;
+    for (s = end; s-- > start; ) {
+      if (HasSignature(buf + (s - start) * sector_bytes) &&
+          TryBackupAt(drive, s, header, entries)) {
+        lba = s;
+        goto done;
+      }
+    }
+  }
+
+done:
+  free(buf);
+  free(entries);
+  free(header);
+  return lba;
+}
+
+static int RepairDrive(const struct repair_job *job,
+                       const struct repair_drive *target,
+                       struct output *out) {
+  CgptRepairParams *params = job->params;
+  struct repair_plan plan = { out, target->path, params->dry_run };
+  struct drive drive;
+  struct drive_snapshot old;
+  uint32_t count = 0;
+  int gpt_retval, rv;
+
+  if (CGPT_OK != DriveOpen(target->path, &drive, 0,
+                           params->dry_run ? O_RDONLY : O_RDWR))
     return CGPT_FAILED;
+  memset(&old, 0, sizeof(old));
 
   if (CGPT_OK != ReadPMBR(&drive)) {
-    Error("Unable to read PMBR\n");
+    Error("Unable to read PMBR of %s\n", target->path);
+  }
+
+  gpt_retval = GptSanityCheck(&drive.gpt);
+  if (params->verbose) {
+    if (!job->single) {
+      out_str(out, target->path);
+      out_str(out, ": ");
+    }
+    out_str(out, "GptSanityCheck() returned ");
+    out_uint(out, gpt_retval, 0);
+    out_str(out, ": ");
+    out_str(out, GptError(gpt_retval));
+    out_char(out, '\n');
   }
 
-  int gpt_retval = GptSanityCheck(&drive.gpt);
-  if (params->verbose)
-    printf("GptSanityCheck() returned %d: %s\n",
-           gpt_retval, GptError(gpt_retval));
+  DriveSnapshot(&drive, &old);
 
-  GptRepair(&drive.gpt);
-  if (drive.gpt.modified & GPT_MODIFIED_HEADER1)
-    printf("Primary Header is updated.\n");
-  if (drive.gpt.modified & GPT_MODIFIED_ENTRIES1)
-    printf("Primary Entries is updated.\n");
-  if (drive.gpt.modified & GPT_MODIFIED_ENTRIES2)
-    printf("Secondary Entries is updated.\n");
-  if (drive.gpt.modified & GPT_MODIFIED_HEADER2)
-    printf("Secondary Header is updated.\n");
+  // The backup found is taken over whatever is left of the primary, and
+  // both copies are rebuilt from it for the drive's current size.
+  if (params->discover && gpt_retval != GPT_SUCCESS) {
+    uint64_t lba = DiscoverBackup(&drive);
+    if (lba) {
+      uint64_t drive_sectors = drive.gpt.drive_sectors;
+      memset(drive.gpt.primary_header, 0, drive.gpt.sector_bytes);
+      drive.gpt.drive_sectors = lba + 1;
+      gpt_retval = GptSanityCheck(&drive.gpt);
+      drive.gpt.drive_sectors = drive_sectors;
+      if (!job->single) {
+        out_str(out, target->path);
+        out_str(out, ": ");
+      }
+      out_str(out, "Backup header found at LBA ");
+      out_uint(out, lba, 0);
+      out_str(out, ".\n");
+    }
+  }
+
+  // A drive without a single good header has nothing to repair from, and
+  // may well be holding something other than a GPT, so it is left alone.
+  // A single drive keeps getting a fresh PMBR, as it always did.
+  if (!job->single && gpt_retval == GPT_ERROR_INVALID_HEADERS) {
+    out_str(out, target->path);
+    out_str(out, ": no valid GPT header, not repaired\n");
+    rv = target->found ? CGPT_OK : CGPT_FAILED;
+    goto close;
+  }
 
+  GptRepair(&drive.gpt);
+  if (job->single) {
+    if (drive.gpt.modified & GPT_MODIFIED_HEADER1)
+      out_str(out, "Primary Header is updated.\n");
+    if (drive.gpt.modified & GPT_MODIFIED_ENTRIES1)
+      out_str(out, "Primary Entries is updated.\n");
+    if (drive.gpt.modified & GPT_MODIFIED_ENTRIES2)
+      out_str(out, "Secondary Entries is updated.\n");
+    if (drive.gpt.modified & GPT_MODIFIED_HEADER2)
+      out_str(out, "Secondary Header is updated.\n");
+  }
   UpdatePMBR(&drive, ANY_VALID);
-  if (WritePMBR(&drive) != CGPT_OK) {
-    Error("Failed to write legacy MBR.\n");
+
+  // Only the sectors that actually differ are written, so a drive that
+  // just needs one copy of the table fixed gets only that.
+  if (!params->dry_run && CGPT_OK != (rv = DriveLockUnchanged(&drive)))
+    goto close;
+  rv = DriveWriteChanged(&drive, &old, params->dry_run, &count,
+                         job->single ? NULL : ReportRun, &plan);
+  if (rv != CGPT_OK) {
+    Error("Cannot write %s: %s\n", target->path, strerror(errno));
+    goto close;
+  }
+
+  if (!job->single) {
+    out_str(out, target->path);
+    if (count) {
+      out_str(out, ": ");
+      out_uint(out, count, 0);
+      out_str(out, count == 1 ? " sector" : " sectors");
+      out_str(out, params->dry_run ? " to write\n" : " written\n");
+    } else {
+      out_str(out, ": nothing to repair\n");
+    }
+  }
+
+close:
+  DriveSnapshotFree(&old);
+  // Everything is written already, this only flushes it, once.
+  if (CGPT_OK != DriveClose(&drive, 0) && rv == CGPT_OK)
+    rv = CGPT_FAILED;
+  return rv;
+}
+
+static void *RepairWorker(void *arg) {
+  struct repair_job *job = arg;
+  struct output *out = malloc(sizeof(*out));
+  uint32_t i;
+  int rv;
+
+  require(out);
+  while ((i = __sync_fetch_and_add(&job->next, 1)) < job->num_drives) {
+    // Each drive's report is printed in one piece.
+    out_init(out, stdout);
+    rv = RepairDrive(job, &job->drives[i], out);
+    out_flush(out);
+    if (rv != CGPT_OK) {
+      __sync_fetch_and_add(&job->failed, 1);
+      job->status = rv;
+    }
+  }
+  free(out);
+  return NULL;
+}
+
+static void AddDrive(struct repair_job *job, const char *path, int found) {
+  uint32_t i;
+
+  for (i = 0; i < job->num_drives; i++)
+    if (!strcmp(job->drives[i].path, path))
+      return;
+  job->drives = realloc(job->drives,
+                        (job->num_drives + 1) * sizeof(*job->drives));
+  require(job->drives);
+  job->drives[job->num_drives].path = strdup(path);
+  require(job->drives[job->num_drives].path);
+  job->drives[job->num_drives].found = found;
+  job->num_drives++;
+}
+
+/* Add every whole disk listed in /proc/partitions. */
+static int AddAllDrives(struct repair_job *job) {
+  char line[1024];
+  char partname[128];                   // max size for /proc/partition lines?
+  FILE *fp;
+  char *pathname;
+
+  fp = fopen(PROC_PARTITIONS, "r");
+  if (!fp) {
+    Error("can't read %s: %s\n", PROC_PARTITIONS, strerror(errno));
+    return CGPT_FAILED;
   }
 
-  return DriveClose(&drive, 1);
+  while (fgets(line, sizeof(line), fp)) {
+    int ma, mi;
+    long long unsigned int sz;
+
+    if (sscanf(line, " %d %d %llu %127[^\n ]", &ma, &mi, &sz, partname) != 4)
+      continue;
+
+    if ((pathname = IsWholeDev(partname)))
+      AddDrive(job, pathname, 1);
+  }
+
+  fclose(fp);
+  return CGPT_OK;
+}
+
+int CgptRepair(CgptRepairParams *params) {
+  struct repair_job job;
+  uint32_t i;
+  int rv;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  memset(&job, 0, sizeof(job));
+  job.params = params;
+  for (i = 0; i < params->num_drives; i++)
+    AddDrive(&job, params->drives[i], 0);
+  if (params->all && CGPT_OK != AddAllDrives(&job))
+    job.failed++;
+  job.single = !params->all && !params->dry_run && job.num_drives == 1;
+
+  RunWorkers(job.single ? 1 : params->jobs, job.num_drives, RepairWorker,
+             &job);
+
+  if (!job.failed)
+    rv = CGPT_OK;
+  else
+    rv = job.single ? job.status : CGPT_FAILED;
+  for (i = 0; i < job.num_drives; i++)
+    free(job.drives[i].path);
+  free(job.drives);
+  return rv;
 }
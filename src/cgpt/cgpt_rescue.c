@@ -0,0 +1,419 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "copy_utils.h"
+#include "endian.h"
+#include "vboot_host.h"
+
+/* The drive is read this much at a time, plus enough of what follows to
+ * see all of a superblock that starts right before the end of the chunk. */
+#define RESCUE_CHUNK_BYTES COPY_CHUNK_BYTES
+#define RESCUE_PROBE_BYTES 4096
+#define RESCUE_ALIGN 4096
+
+#define DEFAULT_ALIGNMENT 8
+
+#define RESCUE_LABEL_BYTES 17       /* ext and swap labels are the longest */
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define EXT2_SUPER_MAGIC 0xef53
+#define EXT3_FEATURE_COMPAT_HAS_JOURNAL 0x0004
+#define EXT4_FEATURE_INCOMPAT_EXTENTS 0x0040
+#define EXT4_FEATURE_INCOMPAT_64BIT 0x0080
+#define SQUASHFS_MAGIC 0x73717368
+
+/* A filesystem found on the drive. */
+struct rescue_fs {
+  uint64_t offset;                  /* in bytes, like size */
+  uint64_t size;
+  const char *kind;                 /* "ext4", "vfat", ... */
+  const char *type;                 /* of the partition to propose */
+  char label[RESCUE_LABEL_BYTES];
+};
+
+struct rescue_job {
+  const CgptRescueParams *params;
+  int fd;
+  uint64_t size;                    /* of the drive */
+  uint64_t step;                    /* bytes between places to look */
+  uint64_t num_chunks;
+  uint64_t next;                    /* next chunk to read, shared */
+  uint64_t done;                    /* bytes read so far, shared */
+  uint32_t errors;                  /* chunks that couldn't be read, shared */
+  pthread_mutex_t lock;             /* for everything below */
+  struct rescue_fs *found;
+  uint32_t num_found;
+  int progress;
+  uint32_t percent;
+  struct timespec started;
+};
+
+static uint16_t Le16(const uint8_t *p) {
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return le16toh(v);
+}
+
+static uint32_t Le32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return le32toh(v);
+}
+
+static uint64_t Le64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return le64toh(v);
+}
+
+static uint32_t Be32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return be32toh(v);
+}
+
+static uint64_t Be64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return be64toh(v);
+}
+
+static int IsPowerOfTwo(uint64_t n) {
+  return n && !(n & (n - 1));
+}
+
+/* Copy a fixed size label, which may be padded with NULs or spaces. */
+static void CopyLabel(char *label, const uint8_t *p, size_t len) {
+  size_t n;
+
+  for (n = 0; n < len && n < RESCUE_LABEL_BYTES - 1 && p[n]; n++)
+    label[n] = p[n];
+  while (n > 0 && label[n - 1] == ' ')
+    n--;
+  label[n] = '\0';
+}
+
+/* The probes below look at the start of a would-be partition, and have
+ * RESCUE_PROBE_BYTES of it. They fill in the size, kind, type and label of
+ * what they recognize. */
+
+/* The same fields e2size reads through libext2fs, straight from the
+ * superblock. Backup superblocks don't count, only the one of group 0. */
+static int ProbeExt(const uint8_t *p, struct rescue_fs *fs) {
+  const uint8_t *sb = p + 1024;
+  uint32_t log_block_size, incompat;
+  uint64_t blocks;
+
+  if (Le16(sb + 0x38) != EXT2_SUPER_MAGIC || Le16(sb + 0x5a) != 0)
+    return 0;
+  log_block_size = Le32(sb + 0x18);
+  if (log_block_size > 6 || Le32(sb + 0x14) != (log_block_size == 0))
+    return 0;
+  incompat = Le32(sb + 0x60);
+  blocks = Le32(sb + 0x04);
+  if (incompat & EXT4_FEATURE_INCOMPAT_64BIT)
+    blocks |= (uint64_t)Le32(sb + 0x150) << 32;
+  if (!blocks)
+    return 0;
+
+  fs->size = blocks << (10 + log_block_size);
+  if (incompat & EXT4_FEATURE_INCOMPAT_EXTENTS)
+    fs->kind = "ext4";
+  else if (Le32(sb + 0x5c) & EXT3_FEATURE_COMPAT_HAS_JOURNAL)
+    fs->kind = "ext3";
+  else
+    fs->kind = "ext2";
+  fs->type = "data";
+  CopyLabel(fs->label, sb + 0x78, 16);
+  return 1;
+}
+
+static int ProbeXfs(const uint8_t *p, struct rescue_fs *fs) {
+  uint32_t block_size = Be32(p + 4);
+  uint64_t blocks = Be64(p + 8);
+
+  if (memcmp(p, "XFSB", 4) || !IsPowerOfTwo(block_size) ||
+      block_size < 512 || block_size > 65536 || !blocks)
+    return 0;
+
+  fs->size = blocks * block_size;
+  fs->kind = "xfs";
+  fs->type = "data";
+  CopyLabel(fs->label, p + 108, 12);
+  return 1;
+}
+
+static int ProbeFat(const uint8_t *p, struct rescue_fs *fs) {
+  uint32_t sector_size = Le16(p + 11), sectors;
+
+  if (p[510] != 0x55 || p[511] != 0xaa || !IsPowerOfTwo(sector_size) ||
+      sector_size < 512 || sector_size > 4096 || !IsPowerOfTwo(p[13]) ||
+      !Le16(p + 14) || p[16] < 1 || p[16] > 2)
+    return 0;
+  sectors = Le16(p + 19);
+  if (!sectors)
+    sectors = Le32(p + 32);
+  if (!sectors)
+    return 0;
+
+  // The PMBR and other boot sectors have the 0x55aa too, but not these.
+  if (!Le16(p + 22) && !memcmp(p + 82, "FAT32   ", 8))
+    CopyLabel(fs->label, p + 71, 11);
+  else if (!memcmp(p + 54, "FAT1", 4))
+    CopyLabel(fs->label, p + 43, 11);
+  else
+    return 0;
+  if (!strcmp(fs->label, "NO NAME"))
+    fs->label[0] = '\0';
+
+  fs->size = (uint64_t)sectors * sector_size;
+  fs->kind = "vfat";
+  fs->type = "efi";
+  return 1;
+}
+
+static int ProbeSquashfs(const uint8_t *p, struct rescue_fs *fs) {
+  uint32_t block_size = Le32(p + 12);
+  uint64_t bytes_used = Le64(p + 40);
+
+  if (Le32(p) != SQUASHFS_MAGIC || Le16(p + 28) != 4 ||
+      !IsPowerOfTwo(block_size) || block_size < 4096 ||
+      block_size > (1 << 20) || !bytes_used)
+    return 0;
+
+  // mksquashfs pads the image to 4 KiB.
+  fs->size = (bytes_used + 4095) & ~4095ULL;
+  fs->kind = "squashfs";
+  fs->type = "data";
+  return 1;
+}
+
+/* Swap with 4 KiB pages, the only kind that fits in RESCUE_PROBE_BYTES. */
+static int ProbeSwap(const uint8_t *p, struct rescue_fs *fs) {
+  if (memcmp(p + 4096 - 10, "SWAPSPACE2", 10) || Le32(p + 1024) != 1)
+    return 0;
+
+  fs->size = ((uint64_t)Le32(p + 1028) + 1) * 4096;
+  fs->kind = "swap";
+  fs->type = "linux-swap";
+  CopyLabel(fs->label, p + 1052, 16);
+  return 1;
+}
+
+static int (*const probes[])(const uint8_t *p, struct rescue_fs *fs) = {
+  ProbeExt, ProbeXfs, ProbeFat, ProbeSquashfs, ProbeSwap,
+};
+
+static void Probe(struct rescue_job *job, const uint8_t *p, uint64_t offset) {
+  struct rescue_fs fs;
+  uint32_t i;
+
+  for (i = 0; i < ARRAY_COUNT(probes); i++) {
+    memset(&fs, 0, sizeof(fs));
+    if (!probes[i](p, &fs))
+      continue;
+    fs.offset = offset;
+    pthread_mutex_lock(&job->lock);
+    job->found = realloc(job->found,
+                         (job->num_found + 1) * sizeof(*job->found));
+    require(job->found);
+    job->found[job->num_found++] = fs;
+    pthread_mutex_unlock(&job->lock);
+    return;
+  }
+}
+
+static void Progress(struct rescue_job *job, uint64_t bytes) {
+  uint64_t done = __sync_add_and_fetch(&job->done, bytes);
+  uint32_t percent = done * 100 / job->size;
+  struct timespec now;
+  double seconds;
+
+  if (!job->progress)
+    return;
+  pthread_mutex_lock(&job->lock);
+  if (percent > job->percent) {
+    job->percent = percent;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    seconds = (now.tv_sec - job->started.tv_sec) +
+              (now.tv_nsec - job->started.tv_nsec) / 1e9;
+    fprintf(stderr, "\rScanning %s: %3u%%, %.0f MiB/s",
+            job->params->drive_name, percent,
+            seconds > 0 ? done / seconds / (1 << 20) : 0.0);
+  }
+  pthread_mutex_unlock(&job->lock);
+}
+
+/* Read exactly len bytes, returns 0 or an errno value. */
+static int ReadFully(int fd, uint8_t *buf, size_t len, uint64_t offset) {
+  while (len) {
+    ssize_t n = pread(fd, buf, len, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return errno;
+    if (n == 0)
+      return EIO;
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+static void *RescueWorker(void *arg) {
+  struct rescue_job *job = arg;
+  uint64_t i, start, end, len, data, stop, offset;
+  uint8_t *buf = NULL;
+  int err;
+
+  require(!posix_memalign((void **)&buf, RESCUE_ALIGN,
+                          RESCUE_CHUNK_BYTES + RESCUE_PROBE_BYTES));
+  while ((i = __sync_fetch_and_add(&job->next, 1)) < job->num_chunks) {
+    start = i * RESCUE_CHUNK_BYTES;
+    end = MIN(start + RESCUE_CHUNK_BYTES, job->size);
+    len = MIN(end + RESCUE_PROBE_BYTES, job->size) - start;
+
+    // Holes in an image can't hold a superblock, so they aren't read.
+    data = start;
+    find_data(job->fd, &data, &stop, start + len);
+    if (data < start + len) {
+      if ((err = ReadFully(job->fd, buf, len, start))) {
+        Error("Cannot read %s at offset %llu: %s\n", job->params->drive_name,
+              (unsigned long long)start, strerror(err));
+        __sync_fetch_and_add(&job->errors, 1);
+      } else {
+        memset(buf + len, 0, RESCUE_CHUNK_BYTES + RESCUE_PROBE_BYTES - len);
+        for (offset = (start + job->step - 1) / job->step * job->step;
+             offset < end; offset += job->step)
+          Probe(job, buf + (offset - start), offset);
+      }
+    }
+    Progress(job, end - start);
+  }
+  free(buf);
+  return NULL;
+}
+
+static int CompareFound(const void *a, const void *b) {
+  const struct rescue_fs *x = a, *y = b;
+
+  if (x->offset != y->offset)
+    return x->offset < y->offset ? -1 : 1;
+  if (x->size != y->size)
+    return x->size > y->size ? -1 : 1;
+  return 0;
+}
+
+/* Print the filesystems that can be partitions as a manifest. The first
+ * one found at an offset wins, and whatever lies inside it, like the
+ * secondary superblocks of XFS or an image stored in the filesystem, is
+ * left out. Returns the number of partitions. */
+static uint32_t PrintTable(const CgptRescueParams *params, struct drive *drive,
+                           struct rescue_fs *found, uint32_t num_found) {
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+  uint64_t first, last, next, sectors;
+  uint32_t i, num = 0;
+  const char *why;
+
+  first = (GPT_PMBR_SECTOR + GPT_HEADER_SECTOR + GPT_ENTRIES_SECTORS) *
+          (uint64_t)sector_bytes;
+  last = drive->size - (GPT_HEADER_SECTOR + GPT_ENTRIES_SECTORS) *
+                       (uint64_t)sector_bytes;
+  next = first;
+
+  qsort(found, num_found, sizeof(*found), CompareFound);
+  printf("# Partitions found on %s by \"cgpt rescue\". Each is as large\n"
+         "# as its filesystem, it may have been larger.\n",
+         params->drive_name);
+  for (i = 0; i < num_found; i++) {
+    struct rescue_fs *fs = &found[i];
+
+    sectors = (fs->size + sector_bytes - 1) / sector_bytes;
+    why = NULL;
+    if (fs->offset < next)
+      why = num ? "inside the partition before" : "in the GPT";
+    else if (fs->offset + sectors * sector_bytes > last)
+      why = "past the end of the drive";
+    else if (num == MAX_NUMBER_OF_ENTRIES)
+      why = "no room in the table";
+    if (why) {
+      if (params->verbose)
+        printf("# left out %s of %llu bytes at byte %llu, %s\n", fs->kind,
+               (unsigned long long)fs->size,
+               (unsigned long long)fs->offset, why);
+      continue;
+    }
+
+    num++;
+    printf("# %s of %llu bytes at byte %llu\n", fs->kind,
+           (unsigned long long)fs->size, (unsigned long long)fs->offset);
+    printf("%u: start=%llu size=%llu type=%s", num,
+           (unsigned long long)(fs->offset / sector_bytes),
+           (unsigned long long)sectors, fs->type);
+    if (fs->label[0]) {
+      printf(" label=");
+      PrintQuoted(fs->label, 0);
+    }
+    putchar('\n');
+    next = fs->offset + sectors * sector_bytes;
+  }
+  return num;
+}
+
+int CgptRescue(CgptRescueParams *params) {
+  struct rescue_job job;
+  struct drive drive;
+  int rv = CGPT_OK;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDONLY))
+    return CGPT_FAILED;
+
+  memset(&job, 0, sizeof(job));
+  job.params = params;
+  job.fd = drive.fd;
+  job.size = drive.size;
+  job.step = (uint64_t)(params->alignment ? params->alignment :
+                        DEFAULT_ALIGNMENT) * drive.gpt.sector_bytes;
+  job.num_chunks = (job.size + RESCUE_CHUNK_BYTES - 1) / RESCUE_CHUNK_BYTES;
+  job.progress = !params->quiet && isatty(STDERR_FILENO);
+  pthread_mutex_init(&job.lock, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &job.started);
+  posix_fadvise(job.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // Each thread takes the next chunk, so the drive is still read more or
+  // less in order, with several reads in flight.
+  RunWorkers(params->jobs, job.num_chunks, RescueWorker, &job);
+  if (job.progress)
+    fputc('\n', stderr);
+
+  if (!PrintTable(params, &drive, job.found, job.num_found)) {
+    Error("No filesystems found on %s\n", params->drive_name);
+    rv = CGPT_FAILED;
+  }
+  if (job.errors) {
+    Error("%u part(s) of %s could not be read, filesystems there were "
+          "missed\n", job.errors, params->drive_name);
+    rv = CGPT_FAILED;
+  }
+
+  free(job.found);
+  pthread_mutex_destroy(&job.lock);
+  DriveClose(&drive, 0);
+  return rv;
+}
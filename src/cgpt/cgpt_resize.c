@@ -56,11 +56,12 @@ static int resize_partition(CgptResizeParams *params, blkid_dev dev) {
   struct drive drive;
   GptHeader *header;
   GptEntry *entry;
-  int gpt_retval, entry_index, entry_count;
+  int gpt_retval, entry_index, entry_count, rv;
   uint64_t free_bytes, last_free_lba, entry_size_lba;
 
   if ((disk_devname = dev_to_wholedevname(dev)) == NULL) {
-    Error("Failed to find whole disk device for %s\n", blkid_dev_devname(dev));
+    Error("Failed to find whole disk device for %s\n",
+          sym_blkid_dev_devname(dev));
     return CGPT_FAILED;
   }
 
@@ -99,7 +100,7 @@ static int resize_partition(CgptResizeParams *params, blkid_dev dev) {
   for (int i = 0; i < entry_count; i++) {
     GptEntry *other = GetEntry(&drive.gpt, PRIMARY, i);
 
-    if (GuidIsZero(&other->type))
+    if (ClassifyType(&other->type, NULL) == CGPT_TYPE_UNUSED)
       continue;
 
     if (other->starting_lba > entry->ending_lba &&
@@ -140,9 +141,11 @@ static int resize_partition(CgptResizeParams *params, blkid_dev dev) {
   }
 
   UpdatePMBR(&drive, PRIMARY);
-  if (WritePMBR(&drive) != CGPT_OK) {
-    Error("Failed to write legacy MBR.\n");
-    goto nope;
+  if ((rv = WritePMBR(&drive)) != CGPT_OK) {
+    if (rv != CGPT_CONFLICT)
+      Error("Failed to write legacy MBR.\n");
+    DriveClose(&drive, 0);
+    return rv;
   }
 
   // Whew! we made it! Flush to disk.
@@ -164,10 +167,14 @@ int CgptResize(CgptResizeParams *params) {
   if (params == NULL || params->partition_desc == NULL)
     return CGPT_FAILED;
 
-  if (blkid_get_cache(&cache, NULL) < 0)
+  if (CGPT_OK != load_blkid())
+    return CGPT_FAILED;
+
+  if (sym_blkid_get_cache(&cache, NULL) < 0)
     goto exit;
 
-  found_dev = blkid_get_dev(cache, params->partition_desc, BLKID_DEV_NORMAL);
+  found_dev = sym_blkid_get_dev(cache, params->partition_desc,
+                                BLKID_DEV_NORMAL);
 
   if (!found_dev) {
     Error("device not found %s\n", params->partition_desc);
@@ -177,6 +184,6 @@ int CgptResize(CgptResizeParams *params) {
   err = resize_partition(params, found_dev);
 
 exit:
-  blkid_put_cache(cache);
+  sym_blkid_put_cache(cache);
   return err;
 }
@@ -2,14 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-#define __STDC_FORMAT_MACROS
-
 #include <string.h>
-#include <inttypes.h>
 
 #include "cgpt.h"
 #include "cgptlib_internal.h"
 #include "crc32.h"
+#include "output_utils.h"
 #include "vboot_host.h"
 
 /* Generate output like:
@@ -43,129 +41,479 @@ static void RawDump(const uint8_t *memory, const int size,
   buf[outlen++] = '\0';
 }
 
-/* Output formatters */
-#define TITLE_FMT      "%12s%12s%8s  %s\n"
-#define GPT_FMT        "%12" PRIu64 "%12" PRIu64 "%8s  %s\n"
-#define GPT_MORE       "%12s%12s%8s  ", "", "", ""
-#define PARTITION_FMT  "%12" PRIu64 "%12" PRIu64 "%8d  %s\n"
-#define PARTITION_MORE "%12s%12s%8s  %s%s\n", "", "", ""
+/* Output formatters. Rows are laid out as
+ *   "%12llu%12llu%8s  %s\n" for start, size, part, contents
+ * and details go below the contents column. */
+#define NUM_WIDTH   12
+#define PART_WIDTH  8
+#define MORE_INDENT (2 * NUM_WIDTH + PART_WIDTH + 2)
+
+static void TitleRow(struct output *out) {
+  out_str_padded(out, "start", NUM_WIDTH);
+  out_str_padded(out, "size", NUM_WIDTH);
+  out_str_padded(out, "part", PART_WIDTH);
+  out_str(out, "  contents\n");
+}
 
-static void HeaderDetails(GptHeader *header, GptEntry *entries,
-                          const char *indent, int raw) {
-  int i;
+static void GptRow(struct output *out, uint64_t start, uint64_t size,
+                   const char *part, const char *contents) {
+  out_uint(out, start, NUM_WIDTH);
+  out_uint(out, size, NUM_WIDTH);
+  out_str_padded(out, part, PART_WIDTH);
+  out_spaces(out, 2);
+  out_str(out, contents);
+  out_char(out, '\n');
+}
+
+/* Start a detail line, leaving the caller to finish it with a newline. */
+static void More(struct output *out, const char *name) {
+  out_spaces(out, MORE_INDENT);
+  out_str(out, name);
+}
 
-  printf("%sSig: ", indent);
+static void MoreStr(struct output *out, const char *name, const char *value) {
+  More(out, name);
+  out_str(out, value);
+  out_char(out, '\n');
+}
+
+static void MoreUint(struct output *out, const char *name, uint64_t value) {
+  More(out, name);
+  out_uint(out, value, 0);
+  out_char(out, '\n');
+}
+
+static void MoreHex32(struct output *out, const char *name, uint32_t value) {
+  More(out, name);
+  out_str(out, "0x");
+  out_hex(out, value, 8);
+}
+
+static void HeaderDetails(struct output *out, GptHeader *header,
+                          GptEntry *entries, int raw) {
+  More(out, "Sig: ");
   if (!raw) {
-    printf("[");
-    for (i = 0; i < sizeof(header->signature); ++i)
-      printf("%c", header->signature[i]);
-    printf("]");
+    out_char(out, '[');
+    out_bytes(out, header->signature, sizeof(header->signature));
+    out_char(out, ']');
   } else {
     char buf[BUFFER_SIZE(sizeof(header->signature))];
     RawDump((uint8_t *)header->signature, sizeof(header->signature), buf, 1);
-    printf("%s", buf);
-  }
-  printf("\n");
-
-  printf("%sRev: 0x%08x\n", indent, header->revision);
-  printf("%sSize: %u\n", indent, header->size);
-  printf("%sHeader CRC: 0x%08x %s\n", indent, header->header_crc32,
-         (HeaderCrc(header) != header->header_crc32) ? "(INVALID)" : "");
-  printf("%sMy LBA: %" PRIu64 "\n", indent, header->my_lba);
-  printf("%sAlternate LBA: %" PRIu64 "\n", indent, header->alternate_lba);
-  printf("%sFirst LBA: %" PRIu64 "\n", indent, header->first_usable_lba);
-  printf("%sLast LBA: %" PRIu64 "\n", indent, header->last_usable_lba);
-
-  {  /* For disk guid */
-    char buf[GUID_STRLEN];
-    GuidToStr(&header->disk_uuid, buf, GUID_STRLEN);
-    printf("%sDisk UUID: %s\n", indent, buf);
+    out_str(out, buf);
   }
+  out_char(out, '\n');
+
+  MoreHex32(out, "Rev: ", header->revision);
+  out_char(out, '\n');
+  MoreUint(out, "Size: ", header->size);
+  MoreHex32(out, "Header CRC: ", header->header_crc32);
+  out_str(out, (HeaderCrc(header) != header->header_crc32) ?
+               " (INVALID)\n" : " \n");
+  MoreUint(out, "My LBA: ", header->my_lba);
+  MoreUint(out, "Alternate LBA: ", header->alternate_lba);
+  MoreUint(out, "First LBA: ", header->first_usable_lba);
+  MoreUint(out, "Last LBA: ", header->last_usable_lba);
+  More(out, "Disk UUID: ");
+  out_guid(out, &header->disk_uuid);
+  out_char(out, '\n');
+  MoreUint(out, "Entries LBA: ", header->entries_lba);
+  MoreUint(out, "Number of entries: ", header->number_of_entries);
+  MoreUint(out, "Size of entry: ", header->size_of_entry);
+  MoreHex32(out, "Entries CRC: ", header->entries_crc32);
+  out_str(out, header->entries_crc32 !=
+               Crc32((const uint8_t *)entries, header->size_of_entry *
+                                               header->number_of_entries)
+               ? " INVALID\n" : " \n");
+}
 
-  printf("%sEntries LBA: %" PRIu64 "\n", indent, header->entries_lba);
-  printf("%sNumber of entries: %u\n", indent, header->number_of_entries);
-  printf("%sSize of entry: %u\n", indent, header->size_of_entry);
-  printf("%sEntries CRC: 0x%08x %s\n", indent, header->entries_crc32,
-         header->entries_crc32 !=
-             Crc32((const uint8_t *)entries,header->size_of_entry *
-                                            header->number_of_entries)
-             ? "INVALID" : ""
-         );
+static void EntryRow(struct output *out, GptEntry *entry, uint32_t index,
+                     int raw) {
+  char label[GPT_PARTNAME_LEN];
+  const char *type;
+  enum cgpt_type class = ClassifyType(&entry->type, &type);
+
+  EntryLabel(entry, label, sizeof(label));
+  out_uint(out, entry->starting_lba, NUM_WIDTH);
+  out_uint(out, entry->ending_lba - entry->starting_lba + 1U, NUM_WIDTH);
+  out_uint(out, index + 1, PART_WIDTH);
+  out_str(out, "  Label: \"");
+  out_str(out, label);
+  out_str(out, "\"\n");
+
+  More(out, "Type: ");
+  if (!raw && class != CGPT_TYPE_UNKNOWN)
+    out_str(out, type);
+  else
+    out_guid(out, &entry->type);
+  out_char(out, '\n');
+  More(out, "UUID: ");
+  out_guid(out, &entry->unique);
+  out_char(out, '\n');
+
+  if (raw) {
+    More(out, "Attr: 0x");
+    out_hex(out, entry->attrs.whole, 16);
+    out_char(out, '\n');
+  } else if (class == CGPT_TYPE_KERNEL || class == CGPT_TYPE_ROOT) {
+    More(out, "Attr: priority=");
+    out_uint(out, GetEntryPriority(entry), 0);
+    out_str(out, " tries=");
+    out_uint(out, GetEntryTries(entry), 0);
+    out_str(out, " successful=");
+    out_uint(out, GetEntrySuccessful(entry), 0);
+    out_char(out, '\n');
+  } else if (GetEntryLegacyBootable(entry)) {
+    MoreStr(out, "Attr: ", "Legacy BIOS Bootable");
+  }
 }
 
 void EntryDetails(GptEntry *entry, uint32_t index, int raw) {
-  char contents[256];                   // scratch buffer for formatting output
-  uint8_t label[GPT_PARTNAME_LEN];
+  struct output out;
 
-  if (!raw) {
-    char type[GUID_STRLEN], unique[GUID_STRLEN];
-
-    UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
-                label, sizeof(label));
-    require(snprintf(contents, sizeof(contents),
-                     "Label: \"%s\"", label) < sizeof(contents));
-    printf(PARTITION_FMT, entry->starting_lba,
-           (entry->ending_lba - entry->starting_lba + 1U),
-           index+1, contents);
-    if (CGPT_OK == ResolveType(&entry->type, type)) {
-      printf(PARTITION_MORE, "Type: ", type);
-    } else {
-      GuidToStr(&entry->type, type, GUID_STRLEN);
-      printf(PARTITION_MORE, "Type: ", type);
-    }
-    GuidToStr(&entry->unique, unique, GUID_STRLEN);
-    printf(PARTITION_MORE, "UUID: ", unique);
-    if (GuidEqual(&guid_chromeos_kernel, &entry->type) ||
-        GuidEqual(&guid_coreos_rootfs, &entry->type)) {
-      int tries = (entry->attrs.fields.gpt_att &
-                   CGPT_ATTRIBUTE_TRIES_MASK) >>
-          CGPT_ATTRIBUTE_TRIES_OFFSET;
-      int successful = (entry->attrs.fields.gpt_att &
-                        CGPT_ATTRIBUTE_SUCCESSFUL_MASK) >>
-          CGPT_ATTRIBUTE_SUCCESSFUL_OFFSET;
-      int priority = (entry->attrs.fields.gpt_att &
-                      CGPT_ATTRIBUTE_PRIORITY_MASK) >>
-          CGPT_ATTRIBUTE_PRIORITY_OFFSET;
-      require(snprintf(contents, sizeof(contents),
-                       "priority=%d tries=%d successful=%d",
-                       priority, tries, successful) < sizeof(contents));
-      printf(PARTITION_MORE, "Attr: ", contents);
-    } else if (GetEntryLegacyBootable(entry)) {
-      printf(PARTITION_MORE, "Attr: ", "Legacy BIOS Bootable");
-    }
-  } else {
-    char type[GUID_STRLEN], unique[GUID_STRLEN];
-
-    UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
-                label, sizeof(label));
-    require(snprintf(contents, sizeof(contents),
-                     "Label: \"%s\"", label) < sizeof(contents));
-    printf(PARTITION_FMT, entry->starting_lba,
-           (entry->ending_lba - entry->starting_lba + 1U),
-           index+1, contents);
-    GuidToStr(&entry->type, type, GUID_STRLEN);
-    printf(PARTITION_MORE, "Type: ", type);
-    GuidToStr(&entry->unique, unique, GUID_STRLEN);
-    printf(PARTITION_MORE, "UUID: ", unique);
-    require(snprintf(contents, sizeof(contents), "0x%016" PRIx64,
-                     entry->attrs.whole) < sizeof(contents));
-    printf(PARTITION_MORE, "Attr: ", contents);
-  }
+  out_init(&out, stdout);
+  EntryRow(&out, entry, index, raw);
+  out_flush(&out);
 }
 
-
-void EntriesDetails(struct drive *drive, const int secondary, int raw) {
+static void EntriesDetails(struct output *out, struct drive *drive,
+                           const int secondary, int raw) {
   uint32_t i;
 
   for (i = 0; i < GetNumberOfEntries(drive); ++i) {
     GptEntry *entry;
     entry = GetEntry(&drive->gpt, secondary, i);
 
-    if (GuidIsZero(&entry->type))
+    if (ClassifyType(&entry->type, NULL) == CGPT_TYPE_UNUSED)
+      continue;
+
+    EntryRow(out, entry, i, raw);
+  }
+}
+
+/* JSON output. Every object always has the same keys in the same order so
+ * that the output is stable across versions. */
+static void JsonUint(struct output *out, const char *key, uint64_t value) {
+  out_json_str(out, key);
+  out_char(out, ':');
+  out_uint(out, value, 0);
+}
+
+static void JsonBool(struct output *out, const char *key, int value) {
+  out_json_str(out, key);
+  out_str(out, value ? ":true" : ":false");
+}
+
+static void JsonGuid(struct output *out, const char *key, const Guid *guid) {
+  out_json_str(out, key);
+  out_str(out, ":\"");
+  out_guid(out, guid);
+  out_char(out, '"');
+}
+
+static void JsonHeader(struct output *out, GptHeader *header, int valid,
+                       int entries_valid) {
+  out_char(out, '{');
+  JsonBool(out, "valid", valid);
+  out_char(out, ',');
+  JsonUint(out, "revision", header->revision);
+  out_char(out, ',');
+  JsonUint(out, "size", header->size);
+  out_char(out, ',');
+  JsonUint(out, "header_crc32", header->header_crc32);
+  out_char(out, ',');
+  JsonUint(out, "my_lba", header->my_lba);
+  out_char(out, ',');
+  JsonUint(out, "alternate_lba", header->alternate_lba);
+  out_char(out, ',');
+  JsonUint(out, "first_lba", header->first_usable_lba);
+  out_char(out, ',');
+  JsonUint(out, "last_lba", header->last_usable_lba);
+  out_char(out, ',');
+  JsonGuid(out, "disk_uuid", &header->disk_uuid);
+  out_char(out, ',');
+  JsonUint(out, "entries_lba", header->entries_lba);
+  out_char(out, ',');
+  JsonUint(out, "number_of_entries", header->number_of_entries);
+  out_char(out, ',');
+  JsonUint(out, "size_of_entry", header->size_of_entry);
+  out_char(out, ',');
+  JsonUint(out, "entries_crc32", header->entries_crc32);
+  out_char(out, ',');
+  JsonBool(out, "entries_valid", entries_valid);
+  out_char(out, '}');
+}
+
+const char *const show_field_names[] = {
+  [CGPT_FIELD_NUMBER] = "number",
+  [CGPT_FIELD_START] = "start",
+  [CGPT_FIELD_SIZE] = "size",
+  [CGPT_FIELD_LABEL] = "label",
+  [CGPT_FIELD_TYPE] = "type",
+  [CGPT_FIELD_TYPE_NAME] = "type_name",
+  [CGPT_FIELD_GUID] = "guid",
+  [CGPT_FIELD_ATTRS] = "attrs",
+  [CGPT_FIELD_PRIORITY] = "priority",
+  [CGPT_FIELD_TRIES] = "tries",
+  [CGPT_FIELD_SUCCESSFUL] = "successful",
+  [CGPT_FIELD_LEGACY_BOOT] = "legacy_boot",
+  [CGPT_NUM_FIELDS] = NULL,
+};
+
+/* Print one field of a partition, decoding nothing else. JSON values are
+ * quoted where needed, text values are printed as they are. */
+static void FieldValue(struct output *out, GptEntry *entry, uint32_t index,
+                       int field, int json) {
+  char label[GPT_PARTNAME_LEN];
+  const char *type;
+
+  switch (field) {
+  case CGPT_FIELD_NUMBER:
+    out_uint(out, index + 1, 0);
+    break;
+  case CGPT_FIELD_START:
+    out_uint(out, entry->starting_lba, 0);
+    break;
+  case CGPT_FIELD_SIZE:
+    out_uint(out, entry->ending_lba - entry->starting_lba + 1U, 0);
+    break;
+  case CGPT_FIELD_LABEL:
+    EntryLabel(entry, label, sizeof(label));
+    if (json)
+      out_json_str(out, label);
+    else
+      out_str(out, label);
+    break;
+  case CGPT_FIELD_TYPE:
+  case CGPT_FIELD_GUID:
+    if (json)
+      out_char(out, '"');
+    out_guid(out, field == CGPT_FIELD_TYPE ? &entry->type : &entry->unique);
+    if (json)
+      out_char(out, '"');
+    break;
+  case CGPT_FIELD_TYPE_NAME:
+    if (ClassifyType(&entry->type, &type) == CGPT_TYPE_UNKNOWN) {
+      if (json)
+        out_str(out, "null");
+      else
+        out_guid(out, &entry->type);
+    } else if (json) {
+      out_json_str(out, type);
+    } else {
+      out_str(out, type);
+    }
+    break;
+  case CGPT_FIELD_ATTRS:
+    // As a string, 64-bit numbers don't survive every JSON parser.
+    out_str(out, json ? "\"0x" : "0x");
+    out_hex(out, entry->attrs.whole, 16);
+    if (json)
+      out_char(out, '"');
+    break;
+  case CGPT_FIELD_PRIORITY:
+    out_uint(out, GetEntryPriority(entry), 0);
+    break;
+  case CGPT_FIELD_TRIES:
+    out_uint(out, GetEntryTries(entry), 0);
+    break;
+  case CGPT_FIELD_SUCCESSFUL:
+  case CGPT_FIELD_LEGACY_BOOT:
+    if (field == CGPT_FIELD_SUCCESSFUL ? GetEntrySuccessful(entry) :
+                                         GetEntryLegacyBootable(entry))
+      out_str(out, json ? "true" : "1");
+    else
+      out_str(out, json ? "false" : "0");
+    break;
+  default:
+    out_str(out, "null");
+    break;
+  }
+}
+
+/* The members of a partition object, without the braces. With no fields
+ * selected every field is included. */
+static void JsonEntryMembers(struct output *out, GptEntry *entry,
+                             uint32_t index, CgptShowParams *params) {
+  int i, n = params->num_fields ? params->num_fields : CGPT_NUM_FIELDS;
+
+  for (i = 0; i < n; i++) {
+    int field = params->num_fields ? params->fields[i] : i;
+
+    if (i)
+      out_char(out, ',');
+    out_json_str(out, show_field_names[field]);
+    out_char(out, ':');
+    FieldValue(out, entry, index, field, 1);
+  }
+}
+
+/* The selected fields of a partition as a line of tab separated text. */
+static void TextFields(struct output *out, GptEntry *entry, uint32_t index,
+                       CgptShowParams *params) {
+  int i;
+
+  for (i = 0; i < params->num_fields; i++) {
+    if (i)
+      out_char(out, '\t');
+    FieldValue(out, entry, index, params->fields[i], 0);
+  }
+  out_char(out, '\n');
+}
+
+/* Print the whole table as one JSON object, or each partition as a line of
+ * NDJSON. With a partition number only that partition is included. Selected
+ * fields restrict the output to an array (or lines) of just those, or to
+ * lines of tab separated text. */
+static int ShowPartitions(struct output *out, struct drive *drive,
+                          CgptShowParams *params) {
+  GptHeader *primary = (GptHeader *)drive->gpt.primary_header;
+  GptHeader *secondary = (GptHeader *)drive->gpt.secondary_header;
+  GptHeader *header;
+  uint32_t i, first = 0, last = GetNumberOfEntries(drive);
+  int listed = 0;
+  int whole = params->format == CGPT_FORMAT_JSON && !params->num_fields;
+
+  if (params->partition) {
+    if (params->partition > last) {
+      Error("invalid partition number: %d\n", params->partition);
+      return CGPT_FAILED;
+    }
+    first = params->partition - 1;
+    last = params->partition;
+  }
+  header = (drive->gpt.valid_headers & MASK_PRIMARY) ? primary : secondary;
+
+  if (whole) {
+    char pmbr[256];
+
+    if (CGPT_OK != ReadPMBR(drive)) {
+      Error("Unable to read PMBR\n");
+      return CGPT_FAILED;
+    }
+    PMBRToStr(&drive->pmbr, pmbr, sizeof(pmbr));
+
+    out_char(out, '{');
+    out_json_str(out, "drive");
+    out_char(out, ':');
+    out_json_str(out, params->drive_name);
+    out_char(out, ',');
+    JsonUint(out, "sector_bytes", drive->gpt.sector_bytes);
+    out_char(out, ',');
+    JsonUint(out, "drive_sectors", drive->gpt.drive_sectors);
+    out_char(out, ',');
+    out_json_str(out, "pmbr");
+    out_char(out, ':');
+    out_json_str(out, pmbr);
+    out_char(out, ',');
+    JsonGuid(out, "boot_guid", &drive->pmbr.syslinux3.boot_guid);
+    out_char(out, ',');
+    out_json_str(out, "primary");
+    out_char(out, ':');
+    JsonHeader(out, primary, drive->gpt.valid_headers & MASK_PRIMARY,
+               drive->gpt.valid_entries & MASK_PRIMARY);
+    out_char(out, ',');
+    out_json_str(out, "secondary");
+    out_char(out, ':');
+    JsonHeader(out, secondary, drive->gpt.valid_headers & MASK_SECONDARY,
+               drive->gpt.valid_entries & MASK_SECONDARY);
+    out_char(out, ',');
+    out_json_str(out, "partitions");
+    out_str(out, ":[");
+  } else if (params->format == CGPT_FORMAT_JSON) {
+    out_char(out, '[');
+  }
+
+  for (i = first; i < last; i++) {
+    GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, i);
+
+    if (!params->partition &&
+        ClassifyType(&entry->type, NULL) == CGPT_TYPE_UNUSED)
       continue;
 
-    EntryDetails(entry, i, raw);
+    switch (params->format) {
+    case CGPT_FORMAT_TEXT:
+      TextFields(out, entry, i, params);
+      break;
+    case CGPT_FORMAT_JSON:
+      if (listed)
+        out_char(out, ',');
+      out_char(out, '{');
+      JsonEntryMembers(out, entry, i, params);
+      out_char(out, '}');
+      break;
+    case CGPT_FORMAT_NDJSON:
+      out_char(out, '{');
+      if (!params->num_fields) {
+        // Each line stands on its own.
+        out_json_str(out, "drive");
+        out_char(out, ':');
+        out_json_str(out, params->drive_name);
+        out_char(out, ',');
+        JsonGuid(out, "disk_uuid", &header->disk_uuid);
+        out_char(out, ',');
+      }
+      JsonEntryMembers(out, entry, i, params);
+      out_str(out, "}\n");
+      break;
+    }
+    listed++;
   }
+
+  if (whole)
+    out_str(out, "]}\n");
+  else if (params->format == CGPT_FORMAT_JSON)
+    out_str(out, "]\n");
+  return CGPT_OK;
+}
+
+/* Everything that "cgpt show" reports about the table as a whole, with the
+ * entries represented by their CRC32s. Fields of invalid copies are zero.
+ * Stored little endian like the table itself, so that the fingerprint of a
+ * table is the same on any host. */
+struct fingerprint {
+  uint8_t valid_headers;
+  uint8_t valid_entries;
+  uint8_t reserved[6];
+  uint64_t first_usable_lba;
+  uint64_t last_usable_lba;
+  uint32_t number_of_entries;
+  uint32_t size_of_entry;
+  Guid disk_uuid;
+  Guid boot_guid;
+  uint32_t entries_crc32[2];    /* primary, secondary */
+};
+
+/* Format a digest of the table built from the CRCs checked when it was
+ * read, so it changes whenever the output of "cgpt show" would. The PMBR
+ * must have been read too. */
+void DriveFingerprint(struct drive *drive, char *buf) {
+  static const char digits[] = "0123456789abcdef";
+  struct fingerprint fp;
+  uint64_t value;
+  int i;
+  GptHeader *primary = (GptHeader *)drive->gpt.primary_header;
+  GptHeader *secondary = (GptHeader *)drive->gpt.secondary_header;
+  GptHeader *header;
+
+  memset(&fp, 0, sizeof(fp));
+  fp.valid_headers = drive->gpt.valid_headers;
+  fp.valid_entries = drive->gpt.valid_entries;
+  header = (fp.valid_headers & MASK_PRIMARY) ? primary : secondary;
+  fp.first_usable_lba = htole64(header->first_usable_lba);
+  fp.last_usable_lba = htole64(header->last_usable_lba);
+  fp.number_of_entries = htole32(header->number_of_entries);
+  fp.size_of_entry = htole32(header->size_of_entry);
+  memcpy(&fp.disk_uuid, &header->disk_uuid, sizeof(Guid));
+  memcpy(&fp.boot_guid, &drive->pmbr.syslinux3.boot_guid, sizeof(Guid));
+  if (fp.valid_headers & MASK_PRIMARY)
+    fp.entries_crc32[0] = htole32(primary->entries_crc32);
+  if (fp.valid_headers & MASK_SECONDARY)
+    fp.entries_crc32[1] = htole32(secondary->entries_crc32);
+
+  value = (uint64_t)header->entries_crc32 << 32 | Crc32(&fp, sizeof(fp));
+  for (i = FINGERPRINT_STRLEN - 2; i >= 0; i--, value >>= 4)
+    buf[i] = digits[value & 0xf];
+  buf[FINGERPRINT_STRLEN - 1] = '\0';
 }
 
 int CgptGetNumNonEmptyPartitions(CgptShowParams *params) {
@@ -191,7 +539,7 @@ int CgptGetNumNonEmptyPartitions(CgptShowParams *params) {
   int i;
   for(i = 0; i < numEntries; i++) {
       GptEntry *entry = GetEntry(&drive.gpt, ANY_VALID, i);
-      if (GuidIsZero(&entry->type))
+      if (ClassifyType(&entry->type, NULL) == CGPT_TYPE_UNUSED)
         continue;
 
       params->num_partitions++;
@@ -206,6 +554,7 @@ done:
 
 int CgptShow(CgptShowParams *params) {
   struct drive drive;
+  struct output out;
   int gpt_retval;
 
   if (params == NULL)
@@ -220,6 +569,29 @@ int CgptShow(CgptShowParams *params) {
     return CGPT_FAILED;
   }
 
+  if (params->fingerprint) {
+    char fingerprint[FINGERPRINT_STRLEN];
+
+    if (CGPT_OK != ReadPMBR(&drive)) {
+      Error("Unable to read PMBR\n");
+      DriveClose(&drive, 0);
+      return CGPT_FAILED;
+    }
+    DriveFingerprint(&drive, fingerprint);
+    printf("%s\n", fingerprint);
+    DriveClose(&drive, 0);
+    return CGPT_OK;
+  }
+
+  out_init(&out, stdout);
+
+  if (params->format != CGPT_FORMAT_TEXT || params->num_fields) {
+    int retval = ShowPartitions(&out, &drive, params);
+    out_flush(&out);
+    DriveClose(&drive, 0);
+    return retval;
+  }
+
   if (params->partition) {                      // show single partition
 
     if (params->partition > GetNumberOfEntries(&drive)) {
@@ -229,65 +601,66 @@ int CgptShow(CgptShowParams *params) {
 
     uint32_t index = params->partition - 1;
     GptEntry *entry = GetEntry(&drive.gpt, ANY_VALID, index);
-    char buf[256];                      // scratch buffer for string conversion
+    char label[GPT_PARTNAME_LEN];
 
     if (params->single_item) {
       switch(params->single_item) {
       case 'b':
-        printf("%" PRId64 "\n", entry->starting_lba);
+        out_uint(&out, entry->starting_lba, 0);
         break;
       case 's':
-        printf("%" PRId64 "\n", entry->ending_lba - entry->starting_lba + 1);
+        out_uint(&out, entry->ending_lba - entry->starting_lba + 1, 0);
         break;
       case 't':
-        GuidToStr(&entry->type, buf, sizeof(buf));
-        printf("%s\n", buf);
+        out_guid(&out, &entry->type);
         break;
       case 'u':
-        GuidToStr(&entry->unique, buf, sizeof(buf));
-        printf("%s\n", buf);
+        out_guid(&out, &entry->unique);
         break;
       case 'l':
-        UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
-                    (uint8_t *)buf, sizeof(buf));
-        printf("%s\n", buf);
+        EntryLabel(entry, label, sizeof(label));
+        out_str(&out, label);
         break;
       case 'S':
-        printf("%d\n", GetSuccessful(&drive, ANY_VALID, index));
+        out_uint(&out, GetSuccessful(&drive, ANY_VALID, index), 0);
         break;
       case 'T':
-        printf("%d\n", GetTries(&drive, ANY_VALID, index));
+        out_uint(&out, GetTries(&drive, ANY_VALID, index), 0);
         break;
       case 'P':
-        printf("%d\n", GetPriority(&drive, ANY_VALID, index));
+        out_uint(&out, GetPriority(&drive, ANY_VALID, index), 0);
         break;
       case 'A':
-        printf("0x%" PRIx64 "\n", entry->attrs.whole);
+        out_str(&out, "0x");
+        out_hex(&out, entry->attrs.whole, 0);
         break;
       }
+      out_char(&out, '\n');
     } else {
-      printf(TITLE_FMT, "start", "size", "part", "contents");
-      EntryDetails(entry, index, params->numeric);
+      TitleRow(&out);
+      EntryRow(&out, entry, index, params->numeric);
     }
 
   } else if (params->quick) {                   // show all partitions, quickly
     uint32_t i;
     GptEntry *entry;
-    char type[GUID_STRLEN];
+    const char *type;
 
     for (i = 0; i < GetNumberOfEntries(&drive); ++i) {
       entry = GetEntry(&drive.gpt, ANY_VALID, i);
 
-      if (GuidIsZero(&entry->type))
+      if (ClassifyType(&entry->type, &type) == CGPT_TYPE_UNUSED)
         continue;
 
-      if (!params->numeric && CGPT_OK == ResolveType(&entry->type, type)) {
-      } else {
-        GuidToStr(&entry->type, type, GUID_STRLEN);
-      }
-      printf(PARTITION_FMT, entry->starting_lba,
-             (entry->ending_lba - entry->starting_lba + 1U),
-             i+1, type);
+      out_uint(&out, entry->starting_lba, NUM_WIDTH);
+      out_uint(&out, entry->ending_lba - entry->starting_lba + 1U, NUM_WIDTH);
+      out_uint(&out, i + 1, PART_WIDTH);
+      out_spaces(&out, 2);
+      if (!params->numeric && type)
+        out_str(&out, type);
+      else
+        out_guid(&out, &entry->type);
+      out_char(&out, '\n');
     }
   } else {                              // show all partitions
     GptEntry *entries;
@@ -297,43 +670,38 @@ int CgptShow(CgptShowParams *params) {
       return CGPT_FAILED;
     }
 
-    printf(TITLE_FMT, "start", "size", "part", "contents");
+    TitleRow(&out);
     char buf[256];                      // buffer for formatted PMBR content
     PMBRToStr(&drive.pmbr, buf, sizeof(buf)); // will exit if buf is too small
-    printf(GPT_FMT, (uint64_t)0, (uint64_t)GPT_PMBR_SECTOR, "", buf);
+    GptRow(&out, 0, GPT_PMBR_SECTOR, "", buf);
 
     if (drive.gpt.valid_headers & MASK_PRIMARY) {
-      printf(GPT_FMT, (uint64_t)GPT_PMBR_SECTOR,
-             (uint64_t)GPT_HEADER_SECTOR, "", "Pri GPT header");
+      GptRow(&out, GPT_PMBR_SECTOR, GPT_HEADER_SECTOR, "", "Pri GPT header");
     } else {
-      printf(GPT_FMT, (uint64_t)GPT_PMBR_SECTOR,
-             (uint64_t)GPT_HEADER_SECTOR, "INVALID", "Pri GPT header");
+      GptRow(&out, GPT_PMBR_SECTOR, GPT_HEADER_SECTOR, "INVALID",
+             "Pri GPT header");
     }
 
     if (params->debug ||
         ((drive.gpt.valid_headers & MASK_PRIMARY) && params->verbose)) {
       GptHeader *header;
-      char indent[64];
 
-      require(snprintf(indent, sizeof(indent), GPT_MORE) < sizeof(indent));
       header = (GptHeader*)drive.gpt.primary_header;
       entries = (GptEntry*)drive.gpt.primary_entries;
-      HeaderDetails(header, entries, indent, params->numeric);
+      HeaderDetails(&out, header, entries, params->numeric);
     }
 
-    printf(GPT_FMT, (uint64_t)(GPT_PMBR_SECTOR + GPT_HEADER_SECTOR),
-           (uint64_t)GPT_ENTRIES_SECTORS,
+    GptRow(&out, GPT_PMBR_SECTOR + GPT_HEADER_SECTOR, GPT_ENTRIES_SECTORS,
            drive.gpt.valid_entries & MASK_PRIMARY ? "" : "INVALID",
            "Pri GPT table");
 
     if (params->debug ||
         (drive.gpt.valid_entries & MASK_PRIMARY))
-      EntriesDetails(&drive, PRIMARY, params->numeric);
+      EntriesDetails(&out, &drive, PRIMARY, params->numeric);
 
     /****************************** Secondary *************************/
-    printf(GPT_FMT, (drive.gpt.drive_sectors - GPT_HEADER_SECTOR -
-                          GPT_ENTRIES_SECTORS),
-           (uint64_t)GPT_ENTRIES_SECTORS,
+    GptRow(&out, drive.gpt.drive_sectors - GPT_HEADER_SECTOR -
+                 GPT_ENTRIES_SECTORS, GPT_ENTRIES_SECTORS,
            drive.gpt.valid_entries & MASK_SECONDARY ? "" : "INVALID",
            "Sec GPT table");
     /* We show secondary table details if any of following is true.
@@ -346,15 +714,15 @@ int CgptShow(CgptShowParams *params) {
          (!(drive.gpt.valid_entries & MASK_PRIMARY) ||
           memcmp(drive.gpt.primary_entries, drive.gpt.secondary_entries,
                  TOTAL_ENTRIES_SIZE)))) {
-      EntriesDetails(&drive, SECONDARY, params->numeric);
+      EntriesDetails(&out, &drive, SECONDARY, params->numeric);
     }
 
     if (drive.gpt.valid_headers & MASK_SECONDARY)
-      printf(GPT_FMT, (drive.gpt.drive_sectors - GPT_HEADER_SECTOR),
-             (uint64_t)GPT_HEADER_SECTOR, "", "Sec GPT header");
+      GptRow(&out, drive.gpt.drive_sectors - GPT_HEADER_SECTOR,
+             GPT_HEADER_SECTOR, "", "Sec GPT header");
     else
-      printf(GPT_FMT, (uint64_t)GPT_PMBR_SECTOR,
-             (uint64_t)GPT_HEADER_SECTOR, "INVALID", "Sec GPT header");
+      GptRow(&out, GPT_PMBR_SECTOR, GPT_HEADER_SECTOR, "INVALID",
+             "Sec GPT header");
     /* We show secondary header if any of following is true:
      *   1. in debug mode.
      *   2. only secondary is valid.
@@ -367,15 +735,14 @@ int CgptShow(CgptShowParams *params) {
                         (GptHeader*)drive.gpt.secondary_header)) &&
          params->verbose)) {
       GptHeader *header;
-      char indent[64];
 
-      require(snprintf(indent, sizeof(indent), GPT_MORE) < sizeof(indent));
       header = (GptHeader*)drive.gpt.secondary_header;
       entries = (GptEntry*)drive.gpt.secondary_entries;
-      HeaderDetails(header, entries, indent, params->numeric);
+      HeaderDetails(&out, header, entries, params->numeric);
     }
   }
 
+  out_flush(&out);
   CheckValid(&drive);
   DriveClose(&drive, 0);
 
@@ -0,0 +1,323 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "vboot_host.h"
+
+/* The only sector size the GPT library accepts. */
+#define STAMP_SECTOR_BYTES 512
+/* PMBR, primary header and entries, written as one block. */
+#define STAMP_PRIMARY_BYTES \
+  ((GPT_PMBR_SECTOR + GPT_HEADER_SECTOR + GPT_ENTRIES_SECTORS) * \
+   STAMP_SECTOR_BYTES)
+#define STAMP_ENTRIES_OFFSET \
+  ((GPT_PMBR_SECTOR + GPT_HEADER_SECTOR) * STAMP_SECTOR_BYTES)
+
+/* Everything each copy shares with the template, prepared once. */
+struct stamp_template {
+  uint64_t size;                          /* image size in bytes */
+  uint32_t sector_bytes;
+  uint8_t primary[STAMP_PRIMARY_BYTES];
+  uint8_t secondary_header[STAMP_SECTOR_BYTES];
+  uint32_t num_used;
+  uint32_t used[MAX_NUMBER_OF_ENTRIES];   /* entries that get new GUIDs */
+  Crc32ZeroOp ops[MAX_NUMBER_OF_ENTRIES]; /* CRC operator for each */
+  int boot;                   /* index into used of the PMBR boot GUID */
+};
+
+struct stamp_job {
+  const struct stamp_template *tmpl;
+  CgptStampParams *params;
+  dev_t *devs;                /* filesystem of each output, 0 if flushed */
+  uint32_t next;              /* next output to stamp, shared */
+  uint32_t failed;
+};
+
+static int LoadTemplate(const char *path, struct stamp_template *tmpl) {
+  struct drive drive;
+  GptHeader *header;
+  Guid *boot_guid;
+  uint32_t i;
+  int gpt_retval;
+
+  if (CGPT_OK != DriveOpen(path, &drive, 0, O_RDONLY))
+    return CGPT_FAILED;
+
+  if (drive.gpt.sector_bytes != STAMP_SECTOR_BYTES) {
+    Error("%s has %u-byte sectors, only %d-byte sectors are supported\n",
+          path, drive.gpt.sector_bytes, STAMP_SECTOR_BYTES);
+    goto bad;
+  }
+
+  if (CGPT_OK != ReadPMBR(&drive)) {
+    Error("Unable to read PMBR\n");
+    goto bad;
+  }
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+
+  if (((drive.gpt.valid_headers & MASK_BOTH) != MASK_BOTH) ||
+      ((drive.gpt.valid_entries & MASK_BOTH) != MASK_BOTH)) {
+    Error("one of the GPT header/entries is invalid.\n"
+          "please run 'cgpt repair' on the template first.\n");
+    goto bad;
+  }
+
+  // The secondary copy is rebuilt from the primary entries, so they had
+  // better agree.
+  header = (GptHeader *)drive.gpt.primary_header;
+  if (header->entries_crc32 !=
+      ((GptHeader *)drive.gpt.secondary_header)->entries_crc32) {
+    Error("the template's primary and secondary entries differ.\n"
+          "please run 'cgpt repair' on the template first.\n");
+    goto bad;
+  }
+
+  tmpl->size = drive.size;
+  tmpl->sector_bytes = drive.gpt.sector_bytes;
+  memcpy(tmpl->primary, &drive.pmbr, sizeof(drive.pmbr));
+  memcpy(tmpl->primary + GPT_PMBR_SECTOR * STAMP_SECTOR_BYTES,
+         drive.gpt.primary_header, STAMP_SECTOR_BYTES);
+  memcpy(tmpl->primary + STAMP_ENTRIES_OFFSET, drive.gpt.primary_entries,
+         TOTAL_ENTRIES_SIZE);
+  memcpy(tmpl->secondary_header, drive.gpt.secondary_header,
+         STAMP_SECTOR_BYTES);
+
+  boot_guid = &drive.pmbr.syslinux3.boot_guid;
+  tmpl->num_used = 0;
+  tmpl->boot = -1;
+  for (i = 0; i < header->number_of_entries; i++) {
+    GptEntry *entry = GetEntry(&drive.gpt, PRIMARY, i);
+    uint64_t after;
+
+    if (GuidIsZero(&entry->type))
+      continue;
+    if (!GuidIsZero(boot_guid) && GuidEqual(boot_guid, &entry->unique))
+      tmpl->boot = tmpl->num_used;
+    after = TOTAL_ENTRIES_SIZE - i * sizeof(GptEntry) -
+            offsetof(GptEntry, unique) - sizeof(Guid);
+    Crc32ZeroOpInit(&tmpl->ops[tmpl->num_used], after);
+    tmpl->used[tmpl->num_used++] = i;
+  }
+
+  DriveClose(&drive, 0);
+  return CGPT_OK;
+
+bad:
+  DriveClose(&drive, 0);
+  return CGPT_FAILED;
+}
+
+/* Patch the GUIDs of a copy of the template, fixing up the CRCs without
+ * rereading the entries. */
+static void PatchCopy(const struct stamp_template *tmpl, const Guid *guids,
+                      uint8_t *primary, uint8_t *secondary_header) {
+  GptHeader *header1 = (GptHeader *)(primary +
+                                     GPT_PMBR_SECTOR * STAMP_SECTOR_BYTES);
+  GptHeader *header2 = (GptHeader *)secondary_header;
+  GptEntry *entries = (GptEntry *)(primary + STAMP_ENTRIES_OFFSET);
+  uint32_t crc = header1->entries_crc32;
+  uint32_t i, j;
+
+  for (i = 0; i < tmpl->num_used; i++) {
+    Guid *unique = &entries[tmpl->used[i]].unique;
+    uint8_t delta[sizeof(Guid)];
+
+    for (j = 0; j < sizeof(Guid); j++)
+      delta[j] = ((uint8_t *)unique)[j] ^ ((uint8_t *)&guids[i + 1])[j];
+    crc = Crc32Patch(crc, delta, sizeof(delta), &tmpl->ops[i]);
+    memcpy(unique, &guids[i + 1], sizeof(Guid));
+  }
+
+  if (tmpl->boot >= 0)
+    memcpy(&((struct pmbr *)primary)->syslinux3.boot_guid,
+           &guids[tmpl->boot + 1], sizeof(Guid));
+
+  memcpy(&header1->disk_uuid, &guids[0], sizeof(Guid));
+  memcpy(&header2->disk_uuid, &guids[0], sizeof(Guid));
+  header1->entries_crc32 = crc;
+  header2->entries_crc32 = crc;
+  header1->header_crc32 = 0;
+  header1->header_crc32 = Crc32(header1, header1->size);
+  header2->header_crc32 = 0;
+  header2->header_crc32 = Crc32(header2, header2->size);
+}
+
+/* Write one copy. Block devices are flushed right away, files are left for
+ * a single syncfs() per filesystem once everything is written. */
+static int WriteCopy(const struct stamp_template *tmpl, const char *path,
+                     uint8_t *primary, uint8_t *secondary_header,
+                     dev_t *dev) {
+  struct iovec iov[2];
+  struct stat st;
+  uint64_t size;
+  uint32_t sector_bytes;
+  int fd;
+
+  fd = open(path, O_WRONLY | O_CREAT | O_LARGEFILE, 0666);
+  if (fd < 0) {
+    Error("Can't open %s: %s\n", path, strerror(errno));
+    return CGPT_FAILED;
+  }
+  if (fstat(fd, &st) < 0) {
+    Error("Can't fstat %s: %s\n", path, strerror(errno));
+    goto bad;
+  }
+
+  if (S_ISREG(st.st_mode)) {
+    // Start from an empty, sparse image of the template's size.
+    if (ftruncate(fd, 0) < 0 || ftruncate(fd, tmpl->size) < 0) {
+      Error("Can't resize %s: %s\n", path, strerror(errno));
+      goto bad;
+    }
+    *dev = st.st_dev;
+  } else {
+    if (ioctl(fd, BLKGETSIZE64, &size) < 0) {
+      Error("Can't read drive size from %s: %s\n", path, strerror(errno));
+      goto bad;
+    }
+    if (size != tmpl->size) {
+      Error("%s is not the same size as the template\n", path);
+      goto bad;
+    }
+    if (ioctl(fd, BLKSSZGET, &sector_bytes) < 0) {
+      Error("Can't read sector size from %s: %s\n", path, strerror(errno));
+      goto bad;
+    }
+    if (sector_bytes != tmpl->sector_bytes) {
+      Error("%s has %u-byte sectors, the template %u-byte sectors\n",
+            path, sector_bytes, tmpl->sector_bytes);
+      goto bad;
+    }
+    *dev = 0;
+  }
+
+  iov[0].iov_base = primary + STAMP_ENTRIES_OFFSET;
+  iov[0].iov_len = TOTAL_ENTRIES_SIZE;
+  iov[1].iov_base = secondary_header;
+  iov[1].iov_len = STAMP_SECTOR_BYTES;
+  if (pwrite(fd, primary, STAMP_PRIMARY_BYTES, 0) != STAMP_PRIMARY_BYTES ||
+      pwritev(fd, iov, 2, tmpl->size - TOTAL_ENTRIES_SIZE -
+              STAMP_SECTOR_BYTES) != TOTAL_ENTRIES_SIZE + STAMP_SECTOR_BYTES) {
+    Error("Cannot write %s: %s\n", path, strerror(errno));
+    goto bad;
+  }
+
+  if (!*dev && fsync(fd) < 0) {
+    Error("Cannot flush %s: %s\n", path, strerror(errno));
+    goto bad;
+  }
+  if (close(fd) < 0) {
+    Error("Cannot close %s: %s\n", path, strerror(errno));
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+
+bad:
+  close(fd);
+  return CGPT_FAILED;
+}
+
+static void *StampWorker(void *arg) {
+  struct stamp_job *job = arg;
+  const struct stamp_template *tmpl = job->tmpl;
+  uint8_t *primary = malloc(STAMP_PRIMARY_BYTES);
+  uint8_t secondary_header[STAMP_SECTOR_BYTES];
+  Guid guids[MAX_NUMBER_OF_ENTRIES + 1];
+  uint32_t i;
+
+  require(primary);
+  while ((i = __sync_fetch_and_add(&job->next, 1)) <
+         job->params->num_outputs) {
+    const char *path = job->params->outputs[i];
+
+    memcpy(primary, tmpl->primary, STAMP_PRIMARY_BYTES);
+    memcpy(secondary_header, tmpl->secondary_header, STAMP_SECTOR_BYTES);
+    if (CGPT_OK != RandomGuids(guids, tmpl->num_used + 1)) {
+      __sync_fetch_and_add(&job->failed, 1);
+      continue;
+    }
+    PatchCopy(tmpl, guids, primary, secondary_header);
+    if (CGPT_OK != WriteCopy(tmpl, path, primary, secondary_header,
+                             &job->devs[i])) {
+      __sync_fetch_and_add(&job->failed, 1);
+      continue;
+    }
+    if (job->params->verbose)
+      printf("%s\n", path);
+  }
+
+  free(primary);
+  return NULL;
+}
+
+/* Flush each filesystem that received image files once. */
+static int SyncOutputs(CgptStampParams *params, dev_t *devs) {
+  uint32_t i, j;
+  int fd, r = CGPT_OK;
+
+  for (i = 0; i < params->num_outputs; i++) {
+    if (!devs[i])
+      continue;
+    for (j = 0; j < i && devs[j] != devs[i]; j++)
+      ;
+    if (j < i)
+      continue;
+    if ((fd = open(params->outputs[i], O_RDONLY)) < 0 || syncfs(fd) < 0) {
+      Error("Cannot flush %s: %s\n", params->outputs[i], strerror(errno));
+      r = CGPT_FAILED;
+    }
+    if (fd >= 0)
+      close(fd);
+  }
+  return r;
+}
+
+int CgptStamp(CgptStampParams *params) {
+  struct stamp_template *tmpl;
+  struct stamp_job job;
+  int retval = CGPT_FAILED;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  tmpl = malloc(sizeof(*tmpl));
+  require(tmpl);
+  if (CGPT_OK != LoadTemplate(params->template_name, tmpl)) {
+    free(tmpl);
+    return CGPT_FAILED;
+  }
+
+  memset(&job, 0, sizeof(job));
+  job.tmpl = tmpl;
+  job.params = params;
+  job.devs = calloc(params->num_outputs + 1, sizeof(dev_t));
+  require(job.devs);
+  RunWorkers(params->jobs, params->num_outputs, StampWorker, &job);
+
+  if (CGPT_OK == SyncOutputs(params, job.devs) && !job.failed)
+    retval = CGPT_OK;
+
+  free(job.devs);
+  free(tmpl);
+  return retval;
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "vboot_host.h"
+
+/* The parts of the golden table that every target gets. */
+struct sync_golden {
+  uint32_t sector_bytes;
+  uint8_t *header;            /* primary header sector */
+  uint8_t *entries;           /* primary entries */
+};
+
+struct sync_job {
+  const struct sync_golden *golden;
+  CgptSyncParams *params;
+  uint32_t next;              /* next drive to sync, shared */
+  uint32_t failed;
+};
+
+static int LoadGolden(const char *path, struct sync_golden *golden) {
+  struct drive drive;
+  uint64_t entries_bytes;
+  int gpt_retval;
+
+  if (CGPT_OK != DriveOpen(path, &drive, 0, O_RDONLY))
+    return CGPT_FAILED;
+
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("GptSanityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+
+  if (((drive.gpt.valid_headers & MASK_BOTH) != MASK_BOTH) ||
+      ((drive.gpt.valid_entries & MASK_BOTH) != MASK_BOTH)) {
+    Error("one of the GPT header/entries is invalid.\n"
+          "please run 'cgpt repair' on the golden table first.\n");
+    goto bad;
+  }
+
+  golden->sector_bytes = drive.gpt.sector_bytes;
+  entries_bytes = GPT_ENTRIES_SECTORS * golden->sector_bytes;
+  golden->header = malloc(golden->sector_bytes);
+  golden->entries = malloc(entries_bytes);
+  require(golden->header && golden->entries);
+  memcpy(golden->header, drive.gpt.primary_header, golden->sector_bytes);
+  memcpy(golden->entries, drive.gpt.primary_entries, entries_bytes);
+
+  DriveClose(&drive, 0);
+  return CGPT_OK;
+
+bad:
+  DriveClose(&drive, 0);
+  return CGPT_FAILED;
+}
+
+static int SyncDrive(const struct sync_golden *golden, const char *path,
+                     CgptSyncParams *params) {
+  struct drive drive;
+  struct drive_snapshot old;
+  GptHeader *header;
+  Guid disk_uuid;
+  uint64_t sector_bytes, entries_bytes, sectors;
+  uint8_t *old_entries;
+  uint32_t i, count = 0;
+  int gpt_retval, rv, result = CGPT_FAILED;
+
+  memset(&old, 0, sizeof(old));
+  if (CGPT_OK != DriveOpen(path, &drive, 0,
+                           params->dry_run ? O_RDONLY : O_RDWR))
+    return CGPT_FAILED;
+
+  sector_bytes = drive.gpt.sector_bytes;
+  sectors = drive.gpt.drive_sectors;
+  entries_bytes = GPT_ENTRIES_SECTORS * sector_bytes;
+  if (sector_bytes != golden->sector_bytes) {
+    Error("%s has %llu-byte sectors, the golden table %u-byte sectors\n",
+          path, (unsigned long long)sector_bytes, golden->sector_bytes);
+    goto bad;
+  }
+
+  if (CGPT_OK != ReadPMBR(&drive)) {
+    Error("Unable to read PMBR of %s\n", path);
+    goto bad;
+  }
+
+  // The target keeps its own disk and partition GUIDs, so it needs a valid
+  // header and entries to take them from.
+  if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive.gpt))) {
+    Error("%s: GptSanityCheck() returned %d: %s\n",
+          path, gpt_retval, GptError(gpt_retval));
+    goto bad;
+  }
+  header = (GptHeader *)((drive.gpt.valid_headers & MASK_PRIMARY) ?
+                         drive.gpt.primary_header :
+                         drive.gpt.secondary_header);
+  memcpy(&disk_uuid, &header->disk_uuid, sizeof(Guid));
+  if (!drive.gpt.valid_entries) {
+    Error("%s: both partition tables are invalid\n", path);
+    goto bad;
+  }
+
+  DriveSnapshot(&drive, &old);
+  old_entries = (drive.gpt.valid_entries & MASK_PRIMARY) ?
+                old.primary_entries : old.secondary_entries;
+
+  // Rebase the golden table onto this drive and derive the rest from it.
+  // Partitions that are still of the same type keep their unique GUIDs.
+  memcpy(drive.gpt.primary_header, golden->header, sector_bytes);
+  memcpy(drive.gpt.primary_entries, golden->entries, entries_bytes);
+  for (i = 0; i < GetNumberOfEntries(&drive); i++) {
+    GptEntry *entry = GetEntry(&drive.gpt, PRIMARY, i);
+    GptEntry *current = (GptEntry *)(old_entries + i * sizeof(GptEntry));
+
+    if (!GuidIsZero(&entry->type) && GuidEqual(&entry->type, &current->type))
+      memcpy(&entry->unique, &current->unique, sizeof(Guid));
+  }
+  header = (GptHeader *)drive.gpt.primary_header;
+  header->my_lba = GPT_PMBR_SECTOR;
+  header->alternate_lba = sectors - 1;
+  header->entries_lba = GPT_PMBR_SECTOR + GPT_HEADER_SECTOR;
+  header->first_usable_lba = GPT_PMBR_SECTOR + GPT_HEADER_SECTOR +
+                             GPT_ENTRIES_SECTORS;
+  header->last_usable_lba = sectors - GPT_HEADER_SECTOR -
+                            GPT_ENTRIES_SECTORS - 1;
+  memcpy(&header->disk_uuid, &disk_uuid, sizeof(Guid));
+  UpdateAllEntries(&drive);
+
+  rv = CheckEntries((GptEntry*)drive.gpt.primary_entries,
+                    (GptHeader*)drive.gpt.primary_header);
+  if (0 != rv) {
+    Error("%s: %s\n", path, GptErrorText(rv));
+    goto bad;
+  }
+  UpdatePMBR(&drive, PRIMARY);
+
+  if (!params->dry_run && CGPT_OK != (rv = DriveLockUnchanged(&drive))) {
+    result = rv;
+    goto bad;
+  }
+  if (CGPT_OK != DriveWriteChanged(&drive, &old, params->dry_run, &count,
+                                   NULL, NULL))
+    goto write_error;
+
+  if (params->verbose || params->dry_run) {
+    if (count)
+      printf("%s: %u sector%s %s\n", path, count, count == 1 ? "" : "s",
+             params->dry_run ? "differ" : "written");
+    else
+      printf("%s: already in sync\n", path);
+  }
+  result = CGPT_OK;
+  goto bad;
+
+write_error:
+  Error("Cannot write %s: %s\n", path, strerror(errno));
+
+bad:
+  DriveSnapshotFree(&old);
+  // Nothing is left for DriveClose() to write, it only flushes.
+  DriveClose(&drive, 0);
+  return result;
+}
+
+static void *SyncWorker(void *arg) {
+  struct sync_job *job = arg;
+  uint32_t i;
+
+  while ((i = __sync_fetch_and_add(&job->next, 1)) <
+         job->params->num_drives) {
+    if (CGPT_OK != SyncDrive(job->golden, job->params->drives[i],
+                             job->params))
+      __sync_fetch_and_add(&job->failed, 1);
+  }
+  return NULL;
+}
+
+int CgptSync(CgptSyncParams *params) {
+  struct sync_golden golden;
+  struct sync_job job;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  memset(&golden, 0, sizeof(golden));
+  if (CGPT_OK != LoadGolden(params->golden_name, &golden))
+    return CGPT_FAILED;
+
+  memset(&job, 0, sizeof(job));
+  job.golden = &golden;
+  job.params = params;
+  RunWorkers(params->jobs, params->num_drives, SyncWorker, &job);
+
+  free(golden.header);
+  free(golden.entries);
+  return job.failed ? CGPT_FAILED : CGPT_OK;
+}
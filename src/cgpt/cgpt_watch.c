@@ -0,0 +1,436 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "cgptlib_internal.h"
+#include "output_utils.h"
+#include "vboot_host.h"
+
+#define PROC_PARTITIONS "/proc/partitions"
+#define SYS_DEV_BLOCK_DIR "/sys/dev/block"
+
+#define UEVENT_BUFFER_BYTES 8192
+#define UEVENT_SOCKET_BYTES (1024 * 1024)
+#define INOTIFY_BUFFER_BYTES 4096
+
+/* Image files are checked once a writer closes them, and whenever they
+ * are renamed or deleted. A new file is only looked at once it is closed,
+ * not while it is still empty. */
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+struct watched {
+  char *name;                   // as given, or the /dev node of a disk
+  const char *base;             // last component of name, for inotify
+  char kname[NAME_MAX + 1];     // sysfs name of a block device, if known
+  dev_t rdev;                   // device number of a block device, or 0
+  int wd;                       // inotify watch of the parent, or -1
+  int node_wd;                  // inotify watch of a block device, or -1
+  int present;
+  int dirty;                    // needs to be read again
+  int removed;                  // the kernel says it's gone
+  char fingerprint[FINGERPRINT_STRLEN];   // empty without a table
+};
+
+struct watch {
+  struct watched *drives;
+  uint32_t num_drives;
+  int all;                      // watching every whole disk
+  int uevent_fd;
+  int inotify_fd;
+  uint32_t events;              // printed so far
+  uint32_t max_events;          // 0 for no limit
+  struct output out;
+};
+
+static struct watched *AddDrive(struct watch *w, const char *name) {
+  struct watched *d;
+  const char *slash;
+
+  w->drives = realloc(w->drives, (w->num_drives + 1) * sizeof(*w->drives));
+  require(w->drives);
+  d = &w->drives[w->num_drives++];
+  memset(d, 0, sizeof(*d));
+  d->name = strdup(name);
+  require(d->name);
+  slash = strrchr(d->name, '/');
+  d->base = slash ? slash + 1 : d->name;
+  d->wd = -1;
+  d->node_wd = -1;
+  return d;
+}
+
+static struct watched *FindDrive(struct watch *w, const char *name) {
+  uint32_t i;
+
+  for (i = 0; i < w->num_drives; i++)
+    if (!strcmp(w->drives[i].name, name))
+      return &w->drives[i];
+  return NULL;
+}
+
+/* Watch the directory holding an image file, so that the file is noticed
+ * when it is written, replaced or deleted. */
+static void WatchParent(struct watch *w, struct watched *d) {
+  char dir[PATH_MAX];
+  size_t len = d->base - d->name;
+
+  if (len >= sizeof(dir))
+    return;
+  if (len) {
+    memcpy(dir, d->name, len);
+    dir[len] = '\0';
+  } else {
+    strcpy(dir, ".");
+  }
+  d->wd = inotify_add_watch(w->inotify_fd, dir, INOTIFY_MASK);
+  if (d->wd < 0)
+    Error("can't watch %s: %s\n", dir, strerror(errno));
+}
+
+/* Find the sysfs name of a block device, which is what uevents use. */
+static void KernelName(struct watched *d) {
+  char path[64], target[PATH_MAX];
+  const char *name;
+  ssize_t len;
+
+  snprintf(path, sizeof(path), SYS_DEV_BLOCK_DIR "/%u:%u",
+           major(d->rdev), minor(d->rdev));
+  len = readlink(path, target, sizeof(target) - 1);
+  if (len < 0)
+    return;
+  target[len] = '\0';
+  name = strrchr(target, '/');
+  name = name ? name + 1 : target;
+  // Kernel names are short, anything that doesn't fit isn't one.
+  if (strlen(name) >= sizeof(d->kname))
+    return;
+  memcpy(d->kname, name, strlen(name) + 1);
+}
+
+static void Emit(struct watch *w, struct watched *d, const char *event) {
+  if (w->max_events && w->events >= w->max_events)
+    return;
+  w->events++;
+
+  out_str(&w->out, "{\"event\":\"");
+  out_str(&w->out, event);
+  out_str(&w->out, "\",\"drive\":");
+  out_json_str(&w->out, d->name);
+  if (!strcmp(event, "remove")) {
+    out_str(&w->out, "}\n");
+  } else if (d->fingerprint[0]) {
+    out_str(&w->out, ",\"fingerprint\":\"");
+    out_str(&w->out, d->fingerprint);
+    out_str(&w->out, "\"}\n");
+  } else {
+    out_str(&w->out, ",\"fingerprint\":null}\n");
+  }
+}
+
+static void ReadFingerprint(const char *name, char *fingerprint) {
+  struct drive drive;
+
+  fingerprint[0] = '\0';
+  if (CGPT_OK != DriveOpen(name, &drive, 0, O_RDONLY))
+    return;
+  if (GPT_SUCCESS == GptSanityCheck(&drive.gpt) &&
+      CGPT_OK == ReadPMBR(&drive))
+    DriveFingerprint(&drive, fingerprint);
+  DriveClose(&drive, 0);
+}
+
+/* Read a drive again and report how it differs from last time. */
+static void Check(struct watch *w, struct watched *d) {
+  char fingerprint[FINGERPRINT_STRLEN] = "";
+  struct stat st;
+  int present = 0;
+
+  if (!d->removed && stat(d->name, &st) == 0 &&
+      (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) {
+    present = 1;
+    if (S_ISBLK(st.st_mode) && d->rdev != st.st_rdev) {
+      d->rdev = st.st_rdev;
+      KernelName(d);
+    }
+    // Not every write to a disk is followed by a uevent, e.g. when its
+    // table can't be read again, so closing it after writing counts too.
+    if (S_ISBLK(st.st_mode) && d->node_wd < 0)
+      d->node_wd = inotify_add_watch(w->inotify_fd, d->name, IN_CLOSE_WRITE);
+    ReadFingerprint(d->name, fingerprint);
+  }
+  d->dirty = 0;
+  d->removed = 0;
+
+  if (present == d->present && !strcmp(fingerprint, d->fingerprint))
+    return;
+  strcpy(d->fingerprint, fingerprint);
+  if (present != d->present) {
+    d->present = present;
+    Emit(w, d, present ? "add" : "remove");
+  } else {
+    Emit(w, d, "change");
+  }
+}
+
+/* Add any whole disk not yet watched. Only done at startup, and again if
+ * uevents were lost. */
+static void ScanDisks(struct watch *w) {
+  char line[256], partname[128];
+  FILE *fp;
+
+  fp = fopen(PROC_PARTITIONS, "r");
+  if (!fp) {
+    Error("can't read %s: %s\n", PROC_PARTITIONS, strerror(errno));
+    return;
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned int ma, mi;
+    unsigned long long sz;
+    char *pathname;
+
+    if (sscanf(line, " %u %u %llu %127[^\n ]", &ma, &mi, &sz, partname) != 4)
+      continue;
+    if ((pathname = IsWholeDev(partname)) && !FindDrive(w, pathname))
+      AddDrive(w, pathname)->dirty = 1;
+  }
+  fclose(fp);
+}
+
+static void MarkAll(struct watch *w) {
+  uint32_t i;
+
+  for (i = 0; i < w->num_drives; i++)
+    w->drives[i].dirty = 1;
+}
+
+/* Handle one uevent: "ACTION@DEVPATH" followed by KEY=VALUE strings. */
+static void HandleUevent(struct watch *w, char *msg, size_t len) {
+  const char *action = NULL, *devpath = NULL, *subsystem = NULL;
+  const char *devtype = NULL, *devname = NULL;
+  char parent[NAME_MAX + 1] = "", kname[NAME_MAX + 1] = "";
+  unsigned int ma = 0, mi = 0;
+  struct watched *d;
+  char *p, *end = msg + len;
+  dev_t rdev;
+  uint32_t i;
+  int found = 0;
+
+  for (p = msg + strlen(msg) + 1; p < end; p += strlen(p) + 1) {
+    if (!strncmp(p, "ACTION=", 7))
+      action = p + 7;
+    else if (!strncmp(p, "DEVPATH=", 8))
+      devpath = p + 8;
+    else if (!strncmp(p, "SUBSYSTEM=", 10))
+      subsystem = p + 10;
+    else if (!strncmp(p, "DEVTYPE=", 8))
+      devtype = p + 8;
+    else if (!strncmp(p, "DEVNAME=", 8))
+      devname = p + 8;
+    else if (!strncmp(p, "MAJOR=", 6))
+      ma = strtoul(p + 6, NULL, 10);
+    else if (!strncmp(p, "MINOR=", 6))
+      mi = strtoul(p + 6, NULL, 10);
+  }
+  if (!action || !devpath || !devtype || !subsystem ||
+      strcmp(subsystem, "block"))
+    return;
+
+  if (!strcmp(devtype, "partition")) {
+    // Partitions come and go when their disk's table is read again.
+    const char *last = strrchr(devpath, '/'), *prev = last;
+
+    while (prev && prev > devpath && prev[-1] != '/')
+      prev--;
+    if (!last || !prev || last - prev >= sizeof(parent))
+      return;
+    memcpy(parent, prev, last - prev);
+    parent[last - prev] = '\0';
+    for (i = 0; i < w->num_drives; i++)
+      if (w->drives[i].present && !strcmp(w->drives[i].kname, parent))
+        w->drives[i].dirty = 1;
+    return;
+  }
+  if (strcmp(devtype, "disk"))
+    return;
+
+  rdev = makedev(ma, mi);
+  for (i = 0; i < w->num_drives; i++) {
+    d = &w->drives[i];
+    if (d->present && d->rdev == rdev) {
+      d->dirty = 1;
+      d->removed = !strcmp(action, "remove");
+      found = 1;
+    } else if (!d->present && d->wd < 0 && !strcmp(action, "add")) {
+      d->dirty = 1;                     // perhaps this is it
+    }
+  }
+
+  if (!found && w->all && devname && strcmp(action, "remove")) {
+    const char *pathname = IsWholeDev(devname);
+
+    if (pathname && !FindDrive(w, pathname)) {
+      d = AddDrive(w, pathname);
+      d->dirty = 1;
+      for (i = 0; devname[i] && i < sizeof(kname) - 1; i++)
+        kname[i] = devname[i] == '/' ? '!' : devname[i];
+      kname[i] = '\0';
+      strcpy(d->kname, kname);
+    }
+  }
+}
+
+static void ReadUevents(struct watch *w) {
+  char buf[UEVENT_BUFFER_BYTES];
+  ssize_t len;
+
+  while ((len = recv(w->uevent_fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) != 0) {
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        // Events were dropped; fall back to looking at everything.
+        MarkAll(w);
+        if (w->all)
+          ScanDisks(w);
+        continue;
+      }
+      if (errno != EAGAIN && errno != EINTR)
+        Error("can't read uevents: %s\n", strerror(errno));
+      return;
+    }
+    buf[len] = '\0';
+    if (strchr(buf, '@'))
+      HandleUevent(w, buf, len);
+  }
+}
+
+static void ReadInotify(struct watch *w) {
+  char buf[INOTIFY_BUFFER_BYTES]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+
+  while ((len = read(w->inotify_fd, buf, sizeof(buf))) > 0) {
+    char *p;
+
+    for (p = buf; p < buf + len;
+         p += sizeof(struct inotify_event) +
+              ((struct inotify_event *)p)->len) {
+      const struct inotify_event *ev = (const struct inotify_event *)p;
+      uint32_t i;
+
+      for (i = 0; i < w->num_drives; i++) {
+        struct watched *d = &w->drives[i];
+
+        if (d->node_wd == ev->wd && (ev->mask & IN_IGNORED))
+          d->node_wd = -1;
+        else if ((ev->mask & IN_Q_OVERFLOW) || d->node_wd == ev->wd ||
+                 (d->wd == ev->wd && ev->len && !strcmp(d->base, ev->name)))
+          d->dirty = 1;
+      }
+    }
+  }
+}
+
+int CgptWatch(CgptWatchParams *params) {
+  struct watch w;
+  uint32_t i;
+  int block = 0, rcvbuf = UEVENT_SOCKET_BYTES;
+  int retval = CGPT_FAILED;
+
+  if (params == NULL)
+    return CGPT_FAILED;
+
+  memset(&w, 0, sizeof(w));
+  w.all = !params->num_drives;
+  w.max_events = params->count;
+  w.uevent_fd = -1;
+  out_init(&w.out, stdout);
+
+  w.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (w.inotify_fd < 0) {
+    Error("can't start inotify: %s\n", strerror(errno));
+    goto done;
+  }
+
+  // Set everything up before the first read so no change slips through.
+  for (i = 0; i < params->num_drives; i++) {
+    struct watched *d = AddDrive(&w, params->drives[i]);
+    struct stat st;
+
+    d->dirty = 1;
+    if (stat(d->name, &st) == 0 && S_ISBLK(st.st_mode))
+      block = 1;
+    else
+      WatchParent(&w, d);
+  }
+
+  if (w.all || block) {
+    struct sockaddr_nl addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;                 // kernel uevents
+    w.uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                         NETLINK_KOBJECT_UEVENT);
+    if (w.uevent_fd < 0 ||
+        bind(w.uevent_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      Error("can't listen for uevents: %s\n", strerror(errno));
+      goto done;
+    }
+    setsockopt(w.uevent_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+
+  if (w.all)
+    ScanDisks(&w);
+
+  for (;;) {
+    struct pollfd fds[2] = {
+      { .fd = w.inotify_fd, .events = POLLIN },
+      { .fd = w.uevent_fd, .events = POLLIN },
+    };
+
+    for (i = 0; i < w.num_drives; i++)
+      if (w.drives[i].dirty)
+        Check(&w, &w.drives[i]);
+    out_flush(&w.out);
+    fflush(stdout);                     // a reader is waiting on each line
+    if (w.max_events && w.events >= w.max_events)
+      break;
+
+    if (poll(fds, w.uevent_fd < 0 ? 1 : 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      Error("poll failed: %s\n", strerror(errno));
+      goto done;
+    }
+    if (fds[0].revents)
+      ReadInotify(&w);
+    if (w.uevent_fd >= 0 && fds[1].revents)
+      ReadUevents(&w);
+  }
+  retval = CGPT_OK;
+
+done:
+  out_flush(&w.out);
+  if (w.uevent_fd >= 0)
+    close(w.uevent_fd);
+  if (w.inotify_fd >= 0)
+    close(w.inotify_fd);
+  for (i = 0; i < w.num_drives; i++)
+    free(w.drives[i].name);
+  free(w.drives);
+  return retval;
+}
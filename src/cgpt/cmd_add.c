@@ -25,6 +25,12 @@ static void Usage(void)
          "  -T NUM       set Tries flag (0-15)\n"
          "  -P NUM       set Priority flag (0-15)\n"
          "  -A NUM       set raw 64-bit attribute value\n"
+         "  -D, --discard\n"
+         "               Discard space freed by removing or shrinking\n"
+         "               the partition\n"
+         "  -W, --wipe   Clear filesystem and partition table signatures\n"
+         "               from a new partition, or from the sectors an\n"
+         "               existing one is moved or grown to\n"
          "\n"
          "Use the -i option to modify an existing partition.\n"
          "The -b, -s, and -t options must be given for new partitions.\n"
@@ -41,9 +47,15 @@ int cmd_add(int argc, char *argv[]) {
   int errorcnt = 0;
   int r = CGPT_FAILED;
   char *e = 0;
+  static const struct option long_options[] = {
+    {"discard", no_argument, NULL, 'D'},
+    {"wipe", no_argument, NULL, 'W'},
+    {NULL, 0, NULL, 0}
+  };
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hi:b:s:t:u:l:B:S:T:P:A:")) != -1)
+  while ((c=getopt_long(argc, argv, ":hi:b:s:t:u:l:B:S:T:P:A:DW",
+                        long_options, NULL)) != -1)
   {
     switch (c)
     {
@@ -153,6 +165,12 @@ int cmd_add(int argc, char *argv[]) {
         errorcnt++;
       }
       break;
+    case 'D':
+      params.discard = 1;
+      break;
+    case 'W':
+      params.wipe = 1;
+      break;
 
     case 'h':
       Usage();
@@ -0,0 +1,84 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s apply [OPTIONS] DRIVE\n\n"
+         "Make the partition table of DRIVE match a manifest written by\n"
+         "\"%s dump\". Nothing is written if the table already matches.\n\n"
+         "Options:\n"
+         "  -f FILE      Read the manifest from FILE (default is stdin)\n"
+         "  -n           Only report whether the table would change\n"
+         "  -v           Print each partition that changes\n"
+         "\n"
+         "Partitions missing from the manifest are removed. A partition\n"
+         "line without guid=, attrs= or label= keeps its current value, or\n"
+         "gets a random GUID, no attributes and no label if it is new.\n"
+         "\n", progname, progname);
+}
+
+int cmd_apply(int argc, char *argv[]) {
+  CgptApplyParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  int r;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hf:nv")) != -1)
+  {
+    switch (c)
+    {
+    case 'f':
+      params.manifest = optarg;
+      break;
+    case 'n':
+      params.dry_run = 1;
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Error("missing drive argument\n");
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  params.drive_name = strdup(argv[optind]);
+
+  r = CgptApply(&params);
+
+  free(params.drive_name);
+  return r;
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s assemble [OPTIONS] -s NUM -p PART [-p PART...]\n\n"
+         "Write a complete disk image built from partition payloads.\n\n"
+         "Options:\n"
+         "  -s NUM       Disk size in sectors\n"
+         "  -o FILE      Write the image to FILE instead of stdout\n"
+         "  -p PART      Add a partition, described as\n"
+         "               NUM:BEGIN:SIZE:TYPE[:PAYLOAD[:LABEL]]\n"
+         "  -v           Verbose\n"
+         "\n"
+         "BEGIN and SIZE are in sectors. SIZE may be left empty to fit the\n"
+         "PAYLOAD file, which is copied into the partition. The image is\n"
+         "written in a single pass so it can be piped to another program.\n"
+         "Regular output files are left sparse.\n"
+         "\n", progname);
+  PrintTypes();
+}
+
+/* Split off the next colon separated field of *spec. */
+static char *NextField(char **spec) {
+  char *field = *spec, *colon;
+
+  if (!field)
+    return NULL;
+  if ((colon = strchr(field, ':')) != NULL) {
+    *colon = '\0';
+    *spec = colon + 1;
+  } else {
+    *spec = NULL;
+  }
+  return field;
+}
+
+static int ParsePart(char *spec, CgptAssemblePart *part) {
+  char *num, *begin, *size, *type, *e = 0;
+
+  memset(part, 0, sizeof(*part));
+  num = NextField(&spec);
+  begin = NextField(&spec);
+  size = NextField(&spec);
+  type = NextField(&spec);
+  part->payload = NextField(&spec);
+  part->label = spec;   // the rest, colons and all
+  if (!type)
+    return CGPT_FAILED;
+  if (part->payload && !*part->payload)
+    part->payload = NULL;
+
+  part->partition = (uint32_t)strtoul(num, &e, 0);
+  if (!*num || (e && *e))
+    return CGPT_FAILED;
+  part->begin = strtoull(begin, &e, 0);
+  if (!*begin || (e && *e))
+    return CGPT_FAILED;
+  part->size = strtoull(size, &e, 0);
+  if (e && *e)
+    return CGPT_FAILED;
+  if (CGPT_OK != SupportedType(type, &part->type_guid) &&
+      CGPT_OK != StrToGuid(type, &part->type_guid))
+    return CGPT_FAILED;
+  return CGPT_OK;
+}
+
+int cmd_assemble(int argc, char *argv[]) {
+  CgptAssembleParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  int r = CGPT_FAILED;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hs:o:p:v")) != -1)
+  {
+    switch (c)
+    {
+    case 's':
+      params.size = strtoull(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'o':
+      params.output = optarg;
+      break;
+    case 'p':
+      params.parts = realloc(params.parts,
+                             sizeof(*params.parts) * (params.num_parts + 1));
+      require(params.parts);
+      if (CGPT_OK != ParsePart(optarg, &params.parts[params.num_parts]))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      params.num_parts++;
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      free(params.parts);
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (!params.size) {
+    Error("the disk size (-s) is required\n");
+    errorcnt++;
+  }
+  if (optind < argc) {
+    Error("unexpected argument: %s\n", argv[optind]);
+    errorcnt++;
+  }
+  if (errorcnt)
+  {
+    Usage();
+    goto out;
+  }
+
+  r = CgptAssemble(&params);
+
+out:
+  free(params.parts);
+  return r;
+}
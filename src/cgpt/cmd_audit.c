@@ -0,0 +1,101 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s audit [OPTIONS] PATH...\n\n"
+         "Check the partition tables of many images at once, without\n"
+         "changing them. Each PATH is an image, a drive or a directory,\n"
+         "which is searched for images recursively.\n\n"
+         "Options:\n"
+         "  -a SECTORS   Partitions must start on a multiple of SECTORS\n"
+         "               (default 8, one 4 KiB block)\n"
+         "  -j NUM       Number of images to read at once (default is the\n"
+         "               number of CPUs)\n"
+         "\n"
+         "One line of JSON is printed per image, in no particular order:\n"
+         "  {\"path\":\"a.bin\",\"sectors\":N,\"headers\":\"both\","
+         "\"entries\":\"both\",\n"
+         "   \"problems\":[...],\"ok\":true}\n"
+         "where headers and entries say which copies are valid (\"both\",\n"
+         "\"primary\", \"secondary\" or \"none\"), and problems lists what is\n"
+         "wrong: invalid or diverging copies, overlapping or misaligned\n"
+         "partitions, and a protective MBR that doesn't match the table.\n"
+         "An image that can't be read has an \"error\" instead. A summary\n"
+         "line comes last. Files in directories that are too small to hold\n"
+         "a GPT are skipped. The exit status is non-zero if any image has\n"
+         "problems or errors.\n"
+         "\n", progname);
+}
+
+int cmd_audit(int argc, char *argv[]) {
+  CgptAuditParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":ha:j:")) != -1)
+  {
+    switch (c)
+    {
+    case 'a':
+      params.alignment = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.alignment)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'j':
+      params.jobs = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.jobs)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc)
+  {
+    Error("missing path argument\n");
+    return CGPT_FAILED;
+  }
+
+  params.paths = argv + optind;
+  params.num_paths = argc - optind;
+
+  return CgptAudit(&params);
+}
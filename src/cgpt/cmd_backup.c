@@ -0,0 +1,74 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s backup [OPTIONS] DRIVE\n\n"
+         "Save the PMBR and both GPT headers and tables of DRIVE.\n\n"
+         "Options:\n"
+         "  -f FILE      Write the backup to FILE (default is stdout)\n"
+         "\n"
+         "The backup is checksummed and records the drive geometry, so it can\n"
+         "only be restored to a drive of the same size.\n"
+         "\n", progname);
+}
+
+int cmd_backup(int argc, char *argv[]) {
+  CgptBackupParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  int r;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hf:")) != -1)
+  {
+    switch (c)
+    {
+    case 'f':
+      params.file = optarg;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Error("missing drive argument\n");
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  params.drive_name = strdup(argv[optind]);
+
+  r = CgptBackup(&params);
+
+  free(params.drive_name);
+  return r;
+}
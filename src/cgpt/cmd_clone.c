@@ -0,0 +1,166 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "blkid_utils.h"
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s clone [OPTIONS] DRIVE\n\n"
+         "Copy the contents of one partition into another.\n\n"
+         "Options:\n"
+         "  -i NUM       Source partition, given twice: the second -i is\n"
+         "               the destination\n"
+         "  -S NUM       set Successful flag of the destination (0|1)\n"
+         "  -T NUM       set Tries flag of the destination (0-15)\n"
+         "  -P NUM       set Priority flag of the destination (0-15)\n"
+         "  -A NUM       set raw 64-bit attribute value of the destination\n"
+         "  -v           Verbose\n"
+         "\n"
+         "The destination must be at least as large as the source. It gets\n"
+         "the source's type and attributes, then the -S, -T, -P or -A\n"
+         "values, which are written only after the data has been copied.\n"
+         "DRIVE may also be the destination partition's device.\n"
+         "\n", progname);
+}
+
+int cmd_clone(int argc, char *argv[]) {
+  CgptCloneParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  int nparts = 0;
+  int r = CGPT_FAILED;
+  uint32_t partition;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hi:S:T:P:A:v")) != -1)
+  {
+    switch (c)
+    {
+    case 'i':
+      partition = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      if (nparts == 0) {
+        params.src_partition = partition;
+      } else if (nparts == 1) {
+        params.dst_partition = partition;
+      } else {
+        Error("-%c may only be given twice\n", c);
+        errorcnt++;
+      }
+      nparts++;
+      break;
+    case 'S':
+      params.set_successful = 1;
+      params.successful = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      if (params.successful < 0 || params.successful > 1) {
+        Error("value for -%c must be between 0 and 1", c);
+        errorcnt++;
+      }
+      break;
+    case 'T':
+      params.set_tries = 1;
+      params.tries = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      if (params.tries < 0 || params.tries > 15) {
+        Error("value for -%c must be between 0 and 15", c);
+        errorcnt++;
+      }
+      break;
+    case 'P':
+      params.set_priority = 1;
+      params.priority = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      if (params.priority < 0 || params.priority > 15) {
+        Error("value for -%c must be between 0 and 15", c);
+        errorcnt++;
+      }
+      break;
+    case 'A':
+      params.set_raw = 1;
+      params.raw_value = strtoull(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (nparts == 1) {
+    Error("the destination partition (second -i) is required\n");
+    errorcnt++;
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc)
+  {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
+
+  params.drive_name = strdup(argv[optind]);
+
+  r = translate_partition_dev(&params.drive_name, &params.dst_partition);
+  if (r != CGPT_OK)
+    goto out;
+
+  if (!params.src_partition || !params.dst_partition) {
+    Error("the source and destination partitions (-i) are required\n");
+    r = CGPT_FAILED;
+    goto out;
+  }
+
+  r = CgptClone(&params);
+
+out:
+  free(params.drive_name);
+  return r;
+}
@@ -16,6 +16,8 @@ static void Usage(void)
          "  -c           Create disk image file if needed. Requires -s\n"
          "  -s NUM       Minimum disk sectors, extends image files\n"
          "  -z           Zero the sectors of the GPT table and entries\n"
+         "  -D, --discard\n"
+         "               Discard the space used by the old partitions\n"
          "\n", progname);
 }
 
@@ -26,9 +28,13 @@ int cmd_create(int argc, char *argv[]) {
   int c;
   int errorcnt = 0;
   char *e = 0;
+  static const struct option long_options[] = {
+    {"discard", no_argument, NULL, 'D'},
+    {NULL, 0, NULL, 0}
+  };
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hcs:z")) != -1)
+  while ((c=getopt_long(argc, argv, ":hcs:zD", long_options, NULL)) != -1)
   {
     switch (c)
     {
@@ -38,6 +44,9 @@ int cmd_create(int argc, char *argv[]) {
     case 'c':
       params.create = 1;
       break;
+    case 'D':
+      params.discard = 1;
+      break;
     case 's':
       params.min_size = strtoull(optarg, &e, 0);
       if (!*optarg || (e && *e)) {
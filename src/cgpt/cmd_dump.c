@@ -0,0 +1,74 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s dump [OPTIONS] DRIVE\n\n"
+         "Print the partition table as a manifest, one partition per line.\n\n"
+         "Options:\n"
+         "  -j           Print JSON instead\n"
+         "\n"
+         "The text form can be given to \"%s apply\" to recreate the table\n"
+         "on this or another drive.\n"
+         "\n", progname, progname);
+}
+
+int cmd_dump(int argc, char *argv[]) {
+  CgptDumpParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  int r;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hj")) != -1)
+  {
+    switch (c)
+    {
+    case 'j':
+      params.json = 1;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Error("missing drive argument\n");
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  params.drive_name = strdup(argv[optind]);
+
+  r = CgptDump(&params);
+
+  free(params.drive_name);
+  return r;
+}
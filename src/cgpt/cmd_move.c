@@ -0,0 +1,117 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "blkid_utils.h"
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s move [OPTIONS] DRIVE\n\n"
+         "Move a partition's data to a new starting sector.\n\n"
+         "Options:\n"
+         "  -i NUM       Specify partition\n"
+         "  -b NUM       New beginning sector\n"
+         "  -C FILE      Record progress in FILE, resuming an interrupted\n"
+         "               move if FILE already exists\n"
+         "  -v           Verbose\n"
+         "\n"
+         "The partition table is only updated after all data has been\n"
+         "copied and verified. With -C, a move that overlaps its old\n"
+         "location is flushed each time it has copied as much as the\n"
+         "distance moved, so short moves are slow.\n"
+         "\n", progname);
+}
+
+int cmd_move(int argc, char *argv[]) {
+  CgptMoveParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  int r = CGPT_FAILED;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hi:b:C:v")) != -1)
+  {
+    switch (c)
+    {
+    case 'i':
+      params.partition = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'b':
+      params.set_begin = 1;
+      params.begin = strtoull(optarg, &e, 0);
+      if (!*optarg || (e && *e))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'C':
+      params.checkpoint = optarg;
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (!params.set_begin) {
+    Error("the new beginning sector (-b) is required\n");
+    errorcnt++;
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc)
+  {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
+
+  params.drive_name = strdup(argv[optind]);
+
+  r = translate_partition_dev(&params.drive_name, &params.partition);
+  if (r != CGPT_OK)
+    goto out;
+
+  if (!params.partition) {
+    Error("the partition (-i) is required\n");
+    r = CGPT_FAILED;
+    goto out;
+  }
+
+  r = CgptMove(&params);
+
+out:
+  free(params.drive_name);
+  return r;
+}
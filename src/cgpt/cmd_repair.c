@@ -11,11 +11,29 @@
 
 static void Usage(void)
 {
-  printf("\nUsage: %s repair [OPTIONS] DRIVE\n\n"
+  printf("\nUsage: %s repair [OPTIONS] DRIVE...\n"
+         "       %s repair [OPTIONS] --all\n\n"
          "Repair damaged GPT headers and tables.\n\n"
          "Options:\n"
-         "  -v           Verbose\n"
-         "\n", progname);
+         "  -a, --all      Repair every whole disk\n"
+         "  -D, --discover If there is no valid GPT, look for a backup\n"
+         "                 header left behind when the drive grew, and\n"
+         "                 rebuild both copies from it\n"
+         "  -j NUM         Number of drives to repair at once (default is\n"
+         "                 the number of CPUs)\n"
+         "  -n, --dry-run  Only print which sectors would be written\n"
+         "  -v             Verbose\n"
+         "\n"
+         "Only the sectors of the PMBR and tables that change are written.\n"
+         "With more than one drive, --all or --dry-run, each change is\n"
+         "reported as a line \"DRIVE: wrote WHAT, N sectors at LBA X-Y\",\n"
+         "followed by a total for the drive. Drives without any valid GPT\n"
+         "header are not touched then.\n"
+         "\n"
+         "--discover first tries where a damaged primary header says the\n"
+         "backup is and the ends of drives of common sizes, then scans the\n"
+         "last 8 GiB of the drive backwards.\n"
+         "\n", progname, progname);
 }
 
 int cmd_repair(int argc, char *argv[]) {
@@ -23,15 +41,40 @@ int cmd_repair(int argc, char *argv[]) {
   memset(&params, 0, sizeof(params));
 
   int c;
-  int r;
+  int r = CGPT_OK;
   int errorcnt = 0;
-  uint32_t partition = 0;
+  char *e = 0;
+  uint32_t i, partition = 0;
+
+  static const struct option long_options[] = {
+    {"all", no_argument, NULL, 'a'},
+    {"discover", no_argument, NULL, 'D'},
+    {"dry-run", no_argument, NULL, 'n'},
+    {NULL, 0, NULL, 0}
+  };
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hv")) != -1)
+  while ((c=getopt_long(argc, argv, ":haDj:nv", long_options, NULL)) != -1)
   {
     switch (c)
     {
+    case 'a':
+      params.all = 1;
+      break;
+    case 'D':
+      params.discover = 1;
+      break;
+    case 'j':
+      params.jobs = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.jobs)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'n':
+      params.dry_run = 1;
+      break;
     case 'v':
       params.verbose++;
       break;
@@ -58,15 +101,28 @@ int cmd_repair(int argc, char *argv[]) {
     return CGPT_FAILED;
   }
 
-  params.drive_name = strdup(argv[optind]);
+  if (optind >= argc && !params.all)
+  {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
 
-  r = translate_partition_dev(&params.drive_name, &partition);
-  if (r != CGPT_OK)
-    goto out;
+  params.num_drives = argc - optind;
+  params.drives = calloc(params.num_drives + 1, sizeof(char *));
+  require(params.drives);
+  for (i = 0; i < params.num_drives; i++) {
+    params.drives[i] = strdup(argv[optind + i]);
+    require(params.drives[i]);
+    r = translate_partition_dev(&params.drives[i], &partition);
+    if (r != CGPT_OK)
+      goto out;
+  }
 
   r = CgptRepair(&params);
 
 out:
-  free(params.drive_name);
+  for (i = 0; i < params.num_drives; i++)
+    free(params.drives[i]);
+  free(params.drives);
   return r;
 }
@@ -0,0 +1,101 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s rescue [OPTIONS] DRIVE\n\n"
+         "Look for filesystems on a drive whose partition table is gone,\n"
+         "and print a table for them in the manifest format of \"%s dump\".\n"
+         "The drive is only read. Once the table looks right, write it with\n"
+         "  %s create DRIVE && %s apply -f MANIFEST DRIVE\n\n"
+         "Options:\n"
+         "  -a SECTORS   Look for a filesystem at every multiple of SECTORS\n"
+         "               (default 8, one 4 KiB block)\n"
+         "  -j NUM       Number of threads reading the drive (default is the\n"
+         "               number of CPUs)\n"
+         "  -q           Don't report progress on stderr\n"
+         "  -v           Also list what was found but left out of the table\n"
+         "\n"
+         "ext2/3/4, XFS, FAT, squashfs and swap are recognized. Each\n"
+         "partition is made as large as the filesystem in it, so it may\n"
+         "come out smaller than it was. Anything found inside a partition,\n"
+         "such as a disk image in a filesystem, is left out.\n"
+         "\n", progname, progname, progname, progname);
+}
+
+int cmd_rescue(int argc, char *argv[]) {
+  CgptRescueParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":ha:j:qv")) != -1)
+  {
+    switch (c)
+    {
+    case 'a':
+      params.alignment = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.alignment)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'j':
+      params.jobs = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.jobs)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'q':
+      params.quiet = 1;
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc)
+  {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
+
+  params.drive_name = argv[optind];
+
+  return CgptRescue(&params);
+}
@@ -11,6 +11,42 @@
 #include "cgpt.h"
 #include "vboot_host.h"
 
+/* Parse a comma separated list of field names into params, replacing any
+ * list given before. */
+static int ParseFields(const char *list, CgptShowParams *params) {
+  char *copy, *name, *save = NULL;
+  int i, rv = CGPT_OK;
+
+  copy = strdup(list);
+  require(copy);
+  params->num_fields = 0;
+  for (name = strtok_r(copy, ",", &save); name;
+       name = strtok_r(NULL, ",", &save)) {
+    const char *field = strcmp(name, "uuid") ? name : "guid";
+
+    for (i = 0; i < CGPT_NUM_FIELDS; i++)
+      if (!strcmp(field, show_field_names[i]))
+        break;
+    if (i == CGPT_NUM_FIELDS) {
+      Error("unknown field in --fields: \"%s\"\n", name);
+      rv = CGPT_FAILED;
+      break;
+    }
+    if (params->num_fields == CGPT_MAX_SHOW_FIELDS) {
+      Error("too many fields in --fields: \"%s\"\n", list);
+      rv = CGPT_FAILED;
+      break;
+    }
+    params->fields[params->num_fields++] = i;
+  }
+  if (rv == CGPT_OK && !params->num_fields) {
+    Error("no fields in --fields: \"%s\"\n", list);
+    rv = CGPT_FAILED;
+  }
+  free(copy);
+  return rv;
+}
+
 static void Usage(void)
 {
   printf("\nUsage: %s show [OPTIONS] DRIVE\n\n"
@@ -30,6 +66,21 @@ static void Usage(void)
          "               -P  Priority flag\n"
          "               -A  raw 64-bit attribute value\n"
          "  -d           Debug output (including invalid headers)\n"
+         "  --format=FORMAT\n"
+         "               Output format: text (default), json for one object\n"
+         "               describing the whole table, or ndjson for one line\n"
+         "               per partition\n"
+         "  --fields=FIELD,...\n"
+         "               Print only these fields of each partition (or of\n"
+         "               partition NUM), one partition per line, separated\n"
+         "               by tabs unless --format is given. Fields are:\n"
+         "               number, start, size, label, type, type_name,\n"
+         "               guid (or uuid), attrs, priority, tries, successful,\n"
+         "               legacy_boot. Only the last --fields counts.\n"
+         "  --fingerprint\n"
+         "               Print a digest that changes whenever the table\n"
+         "               does, for cheap change detection. Not with\n"
+         "               --format or --fields\n"
          "\n", progname);
 }
 
@@ -42,11 +93,38 @@ int cmd_show(int argc, char *argv[]) {
   int r = CGPT_FAILED;
   char *e = 0;
 
+  static const struct option long_options[] = {
+    {"fingerprint", no_argument, NULL, 'F'},
+    {"format", required_argument, NULL, 'f'},
+    {"fields", required_argument, NULL, 'e'},
+    {NULL, 0, NULL, 0}
+  };
+
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hnvqi:bstulSTPAd")) != -1)
+  while ((c=getopt_long(argc, argv, ":hnvqi:bstulSTPAd", long_options,
+                        NULL)) != -1)
   {
     switch (c)
     {
+    case 'F':
+      params.fingerprint = 1;
+      break;
+    case 'e':
+      if (CGPT_OK != ParseFields(optarg, &params))
+        errorcnt++;
+      break;
+    case 'f':
+      if (!strcmp(optarg, "text")) {
+        params.format = CGPT_FORMAT_TEXT;
+      } else if (!strcmp(optarg, "json")) {
+        params.format = CGPT_FORMAT_JSON;
+      } else if (!strcmp(optarg, "ndjson")) {
+        params.format = CGPT_FORMAT_NDJSON;
+      } else {
+        Error("invalid argument to --format: \"%s\"\n", optarg);
+        errorcnt++;
+      }
+      break;
     case 'n':
       params.numeric = 1;
       break;
@@ -96,6 +174,17 @@ int cmd_show(int argc, char *argv[]) {
       break;
     }
   }
+  if ((params.format != CGPT_FORMAT_TEXT || params.num_fields) &&
+      params.single_item) {
+    Error("-%c can't be combined with --format or --fields\n",
+          params.single_item);
+    errorcnt++;
+  }
+  if ((params.format != CGPT_FORMAT_TEXT || params.num_fields) &&
+      params.fingerprint) {
+    Error("--fingerprint can't be combined with --format or --fields\n");
+    errorcnt++;
+  }
   if (errorcnt)
   {
     Usage();
@@ -0,0 +1,85 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s stamp [OPTIONS] TEMPLATE OUTPUT...\n\n"
+         "Write the partition table of TEMPLATE to each OUTPUT, giving every\n"
+         "copy a new disk GUID and new partition unique GUIDs.\n\n"
+         "Options:\n"
+         "  -j NUM       Number of images to write at once (default is the\n"
+         "               number of CPUs)\n"
+         "  -v           Print each image as it is written\n"
+         "\n"
+         "Image files are created or truncated to the size of TEMPLATE and\n"
+         "hold nothing but the table. Block devices must be the same size\n"
+         "as TEMPLATE.\n"
+         "\n", progname);
+}
+
+int cmd_stamp(int argc, char *argv[]) {
+  CgptStampParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hj:v")) != -1)
+  {
+    switch (c)
+    {
+    case 'j':
+      params.jobs = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.jobs)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (argc - optind < 2)
+  {
+    Error("missing template or output argument\n");
+    return CGPT_FAILED;
+  }
+
+  params.template_name = argv[optind];
+  params.outputs = argv + optind + 1;
+  params.num_outputs = argc - optind - 1;
+
+  return CgptStamp(&params);
+}
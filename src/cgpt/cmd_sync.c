@@ -0,0 +1,102 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s sync [OPTIONS] --from GOLDEN DRIVE...\n\n"
+         "Make the partition table of each DRIVE match the one on GOLDEN,\n"
+         "writing only the sectors that differ.\n\n"
+         "Options:\n"
+         "  -f, --from=GOLDEN  Drive or image holding the golden table\n"
+         "  -j NUM             Number of drives to sync at once (default is\n"
+         "                     the number of CPUs)\n"
+         "  -n                 Only report how many sectors differ\n"
+         "  -v                 Report the sectors written to each drive\n"
+         "\n"
+         "Each DRIVE keeps its own disk GUID and the unique GUIDs of\n"
+         "partitions whose type doesn't change, and its headers are fitted\n"
+         "to its own size. The partitions must fit on every DRIVE.\n"
+         "\n", progname);
+}
+
+int cmd_sync(int argc, char *argv[]) {
+  CgptSyncParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  static const struct option long_options[] = {
+    {"from", required_argument, NULL, 'f'},
+    {NULL, 0, NULL, 0}
+  };
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt_long(argc, argv, ":hf:j:nv", long_options, NULL)) != -1)
+  {
+    switch (c)
+    {
+    case 'f':
+      params.golden_name = optarg;
+      break;
+    case 'j':
+      params.jobs = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.jobs)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+    case 'n':
+      params.dry_run = 1;
+      break;
+    case 'v':
+      params.verbose++;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (!params.golden_name)
+  {
+    Error("the golden table (--from) is required\n");
+    errorcnt++;
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc)
+  {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
+
+  params.drives = argv + optind;
+  params.num_drives = argc - optind;
+
+  return CgptSync(&params);
+}
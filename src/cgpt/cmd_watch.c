@@ -0,0 +1,82 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+static void Usage(void)
+{
+  printf("\nUsage: %s watch [OPTIONS] [DRIVE...]\n\n"
+         "Print a line of JSON whenever a drive appears or disappears, or its\n"
+         "partition table changes. Without DRIVE, every whole disk is\n"
+         "watched.\n\n"
+         "Options:\n"
+         "  -c NUM       Exit after NUM events\n"
+         "\n"
+         "Each event looks like\n"
+         "  {\"event\":\"change\",\"drive\":\"/dev/sda\","
+         "\"fingerprint\":\"...\"}\n"
+         "where event is \"add\", \"change\" or \"remove\", and fingerprint\n"
+         "is as printed by \"show --fingerprint\", or null if the drive has\n"
+         "no readable table. Drives present at startup are reported as\n"
+         "added. Block devices are followed through kernel uevents and\n"
+         "image files through inotify. Either is also checked whenever it\n"
+         "is closed after being written.\n"
+         "\n", progname);
+}
+
+int cmd_watch(int argc, char *argv[]) {
+  CgptWatchParams params;
+  memset(&params, 0, sizeof(params));
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hc:")) != -1)
+  {
+    switch (c)
+    {
+    case 'c':
+      params.count = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) || !params.count)
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind < argc) {
+    params.drives = argv + optind;
+    params.num_drives = argc - optind;
+  }
+
+  return CgptWatch(&params);
+}
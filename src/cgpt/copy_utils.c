@@ -0,0 +1,422 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cgpt.h"
+#include "copy_utils.h"
+#include "crc32.h"
+#include "vboot_host.h"
+
+/* Buffer alignment, good enough for O_DIRECT on any common device. */
+#define COPY_ALIGN 4096
+
+/* Flush and report progress after this many chunks (64MB). */
+#define COPY_CHECKPOINT_CHUNKS 16
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* Read or write exactly len bytes, returns 0 or an errno value. */
+static int full_pread(int fd, uint8_t *buf, size_t len, uint64_t offset) {
+  while (len) {
+    ssize_t n = pread(fd, buf, len, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return errno;
+    if (n == 0)
+      return EIO;   /* unexpected end of file */
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+static int full_pwrite(int fd, const uint8_t *buf, size_t len,
+                       uint64_t offset) {
+  while (len) {
+    ssize_t n = pwrite(fd, buf, len, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return errno;
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+/* A chunk being written in the background while the next one is read. */
+struct write_job {
+  pthread_t thread;
+  int fd;
+  const uint8_t *buf;
+  size_t len;
+  uint64_t offset;
+  uint32_t crc;   /* running CRC32 including this chunk */
+  int err;
+};
+
+static void *write_job_run(void *arg) {
+  struct write_job *job = arg;
+  job->err = full_pwrite(job->fd, job->buf, job->len, job->offset);
+  return NULL;
+}
+
+static int flush_and_checkpoint(int fd, const struct copy_state *state,
+                                copy_checkpoint_fn checkpoint, void *arg) {
+  if (!checkpoint)
+    return CGPT_OK;   /* the caller flushes once at the end */
+  if (fdatasync(fd) < 0) {
+    Error("Cannot flush copied data: %s\n", strerror(errno));
+    return CGPT_FAILED;
+  }
+  return checkpoint(state, arg);
+}
+
+int copy_is_backward(uint64_t src, uint64_t dst, uint64_t len) {
+  return dst > src && dst < src + len;
+}
+
+/* Offset of the n byte chunk that starts pos bytes into the copy order. */
+static uint64_t chunk_offset(uint64_t pos, uint64_t n, uint64_t len,
+                             int backward) {
+  return backward ? len - pos - n : pos;
+}
+
+/* At most window bytes are written between two checkpoints. */
+static int copy_buffered(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+                         uint64_t len, int backward, uint64_t window,
+                         struct copy_state *state,
+                         copy_checkpoint_fn checkpoint, void *arg) {
+  uint8_t *buf[2] = {NULL, NULL};
+  struct write_job job;
+  int pending = 0, cur = 0;
+  int retval = CGPT_FAILED;
+  uint64_t pos, n, since_checkpoint = 0;
+  int err;
+
+  if (posix_memalign((void **)&buf[0], COPY_ALIGN, COPY_CHUNK_BYTES) ||
+      posix_memalign((void **)&buf[1], COPY_ALIGN, COPY_CHUNK_BYTES)) {
+    Error("Cannot allocate copy buffers\n");
+    goto out;
+  }
+
+  for (pos = state->done; pos < len; pos += n) {
+    uint64_t off;
+    uint32_t crc;
+
+    n = MIN(len - pos, state->chunk);
+    off = chunk_offset(pos, n, len, backward);
+
+    if ((err = full_pread(in_fd, buf[cur], n, src + off))) {
+      Error("Cannot read at offset %llu: %s\n",
+            (unsigned long long)(src + off), strerror(err));
+      goto out;
+    }
+    crc = Crc32Extend(pending ? job.crc : state->crc, buf[cur], n);
+
+    if (pending) {
+      pending = 0;
+      pthread_join(job.thread, NULL);
+      if (job.err) {
+        Error("Cannot write at offset %llu: %s\n",
+              (unsigned long long)job.offset, strerror(job.err));
+        goto out;
+      }
+      state->done += job.len;
+      state->crc = job.crc;
+    }
+    if (since_checkpoint + n > window) {
+      if (CGPT_OK != flush_and_checkpoint(out_fd, state, checkpoint, arg))
+        goto out;
+      since_checkpoint = 0;
+    }
+
+    job.fd = out_fd;
+    job.buf = buf[cur];
+    job.len = n;
+    job.offset = dst + off;
+    job.crc = crc;
+    job.err = 0;
+    if ((err = pthread_create(&job.thread, NULL, write_job_run, &job))) {
+      Error("Cannot start writer thread: %s\n", strerror(err));
+      goto out;
+    }
+    pending = 1;
+    since_checkpoint += n;
+    cur ^= 1;
+  }
+
+  if (pending) {
+    pending = 0;
+    pthread_join(job.thread, NULL);
+    if (job.err) {
+      Error("Cannot write at offset %llu: %s\n",
+            (unsigned long long)job.offset, strerror(job.err));
+      goto out;
+    }
+    state->done += job.len;
+    state->crc = job.crc;
+  }
+
+  retval = flush_and_checkpoint(out_fd, state, checkpoint, arg);
+
+out:
+  if (pending)
+    pthread_join(job.thread, NULL);
+  free(buf[0]);
+  free(buf[1]);
+  return retval;
+}
+
+/* Let the kernel (and possibly the filesystem, via reflinks or server side
+ * copies) move the data. Returns CGPT_NOOP if the files don't support it and
+ * nothing has been copied yet. */
+static int copy_offload(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+                        uint64_t len, struct copy_state *state,
+                        copy_checkpoint_fn checkpoint, void *arg) {
+  uint64_t since_checkpoint = 0;
+  int first = 1;
+
+  while (state->done < len) {
+    loff_t in_off = src + state->done;
+    loff_t out_off = dst + state->done;
+    size_t n = MIN(len - state->done,
+                   (uint64_t)COPY_CHUNK_BYTES * COPY_CHECKPOINT_CHUNKS);
+    ssize_t r = copy_file_range(in_fd, &in_off, out_fd, &out_off, n, 0);
+
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0 && first && (errno == ENOSYS || errno == EXDEV ||
+                           errno == EINVAL || errno == EOPNOTSUPP))
+      return CGPT_NOOP;
+    if (r < 0) {
+      Error("copy_file_range failed at offset %llu: %s\n",
+            (unsigned long long)(src + state->done), strerror(errno));
+      return CGPT_FAILED;
+    }
+    if (r == 0) {
+      Error("Unexpected end of file at offset %llu\n",
+            (unsigned long long)(src + state->done));
+      return CGPT_FAILED;
+    }
+
+    first = 0;
+    state->done += r;
+    since_checkpoint += r;
+    if (since_checkpoint >= (uint64_t)COPY_CHUNK_BYTES * COPY_CHECKPOINT_CHUNKS
+        && state->done < len) {
+      since_checkpoint = 0;
+      if (CGPT_OK != flush_and_checkpoint(out_fd, state, checkpoint, arg))
+        return CGPT_FAILED;
+    }
+  }
+
+  return flush_and_checkpoint(out_fd, state, checkpoint, arg);
+}
+
+static int is_regular(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+int copy_range(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+               uint64_t len, struct copy_state *state,
+               copy_checkpoint_fn checkpoint, void *arg) {
+  int overlap = in_fd == out_fd && src < dst + len && dst < src + len;
+  int backward = in_fd == out_fd && copy_is_backward(src, dst, len);
+  uint64_t window = (uint64_t)COPY_CHUNK_BYTES * COPY_CHECKPOINT_CHUNKS;
+
+  require(state && state->done <= len);
+
+  // Each write of an overlapping copy lands on source data that was read
+  // |dst - src| bytes earlier. A resumed copy reads the source again from
+  // the last checkpoint on, so no more than that may have been written
+  // past it, or the data read back is already overwritten.
+  if (overlap && checkpoint && src != dst)
+    window = MIN(window, src < dst ? dst - src : src - dst);
+  state->chunk = MIN(window, COPY_CHUNK_BYTES);
+
+  if (!overlap && is_regular(in_fd) && is_regular(out_fd)) {
+    int r = copy_offload(in_fd, src, out_fd, dst, len, state,
+                         checkpoint, arg);
+    if (r != CGPT_NOOP)
+      return r;
+  }
+
+  return copy_buffered(in_fd, src, out_fd, dst, len, backward, window, state,
+                       checkpoint, arg);
+}
+
+int crc_range(int fd, uint64_t offset, uint64_t len, int backward,
+              uint64_t chunk, uint32_t *crc) {
+  uint8_t *buf = NULL;
+  uint64_t pos, n;
+  int err;
+
+  require(chunk && chunk <= COPY_CHUNK_BYTES);
+  if (posix_memalign((void **)&buf, COPY_ALIGN, chunk)) {
+    Error("Cannot allocate verify buffer\n");
+    return CGPT_FAILED;
+  }
+
+  *crc = 0;
+  for (pos = 0; pos < len; pos += n) {
+    uint64_t off;
+
+    n = MIN(len - pos, chunk);
+    off = chunk_offset(pos, n, len, backward);
+    if ((err = full_pread(fd, buf, n, offset + off))) {
+      Error("Cannot read at offset %llu: %s\n",
+            (unsigned long long)(offset + off), strerror(err));
+      free(buf);
+      return CGPT_FAILED;
+    }
+    *crc = Crc32Extend(*crc, buf, n);
+  }
+
+  free(buf);
+  return CGPT_OK;
+}
+
+int zero_range(int fd, uint64_t offset, uint64_t len) {
+  uint8_t *buf;
+  uint64_t pos, n;
+  int err;
+
+  if (!len)
+    return CGPT_OK;
+
+  if (is_regular(fd)) {
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  offset, len) == 0 ||
+        fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE,
+                  offset, len) == 0)
+      return CGPT_OK;
+  } else {
+    uint64_t range[2] = {offset, len};
+    if (ioctl(fd, BLKZEROOUT, &range) == 0)
+      return CGPT_OK;
+  }
+
+  // None of that is supported, write the zeros out.
+  buf = calloc(1, COPY_CHUNK_BYTES);
+  if (!buf) {
+    Error("Cannot allocate zero buffer\n");
+    return CGPT_FAILED;
+  }
+  for (pos = 0; pos < len; pos += n) {
+    n = MIN(len - pos, COPY_CHUNK_BYTES);
+    if ((err = full_pwrite(fd, buf, n, offset + pos))) {
+      Error("Cannot write at offset %llu: %s\n",
+            (unsigned long long)(offset + pos), strerror(err));
+      free(buf);
+      return CGPT_FAILED;
+    }
+  }
+  free(buf);
+  return CGPT_OK;
+}
+
+int discard_range(int fd, uint64_t offset, uint64_t len) {
+  int r;
+
+  if (!len)
+    return CGPT_OK;
+
+  if (is_regular(fd)) {
+    r = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len);
+  } else {
+    uint64_t range[2] = {offset, len};
+    r = ioctl(fd, BLKDISCARD, &range);
+  }
+  if (r == 0)
+    return CGPT_OK;
+  if (errno == EOPNOTSUPP)
+    return CGPT_NOOP;
+  return CGPT_FAILED;
+}
+
+void find_data(int fd, uint64_t *start, uint64_t *stop, uint64_t end) {
+  off_t data, hole;
+
+  *stop = end;
+  data = lseek(fd, *start, SEEK_DATA);
+  if (data < 0) {
+    if (errno == ENXIO)
+      *start = end;   /* nothing but holes up to EOF */
+    return;
+  }
+  *start = MIN((uint64_t)data, end);
+  if (*start == end)
+    return;
+  hole = lseek(fd, data, SEEK_HOLE);
+  if (hole >= 0)
+    *stop = MIN((uint64_t)hole, end);
+}
+
+/* Share the blocks of [src, src + len) with [dst, dst + len) if the filesystem
+ * supports it. Returns CGPT_NOOP if it can't, e.g. for unaligned ranges. */
+static int clone_extent(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+                        uint64_t len) {
+  struct file_clone_range range = {
+    .src_fd = in_fd,
+    .src_offset = src,
+    .src_length = len,
+    .dest_offset = dst,
+  };
+
+  if (ioctl(out_fd, FICLONERANGE, &range) == 0)
+    return CGPT_OK;
+  return CGPT_NOOP;
+}
+
+int copy_sparse_range(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+                      uint64_t len) {
+  int try_clone = is_regular(in_fd) && is_regular(out_fd);
+  uint64_t pos = src, end = src + len;
+
+  while (pos < end) {
+    uint64_t start = pos, stop;
+    struct copy_state state = {0, 0, 0};
+
+    find_data(in_fd, &start, &stop, end);
+    if (CGPT_OK != zero_range(out_fd, dst + (pos - src), start - pos))
+      return CGPT_FAILED;
+    if (start == end)
+      break;
+
+    if (try_clone) {
+      if (CGPT_OK == clone_extent(in_fd, start, out_fd, dst + (start - src),
+                                  stop - start)) {
+        pos = stop;
+        continue;
+      }
+      try_clone = 0;    /* don't keep asking */
+    }
+
+    if (CGPT_OK != copy_range(in_fd, start, out_fd, dst + (start - src),
+                              stop - start, &state, NULL, NULL))
+      return CGPT_FAILED;
+    pos = stop;
+  }
+
+  if (fdatasync(out_fd) < 0) {
+    Error("Cannot flush copied data: %s\n", strerror(errno));
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
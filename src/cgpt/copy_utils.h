@@ -0,0 +1,78 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SEISMOGRAPH_CGPT_COPY_UTILS_H_
+#define SEISMOGRAPH_CGPT_COPY_UTILS_H_
+
+#include <stdint.h>
+
+/* Size of the buffers used for data copies, a multiple of any sector size. */
+#define COPY_CHUNK_BYTES (4 * 1024 * 1024)
+
+/* Progress of a copy_range() call. Passing back the state saved by the
+ * checkpoint callback resumes an interrupted copy where it left off. */
+struct copy_state {
+  uint64_t done;    /* bytes copied and flushed so far */
+  uint32_t crc;     /* CRC32 of those bytes, see copy_range() */
+  uint64_t chunk;   /* size of the chunks copied, set by copy_range() */
+};
+
+/* Called after copied data has been flushed to stable storage.
+ * Returning anything but CGPT_OK aborts the copy. Without a callback the
+ * copy isn't flushed at all and that is left to the caller. */
+typedef int (*copy_checkpoint_fn)(const struct copy_state *state, void *arg);
+
+/* Returns 1 if a copy from src to dst within the same file must run from the
+ * end of the range towards the start to avoid clobbering unread data. */
+int copy_is_backward(uint64_t src, uint64_t dst, uint64_t len);
+
+/* Copy len bytes from offset src of in_fd to offset dst of out_fd.
+ * When in_fd == out_fd the ranges may overlap. Regular files use
+ * copy_file_range() when the ranges don't overlap, everything else is copied
+ * through a pair of large aligned buffers so that reading the next chunk
+ * overlaps with writing the previous one.
+ *
+ * state->crc is only maintained by the buffered path, i.e. for overlapping
+ * copies, and covers the data in the order it was copied (see crc_range()).
+ * With a checkpoint callback, overlapping copies are checkpointed before they
+ * write more than |dst - src| bytes past the last checkpoint, so that they
+ * can be resumed from it.
+ *
+ * Returns CGPT_OK or CGPT_FAILED. */
+int copy_range(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+               uint64_t len, struct copy_state *state,
+               copy_checkpoint_fn checkpoint, void *arg);
+
+/* Find the first extent of data in [*start, end) of fd, narrowing *start and
+ * *stop to it. *start == end if there is no more data. Files and devices that
+ * can't report holes are treated as all data. */
+void find_data(int fd, uint64_t *start, uint64_t *stop, uint64_t end);
+
+/* Copy len bytes like copy_range(), but leave out the holes in the source.
+ * The matching parts of the destination are zeroed with zero_range(). Data
+ * is shared with FICLONERANGE where the filesystem allows it, and flushed
+ * before returning. The ranges must not overlap.
+ * Returns CGPT_OK or CGPT_FAILED. */
+int copy_sparse_range(int in_fd, uint64_t src, int out_fd, uint64_t dst,
+                      uint64_t len);
+
+/* Zero len bytes at offset, by punching a hole or with FALLOC_FL_ZERO_RANGE
+ * in regular files or with BLKZEROOUT on block devices, falling back to
+ * writing zeros.
+ * Returns CGPT_OK or CGPT_FAILED. */
+int zero_range(int fd, uint64_t offset, uint64_t len);
+
+/* Tell the storage len bytes at offset are no longer needed, with BLKDISCARD
+ * on block devices or by punching a hole in regular files. Reads of the range
+ * may return zeros or the old data afterwards.
+ * Returns CGPT_OK, CGPT_NOOP if not supported, or CGPT_FAILED with errno. */
+int discard_range(int fd, uint64_t offset, uint64_t len);
+
+/* Compute the CRC32 of len bytes at offset, visiting chunks of the given size
+ * in the same order copy_range() uses for a forward or backward copy.
+ * Returns CGPT_OK or CGPT_FAILED. */
+int crc_range(int fd, uint64_t offset, uint64_t len, int backward,
+              uint64_t chunk, uint32_t *crc);
+
+#endif  // SEISMOGRAPH_CGPT_COPY_UTILS_H_
@@ -0,0 +1,96 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+/* GUID strings are written most significant digit first, but the first three
+ * fields are stored little-endian, so each byte of Guid.u.raw is found at
+ * this offset in "C12A7328-F81F-11D2-BA4B-00A0C93EC93B". */
+static const uint8_t guid_str_offsets[GUID_SIZE] = {
+  6, 4, 2, 0,  11, 9,  16, 14,  19, 21,  24, 26, 28, 30, 32, 34,
+};
+
+static const uint8_t guid_dash_offsets[] = { 8, 13, 18, 23 };
+
+static const char hex_upper[] = "0123456789ABCDEF";
+static const char hex_lower[] = "0123456789abcdef";
+
+/* Digit value plus one, so that every other character reads as zero. */
+static const uint8_t hex_values[256] = {
+  ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+  ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+  ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+  ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+int StrToGuid(const char *str, Guid *guid) {
+  const unsigned char *s = (const unsigned char *)str;
+  Guid parsed;
+  size_t len = strlen(str);
+  int i;
+
+  if (len == GUID_BRACED_STRLEN - 1 && s[0] == '{' && s[len - 1] == '}')
+    s++;
+  else if (len != GUID_STRLEN - 1)
+    return CGPT_FAILED;
+
+  for (i = 0; i < sizeof(guid_dash_offsets); i++)
+    if (s[guid_dash_offsets[i]] != '-')
+      return CGPT_FAILED;
+
+  for (i = 0; i < GUID_SIZE; i++) {
+    uint8_t hi = hex_values[s[guid_str_offsets[i]]];
+    uint8_t lo = hex_values[s[guid_str_offsets[i] + 1]];
+    if (!hi || !lo)
+      return CGPT_FAILED;
+    parsed.u.raw[i] = (uint8_t)(((hi - 1) << 4) | (lo - 1));
+  }
+
+  memcpy(guid, &parsed, sizeof(parsed));
+  return CGPT_OK;
+}
+
+int GuidFormat(const Guid *guid, char *str, int flags) {
+  const char *digits = (flags & GUID_LOWER) ? hex_lower : hex_upper;
+  char *s = str;
+  int i;
+
+  if (flags & GUID_BRACES)
+    *s++ = '{';
+  for (i = 0; i < GUID_SIZE; i++) {
+    uint8_t b = guid->u.raw[i];
+    s[guid_str_offsets[i]] = digits[b >> 4];
+    s[guid_str_offsets[i] + 1] = digits[b & 0xf];
+  }
+  for (i = 0; i < sizeof(guid_dash_offsets); i++)
+    s[guid_dash_offsets[i]] = '-';
+  s += GUID_STRLEN - 1;
+  if (flags & GUID_BRACES)
+    *s++ = '}';
+  *s = '\0';
+  return s - str;
+}
+
+void GuidFormatArray(const void *first, size_t count, size_t stride,
+                     char *str, int flags) {
+  const uint8_t *p = first;
+  size_t width = (flags & GUID_BRACES) ? GUID_BRACED_STRLEN : GUID_STRLEN;
+  size_t i;
+
+  for (i = 0; i < count; i++, p += stride, str += width)
+    GuidFormat((const Guid *)p, str, flags);
+}
+
+void GuidToStrUpper(const Guid *guid, char *str, unsigned int buflen) {
+  require(buflen >= GUID_STRLEN);
+  GuidFormat(guid, str, 0);
+}
+
+void GuidToStrLower(const Guid *guid, char *str, unsigned int buflen) {
+  require(buflen >= GUID_STRLEN);
+  GuidFormat(guid, str, GUID_LOWER);
+}
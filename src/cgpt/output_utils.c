@@ -0,0 +1,112 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "cgpt.h"
+#include "output_utils.h"
+#include "vboot_host.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+void out_init(struct output *out, FILE *stream) {
+  out->stream = stream;
+  out->len = 0;
+}
+
+void out_flush(struct output *out) {
+  if (out->len)
+    fwrite(out->buf, 1, out->len, out->stream);
+  out->len = 0;
+}
+
+void out_bytes(struct output *out, const char *bytes, size_t len) {
+  while (len) {
+    size_t n = sizeof(out->buf) - out->len;
+
+    if (n == 0) {
+      out_flush(out);
+      continue;
+    }
+    if (n > len)
+      n = len;
+    memcpy(out->buf + out->len, bytes, n);
+    out->len += n;
+    bytes += n;
+    len -= n;
+  }
+}
+
+void out_str(struct output *out, const char *str) {
+  out_bytes(out, str, strlen(str));
+}
+
+void out_char(struct output *out, char c) {
+  if (out->len == sizeof(out->buf))
+    out_flush(out);
+  out->buf[out->len++] = c;
+}
+
+void out_spaces(struct output *out, int count) {
+  while (count-- > 0)
+    out_char(out, ' ');
+}
+
+void out_str_padded(struct output *out, const char *str, int width) {
+  size_t len = strlen(str);
+
+  if (len < width)
+    out_spaces(out, width - len);
+  out_bytes(out, str, len);
+}
+
+void out_uint(struct output *out, uint64_t value, int width) {
+  char digits[20];
+  int n = 0;
+
+  do {
+    digits[sizeof(digits) - ++n] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  out_spaces(out, width - n);
+  out_bytes(out, digits + sizeof(digits) - n, n);
+}
+
+void out_hex(struct output *out, uint64_t value, int digits) {
+  char buf[16];
+  int n = 0;
+
+  do {
+    buf[sizeof(buf) - ++n] = hex_digits[value & 0xf];
+    value >>= 4;
+  } while (value);
+  while (n < digits && n < sizeof(buf))
+    buf[sizeof(buf) - ++n] = '0';
+  out_bytes(out, buf + sizeof(buf) - n, n);
+}
+
+void out_guid(struct output *out, const Guid *guid) {
+  char buf[GUID_STRLEN];
+
+  out_bytes(out, buf, GuidFormat(guid, buf, 0));
+}
+
+void out_json_str(struct output *out, const char *str) {
+  const unsigned char *c;
+
+  out_char(out, '"');
+  for (c = (const unsigned char *)str; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out_char(out, '\\');
+      out_char(out, *c);
+    } else if (*c < 0x20 || *c == 0x7f) {
+      out_str(out, "\\u00");
+      out_char(out, hex_digits[*c >> 4]);
+      out_char(out, hex_digits[*c & 0xf]);
+    } else {
+      out_char(out, *c);
+    }
+  }
+  out_char(out, '"');
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SEISMOGRAPH_CGPT_OUTPUT_UTILS_H_
+#define SEISMOGRAPH_CGPT_OUTPUT_UTILS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gpt.h"
+
+#define OUTPUT_BUFFER_BYTES 16384
+
+/* Output is collected here and handed to the stream in one piece when the
+ * buffer fills up or out_flush() is called, so formatting a table costs no
+ * allocations and no stdio calls per field. */
+struct output {
+  FILE *stream;
+  size_t len;
+  char buf[OUTPUT_BUFFER_BYTES];
+};
+
+void out_init(struct output *out, FILE *stream);
+void out_flush(struct output *out);
+
+void out_bytes(struct output *out, const char *bytes, size_t len);
+void out_str(struct output *out, const char *str);
+void out_char(struct output *out, char c);
+void out_spaces(struct output *out, int count);
+
+/* Right-align str in a field of width characters, like printf("%*s"). */
+void out_str_padded(struct output *out, const char *str, int width);
+
+/* Print value in decimal, right-aligned in width characters if it is
+ * shorter, like printf("%*llu"). */
+void out_uint(struct output *out, uint64_t value, int width);
+
+/* Print value in lower case hex, zero-padded to digits characters, like
+ * printf("%0*llx"). */
+void out_hex(struct output *out, uint64_t value, int digits);
+
+/* Print a GUID the way GuidToStr() formats it. */
+void out_guid(struct output *out, const Guid *guid);
+
+/* Print str as a quoted JSON string. */
+void out_json_str(struct output *out, const char *str);
+
+#endif  // SEISMOGRAPH_CGPT_OUTPUT_UTILS_H_
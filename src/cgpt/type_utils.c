@@ -0,0 +1,266 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+/* Types listed here may be extended, or given extra aliases, by lines of
+ * the form "NAME GUID DESCRIPTION" in this file. */
+#define TYPES_FILE "/etc/cgpt/types"
+#define TYPES_FILE_ENV "CGPT_TYPES"
+
+struct type_info {
+  Guid type;
+  const char *name;
+  const char *description;
+  enum cgpt_type class;
+};
+
+static const struct type_info builtin_types[] = {
+  // ChromeOS (prefix-less names for backwards compatibility)
+  {GPT_ENT_TYPE_CHROMEOS_FIRMWARE, "firmware", "ChromeOS firmware",
+   CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_CHROMEOS_KERNEL, "kernel", "ChromeOS kernel",
+   CGPT_TYPE_KERNEL},
+  {GPT_ENT_TYPE_CHROMEOS_ROOTFS, "rootfs", "ChromeOS rootfs",
+   CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_DATA, "data", "Alias for linux-data",
+   CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_MSWIN_DATA, "chromeos-data", "Alias for mswin-data",
+   CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_CHROMEOS_RESERVED, "reserved", "ChromeOS reserved",
+   CGPT_TYPE_OTHER},
+
+  // MS Windows (data used to use this GUID instead of linux-data)
+  {GPT_ENT_TYPE_MSWIN_DATA, "mswin-data", "MS Windows data",
+   CGPT_TYPE_OTHER},
+
+  // GPT/UEFI standard types
+  {GPT_ENT_TYPE_EFI, "efi", "EFI System Partition", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_BIOS, "bios", "BIOS Boot Partition", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_UNUSED, "unused", "Unused (nonexistent) partition",
+   CGPT_TYPE_UNUSED},
+
+  // General Linux
+  {GPT_ENT_TYPE_LINUX_DATA, "linux-data", "Linux data", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_SWAP, "linux-swap", "Linux swap", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_BOOT, "linux-boot", "Linux /boot", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_HOME, "linux-home", "Linux /home", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_LVM, "linux-lvm", "Linux LVM", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_RAID, "linux-raid", "Linux RAID", CGPT_TYPE_OTHER},
+  {GPT_ENT_TYPE_LINUX_RESERVED, "linux-reserved", "Linux reserved",
+   CGPT_TYPE_OTHER},
+
+  // CoreOS
+  {GPT_ENT_TYPE_COREOS_ROOTFS, "coreos-usr", "Alias for coreos-rootfs",
+   CGPT_TYPE_ROOT},
+  {GPT_ENT_TYPE_COREOS_ROOTFS, "coreos-rootfs", "CoreOS rootfs",
+   CGPT_TYPE_ROOT},
+  {GPT_ENT_TYPE_COREOS_RESIZE, "coreos-resize", "CoreOS auto-resize",
+   CGPT_TYPE_RESIZE},
+  {GPT_ENT_TYPE_COREOS_RESERVED, "coreos-reserved", "CoreOS reserved",
+   CGPT_TYPE_OTHER},
+};
+
+/* All known types, built-in ones first, and two open addressed hash tables
+ * over them: one keyed by type GUID and one by alias name. Slots hold an
+ * index into types plus one, so zero marks an empty slot. Both tables are
+ * at most half full, so a lookup is a hash and a probe or two. */
+static struct {
+  struct type_info *types;
+  uint32_t count;
+  uint32_t bits;
+  uint16_t *by_guid;
+  uint16_t *by_name;
+} type_index;
+
+static pthread_once_t index_once = PTHREAD_ONCE_INIT;
+
+static uint32_t GuidHash(const Guid *guid) {
+  uint32_t a, b;
+
+  // Type GUIDs are random, so their first and last words mix well enough.
+  memcpy(&a, guid->u.raw, sizeof(a));
+  memcpy(&b, guid->u.raw + GUID_SIZE - sizeof(b), sizeof(b));
+  return ((a ^ b) * 0x9e3779b1U) >> (32 - type_index.bits);
+}
+
+static uint32_t NameHash(const char *name) {
+  uint32_t h = 2166136261U;   // FNV-1a
+
+  while (*name)
+    h = (h ^ (uint8_t)*name++) * 16777619U;
+  return (h * 0x9e3779b1U) >> (32 - type_index.bits);
+}
+
+/* Find the slot for 'guid', or the empty slot where it belongs. */
+static uint16_t *GuidSlot(const Guid *guid) {
+  uint32_t mask = (1U << type_index.bits) - 1;
+  uint32_t i = GuidHash(guid);
+
+  while (type_index.by_guid[i] &&
+         !GuidEqual(&type_index.types[type_index.by_guid[i] - 1].type, guid))
+    i = (i + 1) & mask;
+  return &type_index.by_guid[i];
+}
+
+static uint16_t *NameSlot(const char *name) {
+  uint32_t mask = (1U << type_index.bits) - 1;
+  uint32_t i = NameHash(name);
+
+  while (type_index.by_name[i] &&
+         strcmp(type_index.types[type_index.by_name[i] - 1].name, name))
+    i = (i + 1) & mask;
+  return &type_index.by_name[i];
+}
+
+/* Parse one "NAME GUID DESCRIPTION" line of the types file into 'info'.
+ * Returns CGPT_NOOP for blank lines and comments. */
+static int ParseTypeLine(char *line, struct type_info *info) {
+  char *name, *guid, *description, *end;
+
+  while (isspace((unsigned char)*line))
+    line++;
+  if (!*line || *line == '#')
+    return CGPT_NOOP;
+
+  name = strsep(&line, " \t");
+  while (line && isspace((unsigned char)*line))
+    line++;
+  guid = strsep(&line, " \t\n");
+  while (line && isspace((unsigned char)*line))
+    line++;
+  if (!guid || !*guid || CGPT_OK != StrToGuid(guid, &info->type))
+    return CGPT_FAILED;
+
+  description = line ? line : "";
+  end = description + strlen(description);
+  while (end > description && isspace((unsigned char)end[-1]))
+    *--end = '\0';
+  info->name = strdup(name);
+  info->description = strdup(*description ? description : name);
+  require(info->name && info->description);
+  info->class = CGPT_TYPE_OTHER;
+  return CGPT_OK;
+}
+
+/* Append the types listed in the types file, if there is one. */
+static void LoadTypesFile(uint32_t *capacity) {
+  const char *path = getenv(TYPES_FILE_ENV);
+  char *line = NULL;
+  size_t line_size = 0;
+  unsigned int line_number = 0;
+  FILE *file;
+
+  if (!path)
+    path = TYPES_FILE;
+  if (!*path || !(file = fopen(path, "r"))) {
+    if (*path && errno != ENOENT)
+      Error("cannot read %s: %s\n", path, strerror(errno));
+    return;
+  }
+
+  while (getline(&line, &line_size, file) != -1) {
+    struct type_info info;
+    int r;
+
+    line_number++;
+    r = ParseTypeLine(line, &info);
+    if (r == CGPT_NOOP)
+      continue;
+    if (r != CGPT_OK) {
+      Error("%s:%u: expected NAME GUID [DESCRIPTION]\n", path, line_number);
+      continue;
+    }
+    if (type_index.count == *capacity) {
+      *capacity *= 2;
+      type_index.types = realloc(type_index.types,
+                                 *capacity * sizeof(*type_index.types));
+      require(type_index.types);
+    }
+    type_index.types[type_index.count++] = info;
+  }
+
+  free(line);
+  fclose(file);
+}
+
+static void BuildIndex(void) {
+  uint32_t capacity = ARRAY_COUNT(builtin_types) * 2;
+  uint32_t i;
+
+  type_index.types = malloc(capacity * sizeof(*type_index.types));
+  require(type_index.types);
+  memcpy(type_index.types, builtin_types, sizeof(builtin_types));
+  type_index.count = ARRAY_COUNT(builtin_types);
+  LoadTypesFile(&capacity);
+  if (type_index.count > UINT16_MAX - 1)
+    type_index.count = UINT16_MAX - 1;
+
+  type_index.bits = 4;
+  while ((1U << type_index.bits) < type_index.count * 2)
+    type_index.bits++;
+  type_index.by_guid = calloc(1U << type_index.bits, sizeof(uint16_t));
+  type_index.by_name = calloc(1U << type_index.bits, sizeof(uint16_t));
+  require(type_index.by_guid && type_index.by_name);
+
+  // The first entry for a GUID or name wins, as it did when the table was
+  // searched in order. Extra aliases for a known GUID share its class.
+  for (i = 0; i < type_index.count; i++) {
+    uint16_t *slot = GuidSlot(&type_index.types[i].type);
+
+    if (*slot)
+      type_index.types[i].class = type_index.types[*slot - 1].class;
+    else
+      *slot = i + 1;
+    slot = NameSlot(type_index.types[i].name);
+    if (!*slot)
+      *slot = i + 1;
+  }
+}
+
+enum cgpt_type ClassifyType(const Guid *type, const char **description) {
+  uint16_t slot;
+
+  pthread_once(&index_once, BuildIndex);
+  slot = *GuidSlot(type);
+  if (!slot) {
+    if (description)
+      *description = NULL;
+    return CGPT_TYPE_UNKNOWN;
+  }
+  if (description)
+    *description = type_index.types[slot - 1].description;
+  return type_index.types[slot - 1].class;
+}
+
+int SupportedType(const char *name, Guid *type) {
+  uint16_t slot;
+
+  pthread_once(&index_once, BuildIndex);
+  slot = *NameSlot(name);
+  if (!slot)
+    return CGPT_FAILED;
+  memcpy(type, &type_index.types[slot - 1].type, sizeof(Guid));
+  return CGPT_OK;
+}
+
+void PrintTypes(void) {
+  uint32_t i;
+
+  pthread_once(&index_once, BuildIndex);
+  printf("The partition type may also be given as one of these aliases:\n\n");
+  for (i = 0; i < type_index.count; ++i) {
+    printf("    %-16s  %s\n", type_index.types[i].name,
+                          type_index.types[i].description);
+  }
+  printf("\n");
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/types.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+#ifndef CGPT_DLOPEN
+#include <uuid/uuid.h>
+#endif
+
+/* Fill guids with random version 4 GUIDs, laid out the way uuid_generate()
+ * lays them out. */
+int RandomGuids(Guid *guids, uint32_t count) {
+  uint8_t *bytes = (uint8_t *)guids;
+  size_t len = count * sizeof(Guid), done = 0;
+  uint32_t i;
+
+  while (done < len) {
+    ssize_t n = getrandom(bytes + done, len - done, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      Error("Cannot generate GUIDs: %s\n", strerror(errno));
+      return CGPT_FAILED;
+    }
+    done += n;
+  }
+
+  for (i = 0; i < count; i++) {
+    bytes = (uint8_t *)&guids[i];
+    bytes[6] = (bytes[6] & 0x0f) | 0x40;
+    bytes[8] = (bytes[8] & 0x3f) | 0x80;
+  }
+  return CGPT_OK;
+}
+
+#ifdef CGPT_DLOPEN
+
+#define UUID_SONAME "libuuid.so.1"
+
+static void (*sym_uuid_generate)(uint8_t *out);
+static pthread_once_t uuid_once = PTHREAD_ONCE_INIT;
+
+/* A missing libuuid is not an error, getrandom() does just as well. */
+static void dlopen_uuid(void) {
+  void *lib = dlopen(UUID_SONAME, RTLD_NOW | RTLD_LOCAL);
+
+  if (lib)
+    sym_uuid_generate = dlsym(lib, "uuid_generate");
+}
+
+void GenerateUuid(uint8_t *buffer) {
+  pthread_once(&uuid_once, dlopen_uuid);
+  if (sym_uuid_generate)
+    sym_uuid_generate(buffer);
+  else
+    require(CGPT_OK == RandomGuids((Guid *)buffer, 1));
+}
+
+#else
+
+void GenerateUuid(uint8_t *buffer) {
+  uuid_generate(buffer);
+}
+
+#endif
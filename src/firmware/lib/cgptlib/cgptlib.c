@@ -12,11 +12,24 @@
 #include "utility.h"
 #include "vboot_api.h"
 
+void GptSetView(GptData *gpt, uint8_t *head, uint8_t *tail,
+		uint32_t sector_bytes, uint64_t drive_sectors)
+{
+	gpt->primary_header = head + GPT_PMBR_SECTOR * sector_bytes;
+	gpt->primary_entries = gpt->primary_header +
+		GPT_HEADER_SECTOR * sector_bytes;
+	gpt->secondary_entries = tail;
+	gpt->secondary_header = tail + GPT_ENTRIES_SECTORS * sector_bytes;
+	gpt->sector_bytes = sector_bytes;
+	gpt->drive_sectors = drive_sectors;
+}
+
 int GptInit(GptData *gpt)
 {
 	int retval;
 
 	gpt->modified = 0;
+	gpt->modified_entry_sectors = 0;
 	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	gpt->current_priority = 999;
 
@@ -27,6 +40,9 @@ int GptInit(GptData *gpt)
 	}
 
 	GptRepair(gpt);
+#ifdef GPT_SHARE_ENTRIES
+	GptShareEntries(gpt);
+#endif
 	return GPT_SUCCESS;
 }
 
@@ -116,12 +132,14 @@ int GptUpdateKernelEntry(GptData *gpt, uint32_t update_type)
 {
 	GptEntry *entries = (GptEntry *)gpt->primary_entries;
 	GptEntry *e = entries + gpt->current_kernel;
+	GptEntry old;
 	int modified = 0;
 
 	if (gpt->current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND)
 		return GPT_ERROR_INVALID_UPDATE_TYPE;
 	if (!IsKernelEntry(e))
 		return GPT_ERROR_INVALID_UPDATE_TYPE;
+	Memcpy(&old, e, sizeof(old));
 
 	switch (update_type) {
 	case GPT_UPDATE_ENTRY_TRY: {
@@ -160,7 +178,8 @@ int GptUpdateKernelEntry(GptData *gpt, uint32_t update_type)
 		return GPT_ERROR_INVALID_UPDATE_TYPE;
 	}
 
-	if (modified) {
+	if (modified &&
+	    GPT_SUCCESS != GptEntryModified(gpt, gpt->current_kernel, &old)) {
 		GptModified(gpt);
 	}
 
@@ -127,54 +127,114 @@ int IsKernelEntry(const GptEntry *e)
 	return !Memcmp(&e->type, &chromeos_kernel, sizeof(Guid));
 }
 
-int CheckEntries(GptEntry *entries, GptHeader *h)
+/* Return non-zero if the n bytes at a and b are equal.  Small enough to be
+ * inlined, unlike Memcmp(). */
+static int BytesEqual(const uint8_t *a, const uint8_t *b, uint32_t n)
 {
-	GptEntry *entry;
-	uint32_t crc32;
+	uint8_t diff = 0;
 	uint32_t i;
 
-	/* Check CRC before examining entries. */
-	crc32 = Crc32((const uint8_t *)entries,
-		      h->size_of_entry * h->number_of_entries);
-	if (crc32 != h->entries_crc32)
-		return GPT_ERROR_CRC_CORRUPTED;
-
-	/* Check all entries. */
-	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
-		GptEntry *e2;
-		uint32_t i2;
-
-		if (IsUnusedEntry(entry))
-			continue;
-
-		/* Entry must be in valid region. */
-		if ((entry->starting_lba < h->first_usable_lba) ||
-		    (entry->ending_lba > h->last_usable_lba) ||
-		    (entry->ending_lba < entry->starting_lba))
-			return GPT_ERROR_OUT_OF_REGION;
-
-		/* Entry must not overlap other entries. */
-		for (i2 = 0, e2 = entries; i2 < h->number_of_entries;
-		     i2++, e2++) {
-			if (i2 == i || IsUnusedEntry(e2))
-				continue;
-
-			if ((entry->starting_lba >= e2->starting_lba) &&
-			    (entry->starting_lba <= e2->ending_lba))
-				return GPT_ERROR_START_LBA_OVERLAP;
-			if ((entry->ending_lba >= e2->starting_lba) &&
-			    (entry->ending_lba <= e2->ending_lba))
-				return GPT_ERROR_END_LBA_OVERLAP;
-
-			/* UniqueGuid field must be unique. */
-			if (0 == Memcmp(&entry->unique, &e2->unique,
-					sizeof(Guid)))
-				return GPT_ERROR_DUP_GUID;
-		}
-	}
+	for (i = 0; i < n; i++)
+		diff |= a[i] ^ b[i];
+	return !diff;
+}
 
-	/* Success */
-	return 0;
+static int TypeIsUnused(const GptEntry *e)
+{
+	static const uint8_t zero[sizeof(Guid)];
+	return BytesEqual((const uint8_t *)&e->type, zero, sizeof(Guid));
+}
+
+/* Crc32ZeroOpInit(op, TOTAL_ENTRIES_SIZE / 4), worked out in advance. */
+const Crc32ZeroOp gpt_entries_quarter_op = {{
+	0x5ad8a92cU, 0xb5b15258U, 0xb013a2f1U, 0xbb5643a3U, 0xaddd8107U,
+	0x80ca044fU, 0xdae50edfU, 0x6ebb1bffU, 0xdd7637feU, 0x619d69bdU,
+	0xc33ad37aU, 0x5d04a0b5U, 0xba09416aU, 0xaf638495U, 0x85b60f6bU,
+	0xd01d1897U, 0x7b4b376fU, 0xf6966edeU, 0x365ddbfdU, 0x6cbbb7faU,
+	0xd9776ff4U, 0x699fd9a9U, 0xd33fb352U, 0x7d0e60e5U, 0xfa1cc1caU,
+	0x2f4885d5U, 0x5e910baaU, 0xbd221754U, 0xa13528e9U, 0x991b5793U,
+	0xe947a967U, 0x09fe548fU,
+}};
+
+/*
+ * Define a CheckEntries() variant for num entries whose CRC is computed by
+ * crc.  With constant arguments the compiler unrolls the scan for used
+ * entries, and the canonical size lets the CRC run in interleaved quarters,
+ * which is the point of specializing.  Used entries are gathered
+ * first so the overlap checks only visit those, but they are still compared
+ * in index order, so errors are reported as before.
+ */
+#define GPT_DEFINE_CHECK_ENTRIES(name, num, crc)			\
+static int name(GptEntry *entries, GptHeader *h)			\
+{									\
+	uint16_t used[MAX_NUMBER_OF_ENTRIES];				\
+	uint32_t count = 0;						\
+	uint32_t i, j;							\
+									\
+	/* Check CRC before examining entries. */			\
+	if ((crc) != h->entries_crc32)					\
+		return GPT_ERROR_CRC_CORRUPTED;				\
+									\
+	for (i = 0; i < (num); i++)					\
+		if (!TypeIsUnused(&entries[i]))				\
+			used[count++] = (uint16_t)i;			\
+									\
+	for (i = 0; i < count; i++) {					\
+		GptEntry *entry = &entries[used[i]];			\
+									\
+		/* Entry must be in valid region. */			\
+		if ((entry->starting_lba < h->first_usable_lba) ||	\
+		    (entry->ending_lba > h->last_usable_lba) ||		\
+		    (entry->ending_lba < entry->starting_lba))		\
+			return GPT_ERROR_OUT_OF_REGION;			\
+									\
+		/* Entry must not overlap other entries. */		\
+		for (j = 0; j < count; j++) {				\
+			GptEntry *e2 = &entries[used[j]];		\
+									\
+			if (j == i)					\
+				continue;				\
+			if ((entry->starting_lba >= e2->starting_lba) &&\
+			    (entry->starting_lba <= e2->ending_lba))	\
+				return GPT_ERROR_START_LBA_OVERLAP;	\
+			if ((entry->ending_lba >= e2->starting_lba) &&	\
+			    (entry->ending_lba <= e2->ending_lba))	\
+				return GPT_ERROR_END_LBA_OVERLAP;	\
+									\
+			/* UniqueGuid field must be unique. */		\
+			if (BytesEqual((const uint8_t *)&entry->unique,	\
+				       (const uint8_t *)&e2->unique,	\
+				       sizeof(Guid)))			\
+				return GPT_ERROR_DUP_GUID;		\
+		}							\
+	}								\
+									\
+	/* Success */							\
+	return 0;							\
+}
+
+/* The only layout CheckHeader() accepts: 128 entries of 128 bytes. */
+GPT_DEFINE_CHECK_ENTRIES(CheckEntriesCanonical,
+			 TOTAL_ENTRIES_SIZE / sizeof(GptEntry),
+			 Crc32Quarters(entries, TOTAL_ENTRIES_SIZE,
+				       &gpt_entries_quarter_op))
+GPT_DEFINE_CHECK_ENTRIES(CheckEntriesGeneric, h->number_of_entries,
+			 Crc32(entries,
+			       h->size_of_entry * h->number_of_entries))
+
+static int IsCanonicalLayout(const GptHeader *h)
+{
+	return h->size_of_entry == sizeof(GptEntry) &&
+	       h->number_of_entries == TOTAL_ENTRIES_SIZE / sizeof(GptEntry);
+}
+
+int CheckEntries(GptEntry *entries, GptHeader *h)
+{
+	if (IsCanonicalLayout(h))
+		return CheckEntriesCanonical(entries, h);
+	if (h->number_of_entries > MAX_NUMBER_OF_ENTRIES)
+		return GPT_ERROR_INVALID_ENTRIES;
+	return CheckEntriesGeneric(entries, h);
 }
 
 int HeaderFieldsSame(GptHeader *h1, GptHeader *h2)
@@ -203,6 +263,37 @@ int HeaderFieldsSame(GptHeader *h1, GptHeader *h2)
 	return 0;
 }
 
+/*
+ * Check both entry arrays against the same header and return the mask of
+ * valid ones.  In the canonical layout a secondary that is a byte for byte
+ * copy of the primary, as it nearly always is, shares its result instead of
+ * paying for a second CRC.
+ */
+static uint32_t CheckBothEntries(GptEntry *entries1, GptEntry *entries2,
+				 GptHeader *h, int canonical)
+{
+	uint32_t valid = 0;
+
+	if (!canonical) {
+		if (0 == CheckEntries(entries1, h))
+			valid |= MASK_PRIMARY;
+		if (0 == CheckEntries(entries2, h))
+			valid |= MASK_SECONDARY;
+		return valid;
+	}
+
+	if (0 == CheckEntriesCanonical(entries1, h))
+		valid |= MASK_PRIMARY;
+	if (entries2 == entries1 ||
+	    0 == Memcmp(entries1, entries2, TOTAL_ENTRIES_SIZE)) {
+		if (valid)
+			valid |= MASK_SECONDARY;
+	} else if (0 == CheckEntriesCanonical(entries2, h)) {
+		valid |= MASK_SECONDARY;
+	}
+	return valid;
+}
+
 int GptSanityCheck(GptData *gpt)
 {
 	int retval;
@@ -214,6 +305,7 @@ int GptSanityCheck(GptData *gpt)
 
 	gpt->valid_headers = 0;
 	gpt->valid_entries = 0;
+	gpt->canonical_layout = 0;
 
 	retval = CheckParameters(gpt);
 	if (retval != GPT_SUCCESS)
@@ -233,6 +325,12 @@ int GptSanityCheck(GptData *gpt)
 	if (!gpt->valid_headers)
 		return GPT_ERROR_INVALID_HEADERS;
 
+	/*
+	 * CheckHeader() only passes the canonical layout, but say so once
+	 * here rather than have every entry lookup read the header again.
+	 */
+	gpt->canonical_layout = IsCanonicalLayout(goodhdr);
+
 	/*
 	 * Check if entries are valid.
 	 *
@@ -240,20 +338,17 @@ int GptSanityCheck(GptData *gpt)
 	 * catch the case where (header1,entries1) and (header2,entries2) are
 	 * both valid, but (entries1 != entries2).
 	 */
-	if (0 == CheckEntries(entries1, goodhdr))
-		gpt->valid_entries |= MASK_PRIMARY;
-	if (0 == CheckEntries(entries2, goodhdr))
-		gpt->valid_entries |= MASK_SECONDARY;
+	gpt->valid_entries = CheckBothEntries(entries1, entries2, goodhdr,
+					      gpt->canonical_layout);
 
 	/*
 	 * If both headers are good but neither entries were good, check the
 	 * entries with the secondary header.
 	 */
 	if (MASK_BOTH == gpt->valid_headers && !gpt->valid_entries) {
-		if (0 == CheckEntries(entries1, header2))
-			gpt->valid_entries |= MASK_PRIMARY;
-		if (0 == CheckEntries(entries2, header2))
-			gpt->valid_entries |= MASK_SECONDARY;
+		gpt->valid_entries = CheckBothEntries(entries1, entries2,
+						      header2,
+						      IsCanonicalLayout(header2));
 		if (gpt->valid_entries) {
 			/*
 			 * Sure enough, header2 had a good CRC for one of the
@@ -261,6 +356,7 @@ int GptSanityCheck(GptData *gpt)
 			 * entries CRC.
 			 */
 			gpt->valid_headers &= ~MASK_PRIMARY;
+			gpt->canonical_layout = IsCanonicalLayout(header2);
 			goodhdr = header2;
 		}
 	}
@@ -332,6 +428,7 @@ static int GptRecomputeSize(GptData *gpt)
 
 	/* Write out secondary no matter what since its location changed. */
 	gpt->modified |= GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2;
+	gpt->modified_entry_sectors = 0;
 	if (was_valid == MASK_PRIMARY)
 		gpt->modified |= GPT_MODIFIED_HEADER1;
 
@@ -376,20 +473,43 @@ void GptRepair(GptData *gpt)
 	gpt->valid_headers = MASK_BOTH;
 
 	/* Repair entries if necessary */
-	entries_size = header1->size_of_entry * header1->number_of_entries;
+	if (gpt->canonical_layout)
+		entries_size = TOTAL_ENTRIES_SIZE;
+	else
+		entries_size = header1->size_of_entry *
+			header1->number_of_entries;
 	if (MASK_PRIMARY == gpt->valid_entries) {
-		/* Primary is good, secondary is bad */
-		Memcpy(entries2, entries1, entries_size);
+		/* Primary is good, secondary is bad (or shares the primary) */
+		if (entries2 != entries1)
+			Memcpy(entries2, entries1, entries_size);
 		gpt->modified |= GPT_MODIFIED_ENTRIES2;
+		gpt->modified_entry_sectors = 0;
 	}
 	else if (MASK_SECONDARY == gpt->valid_entries) {
-		/* Secondary is good, primary is bad */
-		Memcpy(entries1, entries2, entries_size);
+		/* Secondary is good, primary is bad (or shares it) */
+		if (entries1 != entries2)
+			Memcpy(entries1, entries2, entries_size);
 		gpt->modified |= GPT_MODIFIED_ENTRIES1;
+		gpt->modified_entry_sectors = 0;
 	}
 	gpt->valid_entries = MASK_BOTH;
 }
 
+int GptShareEntries(GptData *gpt)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+
+	if (gpt->secondary_entries == gpt->primary_entries)
+		return 1;
+	if (MASK_BOTH != gpt->valid_entries ||
+	    Memcmp(gpt->primary_entries, gpt->secondary_entries,
+		   header->size_of_entry * header->number_of_entries))
+		return 0;
+
+	gpt->secondary_entries = gpt->primary_entries;
+	return 1;
+}
+
 int GetEntryLegacyBootable(const GptEntry *e)
 {
 	return !!(e->attrs.whole & CGPT_ATTRIBUTE_LEGACY_BOOTABLE);
@@ -455,11 +575,18 @@ void GptModified(GptData *gpt) {
 	GptHeader *header = (GptHeader *)gpt->primary_header;
 
 	/* Update the CRCs */
-	header->entries_crc32 = Crc32(gpt->primary_entries,
-				      header->size_of_entry *
-				      header->number_of_entries);
+	gpt->canonical_layout = IsCanonicalLayout(header);
+	if (gpt->canonical_layout)
+		header->entries_crc32 = Crc32Quarters(gpt->primary_entries,
+						      TOTAL_ENTRIES_SIZE,
+						      &gpt_entries_quarter_op);
+	else
+		header->entries_crc32 = Crc32(gpt->primary_entries,
+					      header->size_of_entry *
+					      header->number_of_entries);
 	header->header_crc32 = HeaderCrc(header);
 	gpt->modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1;
+	gpt->modified_entry_sectors = 0;
 
 	/*
 	 * Use the repair function to update the other copy of the GPT.  This
@@ -471,6 +598,49 @@ void GptModified(GptData *gpt) {
 	GptRepair(gpt);
 }
 
+int GptEntryModified(GptData *gpt, uint32_t index, const GptEntry *old)
+{
+	GptHeader *header1 = (GptHeader *)gpt->primary_header;
+	GptHeader *header2 = (GptHeader *)gpt->secondary_header;
+	GptEntry *entry = (GptEntry *)gpt->primary_entries + index;
+	uint8_t delta[sizeof(GptEntry)];
+	const uint8_t *a = (const uint8_t *)old, *b = (const uint8_t *)entry;
+	Crc32ZeroOp op;
+	uint32_t sector, i;
+
+	if (MASK_BOTH != gpt->valid_headers ||
+	    MASK_BOTH != gpt->valid_entries ||
+	    header1->size_of_entry != sizeof(GptEntry) ||
+	    index >= header1->number_of_entries)
+		return GPT_ERROR_INVALID_ENTRIES;
+
+	/*
+	 * Both copies were valid with the same entries CRC, so the entries
+	 * were identical and the CRC can be patched with just the change.
+	 */
+	for (i = 0; i < sizeof(delta); i++)
+		delta[i] = a[i] ^ b[i];
+	Crc32ZeroOpInit(&op, (uint64_t)sizeof(GptEntry) *
+			(header1->number_of_entries - index - 1));
+	header1->entries_crc32 = Crc32Patch(header1->entries_crc32, delta,
+					    sizeof(delta), &op);
+	header1->header_crc32 = HeaderCrc(header1);
+	header2->entries_crc32 = header1->entries_crc32;
+	header2->header_crc32 = HeaderCrc(header2);
+	if (gpt->secondary_entries != gpt->primary_entries)
+		Memcpy((GptEntry *)gpt->secondary_entries + index, entry,
+		       sizeof(GptEntry));
+
+	/* Only narrow the sectors to write if nothing else wrote the entries */
+	sector = index * sizeof(GptEntry) / gpt->sector_bytes;
+	if (!(gpt->modified & (GPT_MODIFIED_ENTRIES1 | GPT_MODIFIED_ENTRIES2)))
+		gpt->modified_entry_sectors = 1U << sector;
+	else if (gpt->modified_entry_sectors)
+		gpt->modified_entry_sectors |= 1U << sector;
+	gpt->modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_HEADER2 |
+		GPT_MODIFIED_ENTRIES1 | GPT_MODIFIED_ENTRIES2;
+	return GPT_SUCCESS;
+}
 
 const char *GptErrorText(int error_code)
 {
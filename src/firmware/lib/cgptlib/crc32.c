@@ -99,13 +99,94 @@ static uint32_t crc32_tab[] = {
 };
 
 
-uint32_t Crc32(const void *buffer, uint32_t len)
+uint32_t Crc32Extend(uint32_t crc, const void *buffer, uint32_t len)
 {
 	uint8_t *byte = (uint8_t *)buffer;
 	uint32_t i;
-	uint32_t value = ~0U;
+	uint32_t value = crc ^ ~0U;
 
 	for (i = 0; i < len; ++i)
 		value = crc32_tab[(value ^ byte[i]) & 0xff] ^ (value >> 8);
 	return value ^ ~0U;
 }
+
+uint32_t Crc32(const void *buffer, uint32_t len)
+{
+	return Crc32Extend(0, buffer, len);
+}
+
+/* Apply the 32x32 GF(2) matrix op, stored as columns, to vec. */
+static uint32_t crc32_apply(const uint32_t *op, uint32_t vec)
+{
+	uint32_t sum = 0;
+
+	for (; vec; vec >>= 1, op++)
+		if (vec & 1)
+			sum ^= *op;
+	return sum;
+}
+
+/* out = a after b */
+static void crc32_compose(uint32_t *out, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t tmp[32];
+	int i;
+
+	for (i = 0; i < 32; i++)
+		tmp[i] = crc32_apply(a, b[i]);
+	for (i = 0; i < 32; i++)
+		out[i] = tmp[i];
+}
+
+void Crc32ZeroOpInit(Crc32ZeroOp *op, uint64_t len)
+{
+	uint32_t base[32];
+	int i;
+
+	/* Start with the identity and the operator for one zero byte. */
+	for (i = 0; i < 32; i++) {
+		op->col[i] = 1U << i;
+		base[i] = crc32_tab[(1U << i) & 0xff] ^ ((1U << i) >> 8);
+	}
+
+	/* Square and multiply up to len bytes. */
+	for (; len; len >>= 1) {
+		if (len & 1)
+			crc32_compose(op->col, base, op->col);
+		if (len > 1)
+			crc32_compose(base, base, base);
+	}
+}
+
+uint32_t Crc32Patch(uint32_t crc, const void *delta, uint32_t len,
+		    const Crc32ZeroOp *op)
+{
+	/* CRC32 without the pre and post inversion is linear, so the change
+	 * in the CRC only depends on the change in the data. */
+	uint32_t raw = Crc32Extend(~0U, delta, len) ^ ~0U;
+
+	return crc ^ crc32_apply(op->col, raw);
+}
+
+uint32_t Crc32Quarters(const void *buffer, uint32_t len, const Crc32ZeroOp *op)
+{
+	const uint8_t *byte = (const uint8_t *)buffer;
+	uint32_t quarter = len / 4;
+	uint32_t v0 = ~0U, v1 = 0, v2 = 0, v3 = 0;
+	uint32_t i;
+
+	/* Four independent chains, so the table lookups overlap. Only the
+	 * first starts from the usual inverted register; the others are raw
+	 * and get shifted past the quarters after them below. */
+	for (i = 0; i < quarter; ++i) {
+		v0 = crc32_tab[(v0 ^ byte[i]) & 0xff] ^ (v0 >> 8);
+		v1 = crc32_tab[(v1 ^ byte[i + quarter]) & 0xff] ^ (v1 >> 8);
+		v2 = crc32_tab[(v2 ^ byte[i + 2 * quarter]) & 0xff] ^ (v2 >> 8);
+		v3 = crc32_tab[(v3 ^ byte[i + 3 * quarter]) & 0xff] ^ (v3 >> 8);
+	}
+
+	v1 ^= crc32_apply(op->col, v0);
+	v2 ^= crc32_apply(op->col, v1);
+	v3 ^= crc32_apply(op->col, v2);
+	return v3 ^ ~0U;
+}
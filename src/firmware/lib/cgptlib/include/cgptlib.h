@@ -39,6 +39,14 @@ enum {
  */
 #define TOTAL_ENTRIES_SIZE 16384
 
+/*
+ * Sectors at each end of the drive covered by the views given to
+ * GptSetView(): the PMBR, primary header and primary entries at the head, the
+ * secondary entries and secondary header at the tail.
+ */
+#define GPT_VIEW_HEAD_SECTORS 34
+#define GPT_VIEW_TAIL_SECTORS 33
+
 /*
  * The 'update_type' of GptUpdateKernelEntry().  We expose TRY and BAD only
  * because those are what verified boot needs.  For more precise control on GPT
@@ -75,6 +83,12 @@ typedef struct {
 	/* Outputs */
 	/* Which inputs have been modified?  GPT_MODIFIED_* */
 	uint8_t modified;
+	/*
+	 * Which sectors of the modified entries actually changed, one bit per
+	 * sector from the start of the entries, the same in both copies.  Zero
+	 * means any of them may have.
+	 */
+	uint32_t modified_entry_sectors;
 	/*
 	 * The current chromeos kernel index in partition table.  -1 means not
 	 * found on drive. Note that GPT partition numbers are traditionally
@@ -85,8 +99,28 @@ typedef struct {
 	/* Internal variables */
 	uint32_t valid_headers, valid_entries;
 	int current_priority;
+	/*
+	 * Non-zero if the valid header describes the canonical 128 entries of
+	 * 128 bytes, so entries can be found without looking at it.  Set by
+	 * GptSanityCheck() and GptModified().
+	 */
+	uint8_t canonical_layout;
 } GptData;
 
+/**
+ * Points the GPT data structure into views of the drive the caller already has
+ * in memory, such as a DMA buffer or a mapped flash window, instead of
+ * separately allocated copies.
+ *
+ * 'head' holds the first GPT_VIEW_HEAD_SECTORS sectors of the drive and 'tail'
+ * the last GPT_VIEW_TAIL_SECTORS; each must be sector_bytes aligned data of
+ * exactly that layout.  Nothing is copied, so repairs and updates are made in
+ * place and the modified field afterwards says which parts of the views need
+ * writing back.  Call GptInit() next, as for any other GptData.
+ */
+void GptSetView(GptData *gpt, uint8_t *head, uint8_t *tail,
+		uint32_t sector_bytes, uint64_t drive_sectors);
+
 /**
  * Initializes the GPT data structure's internal state.
  *
@@ -102,6 +136,11 @@ typedef struct {
  * On return the modified field may be set, if the GPT data has been modified
  * and should be written to disk.
  *
+ * If built with GPT_SHARE_ENTRIES, secondary_entries is pointed at
+ * primary_entries when the two are identical, see GptShareEntries(), and the
+ * caller may release the memory it gave for the secondary entries.  Write the
+ * secondary entries from gpt->secondary_entries, not from that memory.
+ *
  * Returns GPT_SUCCESS if successful, non-zero if error:
  *   GPT_ERROR_INVALID_HEADERS, both partition table headers are invalid, enters
  *                              recovery mode,
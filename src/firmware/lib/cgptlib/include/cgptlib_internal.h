@@ -8,6 +8,7 @@
 
 #include "sysincludes.h"
 #include "cgptlib.h"
+#include "crc32.h"
 #include "gpt.h"
 
 /*
@@ -102,6 +103,12 @@ int CheckHeader(GptHeader *h, int is_secondary, uint64_t drive_sectors);
  */
 uint32_t HeaderCrc(GptHeader *h);
 
+/**
+ * Operator advancing a CRC32 over a quarter of the entries, for checking
+ * them with Crc32Quarters().
+ */
+extern const Crc32ZeroOp gpt_entries_quarter_op;
+
 /**
  * Check entries.
  *
@@ -136,12 +143,33 @@ int GptSanityCheck(GptData *gpt);
  */
 void GptRepair(GptData *gpt);
 
+/**
+ * If both sets of entries are valid and bit-identical, point
+ * secondary_entries at primary_entries so only one copy has to stay in
+ * memory.  Everything in cgptlib changes the primary entries and copies them
+ * to the secondary, so once shared the copy is only made when the secondary
+ * entries are written out.  Returns 1 if the entries are now shared.
+ */
+int GptShareEntries(GptData *gpt);
+
 /**
  * Called when the primary entries are modified and the CRCs need to be
  * recalculated and propagated to the secondary entries
  */
 void GptModified(GptData *gpt);
 
+/**
+ * Called instead of GptModified() when only the primary entry at 'index' has
+ * changed, with 'old' a copy of it from before the change.  Patches the same
+ * entry into the secondary entries, updates both entries CRCs from the change
+ * alone and marks just that entry's sector modified.
+ *
+ * Returns GPT_SUCCESS, or GPT_ERROR_INVALID_ENTRIES without changing anything
+ * if the two copies weren't both valid and in sync before, in which case the
+ * caller should fall back to GptModified().
+ */
+int GptEntryModified(GptData *gpt, uint32_t index, const GptEntry *old);
+
 /* Getters and setters for partition attribute fields. */
 
 int GetEntryLegacyBootable(const GptEntry *e);
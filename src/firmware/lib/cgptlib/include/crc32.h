@@ -9,4 +9,38 @@
 
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/*
+ * Continue a CRC32 previously returned by Crc32() or Crc32Extend() over
+ * another buffer, so large regions can be checksummed in pieces.
+ * Crc32Extend(0, buf, len) == Crc32(buf, len).
+ */
+uint32_t Crc32Extend(uint32_t crc, const void *buffer, uint32_t len);
+
+/*
+ * Linear operator that advances a CRC32 over a run of zero bytes. Used with
+ * Crc32Patch() to update a CRC after a small change without rereading the
+ * whole buffer.
+ */
+typedef struct Crc32ZeroOp {
+	uint32_t col[32];
+} Crc32ZeroOp;
+
+/* Initialize op to advance over len zero bytes. */
+void Crc32ZeroOpInit(Crc32ZeroOp *op, uint64_t len);
+
+/*
+ * Return the CRC32 of a buffer whose old CRC32 was crc, after len bytes of it
+ * were xored with delta. op must have been initialized with the number of
+ * bytes following the changed ones.
+ */
+uint32_t Crc32Patch(uint32_t crc, const void *delta, uint32_t len,
+		    const Crc32ZeroOp *op);
+
+/*
+ * Return Crc32(buffer, len), computed as four interleaved runs over the
+ * quarters of the buffer, which is several times faster than one run. len
+ * must be a multiple of four and op initialized for len / 4 bytes.
+ */
+uint32_t Crc32Quarters(const void *buffer, uint32_t len, const Crc32ZeroOp *op);
+
 #endif  /* VBOOT_REFERENCE_GPT_CRC32_H_ */
@@ -12,6 +12,7 @@ enum {
   CGPT_OK = 0,
   CGPT_FAILED,
   CGPT_NOOP,
+  CGPT_CONFLICT,              /* the table changed under us, try again */
 };
 
 typedef struct CgptCreateParams {
@@ -19,6 +20,7 @@ typedef struct CgptCreateParams {
   int zap;
   int create;
   uint64_t min_size;
+  int discard;
 } CgptCreateParams;
 
 typedef struct CgptAddParams {
@@ -43,8 +45,35 @@ typedef struct CgptAddParams {
   int set_tries;
   int set_priority;
   int set_raw;
+  int discard;
+  int wipe;
 } CgptAddParams;
 
+enum {
+  CGPT_FORMAT_TEXT = 0,
+  CGPT_FORMAT_JSON,
+  CGPT_FORMAT_NDJSON,
+};
+
+/* Partition fields that "cgpt show --fields" can select. */
+enum {
+  CGPT_FIELD_NUMBER = 0,
+  CGPT_FIELD_START,
+  CGPT_FIELD_SIZE,
+  CGPT_FIELD_LABEL,
+  CGPT_FIELD_TYPE,
+  CGPT_FIELD_TYPE_NAME,
+  CGPT_FIELD_GUID,
+  CGPT_FIELD_ATTRS,
+  CGPT_FIELD_PRIORITY,
+  CGPT_FIELD_TRIES,
+  CGPT_FIELD_SUCCESSFUL,
+  CGPT_FIELD_LEGACY_BOOT,
+  CGPT_NUM_FIELDS,
+};
+
+#define CGPT_MAX_SHOW_FIELDS 32
+
 typedef struct CgptShowParams {
   char *drive_name;
   int numeric;
@@ -53,11 +82,20 @@ typedef struct CgptShowParams {
   uint32_t partition;
   int single_item;
   int debug;
+  int fingerprint;
+  int format;
+  uint8_t fields[CGPT_MAX_SHOW_FIELDS];
+  int num_fields;
   int num_partitions;
 } CgptShowParams;
 
 typedef struct CgptRepairParams {
-  char *drive_name;
+  char **drives;              /* repaired in parallel if more than one */
+  uint32_t num_drives;
+  int all;                    /* every whole disk with a GPT */
+  uint32_t jobs;              /* 0 for one per CPU */
+  int dry_run;
+  int discover;               /* look for a backup header not at the end */
   int verbose;
 } CgptRepairParams;
 
@@ -105,6 +143,102 @@ typedef struct CgptFindParams {
   int match_partnum;           /* 1-based; 0 means no match */
 } CgptFindParams;
 
+typedef struct CgptMoveParams {
+  char *drive_name;
+  uint32_t partition;
+  uint64_t begin;
+  int set_begin;
+  char *checkpoint;
+  int verbose;
+} CgptMoveParams;
+
+typedef struct CgptCloneParams {
+  char *drive_name;
+  uint32_t src_partition;
+  uint32_t dst_partition;
+  int successful;
+  int tries;
+  int priority;
+  uint64_t raw_value;
+  int set_successful;
+  int set_tries;
+  int set_priority;
+  int set_raw;
+  int verbose;
+} CgptCloneParams;
+
+typedef struct CgptAssemblePart {
+  uint32_t partition;
+  uint64_t begin;
+  uint64_t size;              /* 0 to fit the payload */
+  Guid type_guid;
+  char *label;
+  char *payload;              /* NULL for none */
+} CgptAssemblePart;
+
+typedef struct CgptAssembleParams {
+  char *output;               /* NULL or "-" for stdout */
+  uint64_t size;
+  CgptAssemblePart *parts;
+  uint32_t num_parts;
+  int verbose;
+} CgptAssembleParams;
+
+typedef struct CgptStampParams {
+  char *template_name;
+  char **outputs;
+  uint32_t num_outputs;
+  uint32_t jobs;              /* 0 for one per CPU */
+  int verbose;
+} CgptStampParams;
+
+typedef struct CgptDumpParams {
+  char *drive_name;
+  int json;
+} CgptDumpParams;
+
+typedef struct CgptApplyParams {
+  char *drive_name;
+  char *manifest;             /* NULL or "-" for stdin */
+  int dry_run;
+  int verbose;
+} CgptApplyParams;
+
+typedef struct CgptBackupParams {
+  char *drive_name;
+  char *file;                 /* NULL or "-" for stdout or stdin */
+} CgptBackupParams;
+
+typedef struct CgptSyncParams {
+  char *golden_name;
+  char **drives;
+  uint32_t num_drives;
+  uint32_t jobs;              /* 0 for one per CPU */
+  int dry_run;
+  int verbose;
+} CgptSyncParams;
+
+typedef struct CgptAuditParams {
+  char **paths;               /* images, drives and directories of images */
+  uint32_t num_paths;
+  uint32_t jobs;              /* 0 for one per CPU */
+  uint32_t alignment;         /* in sectors, 0 for the default */
+} CgptAuditParams;
+
+typedef struct CgptRescueParams {
+  char *drive_name;
+  uint32_t jobs;              /* 0 for one per CPU */
+  uint32_t alignment;         /* in sectors, 0 for the default */
+  int quiet;                  /* no progress on stderr */
+  int verbose;
+} CgptRescueParams;
+
+typedef struct CgptWatchParams {
+  char **drives;              /* NULL to watch every whole disk */
+  uint32_t num_drives;
+  uint32_t count;             /* exit after this many events, 0 for never */
+} CgptWatchParams;
+
 typedef struct CgptLegacyParams {
   char *drive_name;
   int efipart;
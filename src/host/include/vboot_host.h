@@ -31,19 +31,46 @@ int CgptResize(CgptResizeParams *params);
 int CgptPrioritize(CgptPrioritizeParams *params);
 void CgptFind(CgptFindParams *params);
 int CgptLegacy(CgptLegacyParams *params);
+int CgptMove(CgptMoveParams *params);
+int CgptClone(CgptCloneParams *params);
+int CgptAssemble(CgptAssembleParams *params);
+int CgptStamp(CgptStampParams *params);
+int CgptDump(CgptDumpParams *params);
+int CgptApply(CgptApplyParams *params);
+int CgptBackup(CgptBackupParams *params);
+int CgptRestore(CgptBackupParams *params);
+int CgptSync(CgptSyncParams *params);
+int CgptWatch(CgptWatchParams *params);
+int CgptAudit(CgptAuditParams *params);
+int CgptRescue(CgptRescueParams *params);
 
 /* GUID conversion functions. Accepted format:
  *
  *   "C12A7328-F81F-11D2-BA4B-00A0C93EC93B"
  *
- * At least GUID_STRLEN bytes should be reserved in 'str' (included the tailing
- * '\0').
+ * StrToGuid() takes either case, optionally wrapped in braces, and rejects
+ * anything else. At least GUID_STRLEN bytes should be reserved in 'str'
+ * (included the tailing '\0'), or GUID_BRACED_STRLEN with GUID_BRACES.
  */
 #define GUID_STRLEN 37
+#define GUID_BRACED_STRLEN 39
 #define GuidToStr GuidToStrUpper
 int StrToGuid(const char *str, Guid *guid);
 void GuidToStrUpper(const Guid *guid, char *str, unsigned int buflen);
 void GuidToStrLower(const Guid *guid, char *str, unsigned int buflen);
+
+/* Flags for GuidFormat() and GuidFormatArray(). */
+#define GUID_LOWER  0x1
+#define GUID_BRACES 0x2
+
+/* Format 'guid' into 'str' and return the length of the string. */
+int GuidFormat(const Guid *guid, char *str, int flags);
+
+/* Format 'count' GUIDs found 'stride' bytes apart, such as the unique GUIDs
+ * of an entries array, into consecutive strings of GUID_STRLEN (or
+ * GUID_BRACED_STRLEN) bytes each. */
+void GuidFormatArray(const void *first, size_t count, size_t stride,
+                     char *str, int flags);
 int GuidEqual(const Guid *guid1, const Guid *guid2);
 int GuidIsZero(const Guid *guid);
 
@@ -0,0 +1,104 @@
+// Copyright (c) 2026 CoreOS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Time GptSanityCheck() over tables with a varying number of partitions.
+// Not run by "make check"; build it with "make tests/cgptlib_bench".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+
+#define SECTOR_BYTES 512
+#define DRIVE_SECTORS (1ULL << 24)
+#define FIRST_USABLE_LBA (2 + GPT_ENTRIES_SECTORS)
+#define NUM_ENTRIES (TOTAL_ENTRIES_SIZE / sizeof(GptEntry))
+
+static uint8_t header1[SECTOR_BYTES], header2[SECTOR_BYTES];
+static uint8_t entries1[TOTAL_ENTRIES_SIZE], entries2[TOTAL_ENTRIES_SIZE];
+
+static void BuildGpt(GptData *gpt, uint32_t used) {
+  GptHeader *h1 = (GptHeader *)header1, *h2 = (GptHeader *)header2;
+  GptEntry *e = (GptEntry *)entries1;
+  uint32_t i;
+
+  memset(header1, 0, sizeof(header1));
+  memset(entries1, 0, sizeof(entries1));
+  memcpy(h1->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+  h1->revision = GPT_HEADER_REVISION;
+  h1->size = sizeof(GptHeader);
+  h1->my_lba = 1;
+  h1->alternate_lba = DRIVE_SECTORS - 1;
+  h1->first_usable_lba = FIRST_USABLE_LBA;
+  h1->last_usable_lba = DRIVE_SECTORS - 1 - GPT_ENTRIES_SECTORS - 1;
+  h1->entries_lba = 2;
+  h1->number_of_entries = NUM_ENTRIES;
+  h1->size_of_entry = sizeof(GptEntry);
+
+  // Partitions of 1000 sectors, one after another, every other slot used so
+  // the scan for used entries cannot stop early.
+  for (i = 0; i < used; i++) {
+    GptEntry *entry = &e[(i * 2) % NUM_ENTRIES + (i * 2) / NUM_ENTRIES];
+
+    memset(&entry->type, 0xa5, sizeof(Guid));
+    memcpy(&entry->unique, &i, sizeof(i));
+    entry->unique.u.raw[GUID_SIZE - 1] = 0x5a;
+    entry->starting_lba = FIRST_USABLE_LBA + i * 1000ULL;
+    entry->ending_lba = entry->starting_lba + 999;
+  }
+  h1->entries_crc32 = Crc32(entries1, TOTAL_ENTRIES_SIZE);
+  h1->header_crc32 = HeaderCrc(h1);
+
+  memcpy(header2, header1, sizeof(header2));
+  memcpy(entries2, entries1, sizeof(entries2));
+  h2->my_lba = DRIVE_SECTORS - 1;
+  h2->alternate_lba = 1;
+  h2->entries_lba = DRIVE_SECTORS - 1 - GPT_ENTRIES_SECTORS;
+  h2->header_crc32 = HeaderCrc(h2);
+
+  memset(gpt, 0, sizeof(*gpt));
+  gpt->sector_bytes = SECTOR_BYTES;
+  gpt->drive_sectors = DRIVE_SECTORS;
+  gpt->primary_header = header1;
+  gpt->secondary_header = header2;
+  gpt->primary_entries = entries1;
+  gpt->secondary_entries = entries2;
+}
+
+static double Now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  static const uint32_t used_counts[] = { 0, 4, 16, 64, 128 };
+  uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+  GptData gpt;
+  size_t k;
+
+  printf("%8s  %12s\n", "entries", "usec/check");
+  for (k = 0; k < sizeof(used_counts) / sizeof(used_counts[0]); k++) {
+    double start;
+    uint32_t i;
+
+    BuildGpt(&gpt, used_counts[k]);
+    if (GptSanityCheck(&gpt) != GPT_SUCCESS ||
+        gpt.valid_headers != MASK_BOTH || gpt.valid_entries != MASK_BOTH) {
+      fprintf(stderr, "table with %u entries is not valid\n", used_counts[k]);
+      return 1;
+    }
+    start = Now();
+    for (i = 0; i < iterations; i++)
+      GptSanityCheck(&gpt);
+    printf("%8u  %12.2f\n", used_counts[k],
+           (Now() - start) * 1e6 / iterations);
+  }
+  return 0;
+}
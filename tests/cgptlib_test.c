@@ -10,7 +10,9 @@
 #include "crc32.h"
 #include "crc32_test.h"
 #include "gpt.h"
+#include "guid_test.h"
 #include "test_common.h"
+#include "utf_test.h"
 #include "utility.h"
 
 /*
@@ -669,6 +671,50 @@ static int EntriesCrcTest(void)
 	return TEST_OK;
 }
 
+/*
+ * Test the entry checks for layouts other than 128 entries of 128 bytes, and
+ * that a secondary differing from the primary is still checked on its own.
+ */
+static int EntriesLayoutTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptHeader *h1 = (GptHeader *)gpt->primary_header;
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+
+	/* Only the first number_of_entries entries count. */
+	BuildTestGptData(gpt);
+	h1->number_of_entries = 64;
+	Memset(&e1[100].type, 0xff, sizeof(e1[100].type));
+	e1[100].starting_lba = 0;
+	h1->entries_crc32 = Crc32(e1, 64 * sizeof(GptEntry));
+	EXPECT(0 == CheckEntries(e1, h1));
+	e1[1].starting_lba = e1[0].ending_lba;
+	h1->entries_crc32 = Crc32(e1, 64 * sizeof(GptEntry));
+	EXPECT(GPT_ERROR_END_LBA_OVERLAP == CheckEntries(e1, h1));
+	h1->number_of_entries = MAX_NUMBER_OF_ENTRIES + 1;
+	EXPECT(GPT_ERROR_INVALID_ENTRIES == CheckEntries(e1, h1));
+
+	/* A corrupt unused entry in the secondary only invalidates it. */
+	gpt = GetEmptyGptData();
+	BuildTestGptData(gpt);
+	gpt->secondary_entries[TOTAL_ENTRIES_SIZE - 1] ^= 0x5a;
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	EXPECT(MASK_BOTH == gpt->valid_headers);
+	EXPECT(MASK_PRIMARY == gpt->valid_entries);
+
+	/* Identical copies are both valid, or both not. */
+	BuildTestGptData(gpt);
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	EXPECT(MASK_BOTH == gpt->valid_entries);
+	e1[0].ending_lba = e1[1].starting_lba;
+	Memcpy(gpt->secondary_entries, e1, TOTAL_ENTRIES_SIZE);
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_INVALID_ENTRIES == GptSanityCheck(gpt));
+	EXPECT(0 == gpt->valid_entries);
+
+	return TEST_OK;
+}
+
 /*
  * Test if partition geometry is checked.
  * All active (non-zero PartitionTypeGUID) partition entries should have:
@@ -800,6 +846,7 @@ static int SanityCheckTest(void)
 	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
 	EXPECT(MASK_BOTH == gpt->valid_headers);
 	EXPECT(MASK_BOTH == gpt->valid_entries);
+	EXPECT(gpt->canonical_layout);
 	/* Repair doesn't damage it */
 	GptRepair(gpt);
 	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
@@ -819,6 +866,7 @@ static int SanityCheckTest(void)
 	EXPECT(GPT_ERROR_INVALID_HEADERS == GptSanityCheck(gpt));
 	EXPECT(0 == gpt->valid_headers);
 	EXPECT(0 == gpt->valid_entries);
+	EXPECT(0 == gpt->canonical_layout);
 	/* Repair can't fix completely busted headers */
 	GptRepair(gpt);
 	EXPECT(GPT_ERROR_INVALID_HEADERS == GptSanityCheck(gpt));
@@ -1285,6 +1333,7 @@ static int GptUpdateTest(void)
 	FillEntry(e + KERNEL_X, 1, 2, 0, 2);
 	RefreshCrc32(gpt);
 	GptInit(gpt);
+	e2 = (GptEntry *)(gpt->secondary_entries);  /* may be shared now */
 	gpt->modified = 0;  /* Nothing modified yet */
 
 	/* Successful kernel */
@@ -1359,6 +1408,78 @@ static int GptUpdateTest(void)
 	return TEST_OK;
 }
 
+/*
+ * Patching a single entry gives the same table as GptModified(), but only
+ * marks the sector holding that entry.
+ */
+static int EntryModifiedTest(void)
+{
+	static uint8_t full_header[DEFAULT_SECTOR_SIZE];
+	static uint8_t full_entries[PARTITION_ENTRIES_SIZE];
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+	GptEntry *e2 = (GptEntry *)(gpt->secondary_entries);
+	GptEntry old;
+	uint32_t index[] = { KERNEL_B, 5, 127 };
+	int i;
+
+	BuildTestGptData(gpt);
+	GptInit(gpt);
+	e2 = (GptEntry *)(gpt->secondary_entries);  /* may be shared now */
+	for (i = 0; i < ARRAY_SIZE(index); i++) {
+		Memcpy(&old, e1 + index[i], sizeof(old));
+		SetEntryTries(e1 + index[i], 5);
+		SetEntryPriority(e1 + index[i], 3);
+
+		/* The full update, for comparison */
+		Memcpy(full_entries, e1, PARTITION_ENTRIES_SIZE);
+		Memcpy(full_header, gpt->primary_header, DEFAULT_SECTOR_SIZE);
+		((GptHeader *)full_header)->entries_crc32 =
+			Crc32(full_entries, PARTITION_ENTRIES_SIZE);
+		((GptHeader *)full_header)->header_crc32 =
+			HeaderCrc((GptHeader *)full_header);
+
+		gpt->modified = 0;
+		EXPECT(GPT_SUCCESS == GptEntryModified(gpt, index[i], &old));
+		EXPECT(0x0F == gpt->modified);
+		EXPECT((1U << (index[i] / 4)) == gpt->modified_entry_sectors);
+		EXPECT(!Memcmp(gpt->primary_header, full_header,
+			       DEFAULT_SECTOR_SIZE));
+		EXPECT(!Memcmp(e2, full_entries, PARTITION_ENTRIES_SIZE));
+		EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+		EXPECT(MASK_BOTH == gpt->valid_headers);
+		EXPECT(MASK_BOTH == gpt->valid_entries);
+	}
+
+	/* Sectors add up, unless the whole array was already modified */
+	Memcpy(&old, e1 + 10, sizeof(old));
+	SetEntryTries(e1 + 10, 1);
+	EXPECT(GPT_SUCCESS == GptEntryModified(gpt, 10, &old));
+	EXPECT(((1U << 31) | (1U << 2)) == gpt->modified_entry_sectors);
+	GptModified(gpt);
+	EXPECT(0 == gpt->modified_entry_sectors);
+	Memcpy(&old, e1 + 10, sizeof(old));
+	SetEntryTries(e1 + 10, 2);
+	EXPECT(GPT_SUCCESS == GptEntryModified(gpt, 10, &old));
+	EXPECT(0 == gpt->modified_entry_sectors);
+	EXPECT(GPT_ERROR_INVALID_ENTRIES == GptEntryModified(gpt, 128, &old));
+
+	/* Copies that aren't known to match are left for GptModified() */
+	gpt = GetEmptyGptData();
+	BuildTestGptData(gpt);
+	e2 = (GptEntry *)(gpt->secondary_entries);
+	e2[KERNEL_A].ending_lba--;
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	Memcpy(&old, e1 + KERNEL_A, sizeof(old));
+	SetEntryTries(e1 + KERNEL_A, 1);
+	gpt->modified = 0;
+	EXPECT(GPT_ERROR_INVALID_ENTRIES == GptEntryModified(gpt, KERNEL_A,
+							     &old));
+	EXPECT(0 == gpt->modified);
+
+	return TEST_OK;
+}
+
 /*
  * Give an invalid kernel type, and expect GptUpdateKernelEntry() returns
  * GPT_ERROR_INVALID_UPDATE_TYPE.
@@ -1454,6 +1575,111 @@ static int GetKernelGuidTest(void)
 	return TEST_OK;
 }
 
+/*
+ * Run over a view of the whole drive, and expect repairs and updates to land
+ * in the view itself at the right offsets.
+ */
+static int GptViewTest(void)
+{
+	static uint8_t disk[DEFAULT_DRIVE_SECTORS * DEFAULT_SECTOR_SIZE];
+	uint8_t *tail = disk + (DEFAULT_DRIVE_SECTORS - GPT_VIEW_TAIL_SECTORS) *
+		DEFAULT_SECTOR_SIZE;
+	GptData gpt;
+	GptEntry *e1, *e2;
+	uint64_t start, size;
+
+	Memset(disk, 0, sizeof(disk));
+	Memset(&gpt, 0, sizeof(gpt));
+	GptSetView(&gpt, disk, tail, DEFAULT_SECTOR_SIZE,
+		   DEFAULT_DRIVE_SECTORS);
+	EXPECT(gpt.primary_header == disk + DEFAULT_SECTOR_SIZE);
+	EXPECT(gpt.primary_entries == disk + 2 * DEFAULT_SECTOR_SIZE);
+	EXPECT(gpt.secondary_entries == disk + 434 * DEFAULT_SECTOR_SIZE);
+	EXPECT(gpt.secondary_header == disk + 466 * DEFAULT_SECTOR_SIZE);
+	EXPECT(gpt.primary_entries + PARTITION_ENTRIES_SIZE ==
+	       disk + GPT_VIEW_HEAD_SECTORS * DEFAULT_SECTOR_SIZE);
+
+	BuildTestGptData(&gpt);
+	e1 = (GptEntry *)(disk + 2 * DEFAULT_SECTOR_SIZE);
+	e2 = (GptEntry *)(disk + 434 * DEFAULT_SECTOR_SIZE);
+	FillEntry(e1 + KERNEL_A, 1, 2, 0, 0);
+	FillEntry(e1 + KERNEL_B, 1, 1, 0, 2);
+	Memcpy(e2, e1, PARTITION_ENTRIES_SIZE);
+	RefreshCrc32(&gpt);
+
+	/* A broken primary header is repaired in place from the secondary */
+	disk[DEFAULT_SECTOR_SIZE]++;
+	EXPECT(GPT_SUCCESS == GptInit(&gpt));
+	EXPECT(0 == CheckHeader((GptHeader *)(disk + DEFAULT_SECTOR_SIZE), 0,
+				DEFAULT_DRIVE_SECTORS));
+	EXPECT(gpt.modified & GPT_MODIFIED_HEADER1);
+
+	/* Updates change both copies of the entries in the view */
+	gpt.modified = 0;
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(&gpt, &start, &size));
+	EXPECT(KERNEL_B == gpt.current_kernel);
+	EXPECT(GPT_SUCCESS == GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_TRY));
+	EXPECT(1 == GetEntryTries(e1 + KERNEL_B));
+	e2 = (GptEntry *)gpt.secondary_entries;  /* the view, unless shared */
+	EXPECT(1 == GetEntryTries(e2 + KERNEL_B));
+	EXPECT(0x0F == gpt.modified);
+	EXPECT(GPT_SUCCESS == GptSanityCheck(&gpt));
+	EXPECT(MASK_BOTH == gpt.valid_headers);
+	EXPECT(MASK_BOTH == gpt.valid_entries);
+
+	return TEST_OK;
+}
+
+/*
+ * Identical entries are shared, and updates through the primary still reach
+ * the secondary.  Entries that differ are not shared.
+ */
+static int ShareEntriesTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+	GptEntry *e2 = (GptEntry *)(gpt->secondary_entries);
+
+	BuildTestGptData(gpt);
+	FillEntry(e1 + KERNEL_A, 1, 2, 0, 3);
+	Memcpy(e2, e1, PARTITION_ENTRIES_SIZE);
+	RefreshCrc32(gpt);
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	EXPECT(1 == GptShareEntries(gpt));
+	EXPECT(gpt->secondary_entries == gpt->primary_entries);
+	EXPECT(1 == GptShareEntries(gpt));
+
+	gpt->current_kernel = KERNEL_A;
+	gpt->modified = 0;
+	EXPECT(GPT_SUCCESS == GptUpdateKernelEntry(gpt, GPT_UPDATE_ENTRY_TRY));
+	EXPECT(0x0F == gpt->modified);
+	e2 = (GptEntry *)(gpt->secondary_entries);
+	EXPECT(2 == GetEntryTries(e2 + KERNEL_A));
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	EXPECT(MASK_BOTH == gpt->valid_headers);
+	EXPECT(MASK_BOTH == gpt->valid_entries);
+
+	/* Repairing either copy from the other leaves shared entries alone */
+	gpt->modified = 0;
+	gpt->valid_entries = MASK_SECONDARY;
+	GptRepair(gpt);
+	EXPECT(GPT_MODIFIED_ENTRIES1 == gpt->modified);
+	EXPECT(MASK_BOTH == gpt->valid_entries);
+	EXPECT(2 == GetEntryTries(e2 + KERNEL_A));
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+
+	gpt = GetEmptyGptData();
+	BuildTestGptData(gpt);
+	e2 = (GptEntry *)(gpt->secondary_entries);
+	e2[KERNEL_B].ending_lba--;
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	EXPECT(MASK_PRIMARY == gpt->valid_entries);
+	EXPECT(0 == GptShareEntries(gpt));
+	EXPECT(gpt->secondary_entries == (uint8_t *)e2);
+
+	return TEST_OK;
+}
+
 /* Test getting GPT error text strings */
 static int ErrorTextTest(void)
 {
@@ -1495,6 +1721,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(MyLbaTest), },
 		{ TEST_CASE(FirstUsableLbaAndLastUsableLbaTest), },
 		{ TEST_CASE(EntriesCrcTest), },
+		{ TEST_CASE(EntriesLayoutTest), },
 		{ TEST_CASE(ValidEntryTest), },
 		{ TEST_CASE(OverlappedPartitionTest), },
 		{ TEST_CASE(SanityCheckTest), },
@@ -1505,9 +1732,19 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(GetNextPrioTest), },
 		{ TEST_CASE(GetNextTriesTest), },
 		{ TEST_CASE(GptUpdateTest), },
+		{ TEST_CASE(EntryModifiedTest), },
 		{ TEST_CASE(UpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
+		{ TEST_CASE(GptViewTest), },
+		{ TEST_CASE(ShareEntriesTest), },
 		{ TEST_CASE(TestCrc32TestVectors), },
+		{ TEST_CASE(TestCrc32Patch), },
+		{ TEST_CASE(TestCrc32Quarters), },
+		{ TEST_CASE(TestGuidRoundTrip), },
+		{ TEST_CASE(TestGuidFormatArray), },
+		{ TEST_CASE(TestGuidRejects), },
+		{ TEST_CASE(TestUTF16ToUTF8), },
+		{ TEST_CASE(TestUTF8ToUTF16), },
 		{ TEST_CASE(GetKernelGuidTest), },
 		{ TEST_CASE(ErrorTextTest), },
 		{ TEST_CASE(DriveResizeTest), },
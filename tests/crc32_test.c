@@ -4,6 +4,7 @@
  */
 
 #include "crc32_test.h"
+#include "cgptlib_internal.h"
 #include "cgptlib_test.h"
 #include "crc32.h"
 #include "test_common.h"
@@ -43,6 +44,56 @@ int TestCrc32TestVectors() {
 
     crc32 = Crc32(cases[i].vector, cases[i].len);
     EXPECT(crc32 == cases[i].crc32);
+
+    /* Checksumming in two pieces must give the same answer. */
+    crc32 = Crc32Extend(Crc32(cases[i].vector, cases[i].len / 2),
+                        cases[i].vector + cases[i].len / 2,
+                        cases[i].len - cases[i].len / 2);
+    EXPECT(crc32 == cases[i].crc32);
+  }
+  return TEST_OK;
+}
+
+int TestCrc32Patch() {
+  uint8_t buf[1000], delta[16];
+  Crc32ZeroOp op;
+  uint32_t crc;
+  int i, offset;
+
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = i * 7;
+  for (i = 0; i < sizeof(delta); i++)
+    delta[i] = 0x5a ^ i;
+
+  /* Patching anywhere, up to the very end, matches a recomputation. */
+  for (offset = 0; offset <= sizeof(buf) - sizeof(delta); offset += 123) {
+    crc = Crc32(buf, sizeof(buf));
+    Crc32ZeroOpInit(&op, sizeof(buf) - offset - sizeof(delta));
+    for (i = 0; i < sizeof(delta); i++)
+      buf[offset + i] ^= delta[i];
+    EXPECT(Crc32Patch(crc, delta, sizeof(delta), &op) ==
+           Crc32(buf, sizeof(buf)));
   }
   return TEST_OK;
 }
+
+int TestCrc32Quarters() {
+  static uint8_t buf[TOTAL_ENTRIES_SIZE];
+  Crc32ZeroOp op;
+  int i, len;
+
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = i * 13 + (i >> 8);
+
+  for (len = 0; len <= 1000; len += 100) {
+    Crc32ZeroOpInit(&op, len / 4);
+    EXPECT(Crc32Quarters(buf, len, &op) == Crc32(buf, len));
+  }
+
+  /* The operator cgptlib uses for the entries is the right one. */
+  Crc32ZeroOpInit(&op, sizeof(buf) / 4);
+  EXPECT(0 == Memcmp(&op, &gpt_entries_quarter_op, sizeof(op)));
+  EXPECT(Crc32Quarters(buf, sizeof(buf), &gpt_entries_quarter_op) ==
+         Crc32(buf, sizeof(buf)));
+  return TEST_OK;
+}
@@ -0,0 +1,130 @@
+/* Copyright (c) 2026 CoreOS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "guid_test.h"
+#include "cgptlib_test.h"
+#include "endian.h"
+#include "gpt.h"
+#include "test_common.h"
+#include "vboot_host.h"
+
+/* The formatting StrToGuid() and GuidToStr() used to be built on. */
+static void ReferenceFormat(const Guid *guid, char *str, int lower) {
+  snprintf(str, GUID_STRLEN,
+           lower ? "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x" :
+                   "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+           le32toh(guid->u.Uuid.time_low),
+           le16toh(guid->u.Uuid.time_mid),
+           le16toh(guid->u.Uuid.time_high_and_version),
+           guid->u.Uuid.clock_seq_high_and_reserved,
+           guid->u.Uuid.clock_seq_low,
+           guid->u.Uuid.node[0], guid->u.Uuid.node[1],
+           guid->u.Uuid.node[2], guid->u.Uuid.node[3],
+           guid->u.Uuid.node[4], guid->u.Uuid.node[5]);
+}
+
+/* Every value of every byte, in both cases, with and without braces. */
+int TestGuidRoundTrip() {
+  Guid guid, parsed;
+  char str[GUID_BRACED_STRLEN], ref[GUID_STRLEN];
+  int i, value, flags;
+
+  for (i = 0; i < GUID_SIZE; i++) {
+    for (value = 0; value < 256; value++) {
+      memset(&guid, 0xa5, sizeof(guid));
+      guid.u.raw[i] = value;
+      for (flags = 0; flags < 4; flags++) {
+        int braces = !!(flags & GUID_BRACES);
+
+        EXPECT(GuidFormat(&guid, str, flags) ==
+               GUID_STRLEN - 1 + 2 * braces);
+        EXPECT(strlen(str) == GUID_STRLEN - 1 + 2 * braces);
+        ReferenceFormat(&guid, ref, flags & GUID_LOWER);
+        EXPECT(!strncmp(str + braces, ref, GUID_STRLEN - 1));
+        if (braces)
+          EXPECT(str[0] == '{' && str[GUID_BRACED_STRLEN - 2] == '}');
+
+        memset(&parsed, 0, sizeof(parsed));
+        EXPECT(StrToGuid(str, &parsed) == CGPT_OK);
+        EXPECT(!memcmp(&parsed, &guid, sizeof(guid)));
+      }
+    }
+  }
+
+  /* The fixed-size wrappers match too. */
+  GuidToStrUpper(&guid, str, GUID_STRLEN);
+  ReferenceFormat(&guid, ref, 0);
+  EXPECT(!strcmp(str, ref));
+  GuidToStrLower(&guid, str, GUID_STRLEN);
+  ReferenceFormat(&guid, ref, 1);
+  EXPECT(!strcmp(str, ref));
+  return TEST_OK;
+}
+
+int TestGuidFormatArray() {
+  GptEntry entries[4];
+  char strs[5][GUID_BRACED_STRLEN], str[GUID_BRACED_STRLEN];
+  int i, flags;
+
+  memset(entries, 0, sizeof(entries));
+  for (i = 0; i < ARRAY_SIZE(entries); i++) {
+    memset(&entries[i].type, i, sizeof(Guid));
+    memset(&entries[i].unique, 0x10 * i + 7, sizeof(Guid));
+  }
+
+  for (flags = 0; flags < 4; flags++) {
+    size_t width = (flags & GUID_BRACES) ? GUID_BRACED_STRLEN : GUID_STRLEN;
+    char *out = &strs[0][0];
+
+    memset(strs, 'x', sizeof(strs));
+    GuidFormatArray(&entries[0].unique, ARRAY_SIZE(entries),
+                    sizeof(entries[0]), out, flags);
+    for (i = 0; i < ARRAY_SIZE(entries); i++) {
+      GuidFormat(&entries[i].unique, str, flags);
+      EXPECT(!strcmp(out + i * width, str));
+    }
+    /* Nothing is written past the last string. */
+    EXPECT(out[ARRAY_SIZE(entries) * width] == 'x');
+  }
+  return TEST_OK;
+}
+
+int TestGuidRejects() {
+  static const char *bad[] = {
+    "",
+    "C12A7328-F81F-11D2-BA4B-00A0C93EC93",
+    "C12A7328-F81F-11D2-BA4B-00A0C93EC93BB",
+    "C12A7328-F81F-11D2-BA4B-00A0C93EC93B ",
+    " C12A7328-F81F-11D2-BA4B-00A0C93EC93B",
+    "C12A7328F81F-11D2-BA4B-00A0C93EC93BB",
+    "C12A7328-F81F-11D2-BA4B+00A0C93EC93B",
+    "C12A732G-F81F-11D2-BA4B-00A0C93EC93B",
+    "C12A7328-F81F-11D2-BA4B-00A0C93EC93g",
+    "0x2A7328-F81F-11D2-BA4B-00A0C93EC93B",
+    "C12A7328-+81F-11D2-BA4B-00A0C93EC93B",
+    "{C12A7328-F81F-11D2-BA4B-00A0C93EC93B",
+    "C12A7328-F81F-11D2-BA4B-00A0C93EC93B}",
+    "(C12A7328-F81F-11D2-BA4B-00A0C93EC93B)",
+    "{{C12A7328-F81F-11D2-BA4B-00A0C93EC93B}}",
+  };
+  Guid guid, untouched;
+  int i;
+
+  memset(&untouched, 0x5a, sizeof(untouched));
+  for (i = 0; i < ARRAY_SIZE(bad); i++) {
+    memcpy(&guid, &untouched, sizeof(guid));
+    EXPECT(StrToGuid(bad[i], &guid) == CGPT_FAILED);
+    EXPECT(!memcmp(&guid, &untouched, sizeof(guid)));
+  }
+
+  EXPECT(StrToGuid("c12a7328-f81f-11d2-ba4b-00a0c93ec93b", &guid) == CGPT_OK);
+  EXPECT(StrToGuid("{C12a7328-F81f-11D2-bA4B-00A0C93EC93B}", &untouched) ==
+         CGPT_OK);
+  EXPECT(!memcmp(&guid, &untouched, sizeof(guid)));
+  return TEST_OK;
+}
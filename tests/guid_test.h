@@ -0,0 +1,12 @@
+/* Copyright (c) 2026 CoreOS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+#ifndef VBOOT_REFERENCE_GUID_TEST_H_
+#define VBOOT_REFERENCE_GUID_TEST_H_
+
+int TestGuidRoundTrip();
+int TestGuidFormatArray();
+int TestGuidRejects();
+
+#endif  /* VBOOT_REFERENCE_GUID_TEST_H_ */
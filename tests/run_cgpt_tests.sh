@@ -266,6 +266,643 @@ X=$($CGPT show -t -i 1 ${DEV} | tr 'A-Z' 'a-z')
 [ "$X" = "$DATA_GUID" ] || error
 
 
+echo "Test the cgpt move command..."
+MOVE_DEV=move_dev.bin
+rm -f ${MOVE_DEV} ${MOVE_DEV}.data ${MOVE_DEV}.ckpt
+$CGPT create -c -s 20000 ${MOVE_DEV} || error
+$CGPT add -i 1 -b 2048 -s 10000 -t data -l MOVEME ${MOVE_DEV} || error
+dd if=/dev/urandom of=${MOVE_DEV}.data bs=512 count=10000 status=none || error
+dd if=${MOVE_DEV}.data of=${MOVE_DEV} bs=512 seek=2048 conv=notrunc \
+  status=none || error
+check_moved() {
+  [ $($CGPT show -i 1 -b ${MOVE_DEV}) -eq $1 ] || error 1 "start is not $1"
+  [ $($CGPT show -i 1 -s ${MOVE_DEV}) -eq 10000 ] || error 1
+  cmp ${MOVE_DEV}.data <(dd if=${MOVE_DEV} bs=512 skip=$1 count=10000 \
+    status=none) || error 1 "data differs after moving to $1"
+}
+# overlapping, towards the end of the disk
+$CGPT move -i 1 -b 3000 ${MOVE_DEV} || error
+check_moved 3000
+# overlapping, towards the start of the disk
+$CGPT move -i 1 -b 2500 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} || error
+check_moved 2500
+[ -e ${MOVE_DEV}.ckpt ] && error "checkpoint was not removed"
+# a move by one sector that dies halfway overwrote most of what it read,
+# resuming it must not read any of that again
+{ ( ulimit -f 3000
+    $CGPT move -i 1 -b 2499 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} ); } 2>/dev/null &&
+  error 1 "move was not interrupted"
+[ $($CGPT show -i 1 -b ${MOVE_DEV}) -eq 2500 ] || error 1 "table was changed"
+[ -s ${MOVE_DEV}.ckpt ] || error 1 "no checkpoint was written"
+$CGPT move -i 1 -b 2499 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} || error
+check_moved 2499
+# disjoint ranges
+$CGPT move -i 1 -b 9000 ${MOVE_DEV} || error
+check_moved 9000
+$CGPT move -i 1 -b 34 ${MOVE_DEV} || error
+check_moved 34
+# out of range moves leave everything alone
+$CGPT move -i 1 -b 19000 ${MOVE_DEV} 2>/dev/null && error
+check_moved 34
+# the checkpoint of an interrupted move is refused for any other move
+$CGPT move -i 1 -b 2000 ${MOVE_DEV} || error
+{ ( ulimit -f 1500
+    $CGPT move -i 1 -b 1000 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} ); } 2>/dev/null &&
+  error 1 "move was not interrupted"
+[ -s ${MOVE_DEV}.ckpt ] || error 1 "no checkpoint was written"
+$CGPT move -i 1 -b 1500 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} 2>/dev/null &&
+  error 1 "checkpoint of another move was used"
+[ $($CGPT show -i 1 -b ${MOVE_DEV}) -eq 2000 ] || error 1 "table was changed"
+$CGPT move -i 1 -b 1000 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} || error
+check_moved 1000
+# and so is one that can't be read
+echo garbage > ${MOVE_DEV}.ckpt
+$CGPT move -i 1 -b 100 -C ${MOVE_DEV}.ckpt ${MOVE_DEV} 2>/dev/null && error
+check_moved 1000
+rm -f ${MOVE_DEV} ${MOVE_DEV}.data ${MOVE_DEV}.ckpt
+
+
+echo "Test the cgpt clone command..."
+CLONE_DEV=clone_dev.bin
+rm -f ${CLONE_DEV} ${CLONE_DEV}.data
+$CGPT create -c -s 20000 ${CLONE_DEV} || error
+$CGPT add -i 1 -b 2048 -s 4096 -t coreos-usr -l USR-A -S 1 -P 1 \
+  ${CLONE_DEV} || error
+$CGPT add -i 2 -b 8192 -s 5000 -t data -l USR-B ${CLONE_DEV} || error
+$CGPT add -i 3 -b 14000 -s 100 -t data ${CLONE_DEV} || error
+# the source has a hole in the middle, the destination is full of junk
+dd if=/dev/urandom of=${CLONE_DEV}.data bs=512 count=4096 status=none || error
+dd if=/dev/zero of=${CLONE_DEV}.data bs=512 seek=1024 count=2048 \
+  conv=notrunc status=none || error
+dd if=${CLONE_DEV}.data of=${CLONE_DEV} bs=512 seek=2048 count=1024 \
+  conv=notrunc status=none || error
+dd if=${CLONE_DEV}.data of=${CLONE_DEV} bs=512 skip=3072 seek=5120 \
+  count=1024 conv=notrunc status=none || error
+dd if=/dev/urandom of=${CLONE_DEV} bs=512 seek=8192 count=5000 \
+  conv=notrunc status=none || error
+$CGPT clone -i 1 -i 2 -S 0 -T 1 -P 2 ${CLONE_DEV} || error
+cmp ${CLONE_DEV}.data <(dd if=${CLONE_DEV} bs=512 skip=8192 count=4096 \
+  status=none) || error 1 "cloned data differs"
+[ "$($CGPT show -i 2 -t ${CLONE_DEV})" == "$($CGPT show -i 1 -t ${CLONE_DEV})" \
+  ] || error 1 "type was not cloned"
+[ "$($CGPT show -i 2 -l ${CLONE_DEV})" == "USR-B" ] || error 1
+[ $($CGPT show -i 2 -S ${CLONE_DEV}) -eq 0 ] || error 1
+[ $($CGPT show -i 2 -T ${CLONE_DEV}) -eq 1 ] || error 1
+[ $($CGPT show -i 2 -P ${CLONE_DEV}) -eq 2 ] || error 1
+# without attribute options the source's are copied
+$CGPT add -i 2 -S 1 -P 3 ${CLONE_DEV} || error
+$CGPT clone -i 1 -i 2 ${CLONE_DEV} || error
+[ $($CGPT show -i 2 -P ${CLONE_DEV}) -eq 1 ] || error 1
+[ $($CGPT show -i 2 -S ${CLONE_DEV}) -eq 1 ] || error 1
+# the destination has to be big enough
+$CGPT clone -i 2 -i 1 ${CLONE_DEV} 2>/dev/null && error
+$CGPT clone -i 1 -i 3 ${CLONE_DEV} 2>/dev/null && error
+$CGPT clone -i 1 ${CLONE_DEV} 2>/dev/null && error
+rm -f ${CLONE_DEV} ${CLONE_DEV}.data
+
+
+echo "Test discarding freed space..."
+DISCARD_DEV=discard_dev.bin
+rm -f ${DISCARD_DEV}
+$CGPT create -c -s 10000 ${DISCARD_DEV} || error
+$CGPT add -i 1 -b 2048 -s 2048 -t data ${DISCARD_DEV} || error
+$CGPT add -i 2 -b 4096 -s 2048 -t data ${DISCARD_DEV} || error
+$CGPT add -i 3 -b 6144 -s 2048 -t data ${DISCARD_DEV} || error
+dd if=/dev/urandom of=${DISCARD_DEV} bs=512 seek=2048 count=6144 \
+  conv=notrunc status=none || error
+is_zero() {
+  cmp -s <(dd if=${DISCARD_DEV} bs=512 skip=$1 count=$2 status=none) \
+    <(head -c $(($2 * 512)) /dev/zero)
+}
+# without --discard the data stays put
+$CGPT add -i 3 -s 1024 ${DISCARD_DEV} || error
+is_zero 7168 1024 && error 1 "data discarded without --discard"
+$CGPT add -i 3 -s 2048 ${DISCARD_DEV} || error
+# shrinking discards the tail only
+$CGPT add -i 3 -s 1024 --discard ${DISCARD_DEV} || error
+is_zero 7168 1024 || error 1 "shrunk space was not discarded"
+is_zero 6144 1024 && error 1
+# deleting discards the whole partition but nothing else
+$CGPT add -i 2 -t unused -D ${DISCARD_DEV} || error
+is_zero 4096 2048 || error 1 "deleted partition was not discarded"
+is_zero 2048 2048 && error 1
+is_zero 6144 1024 && error 1
+# moving a partition over its old location keeps the overlap
+$CGPT add -i 1 -b 3072 -s 2048 --discard ${DISCARD_DEV} || error
+is_zero 2048 1024 || error 1 "vacated space was not discarded"
+is_zero 3072 1024 && error 1
+# zapping the table discards every partition
+$CGPT create -z --discard ${DISCARD_DEV} || error
+is_zero 2048 6144 || error 1 "zapped partitions were not discarded"
+rm -f ${DISCARD_DEV}
+
+
+echo "Test wiping signatures from new partitions..."
+WIPE_DEV=wipe_dev.bin
+rm -f ${WIPE_DEV}
+$CGPT create -c -s 20000 ${WIPE_DEV} || error
+dd if=/dev/urandom of=${WIPE_DEV} bs=512 seek=2048 count=10000 \
+  conv=notrunc status=none || error
+# a swap signature in the first sector of the old space
+printf SWAPSPACE2 | dd of=${WIPE_DEV} bs=1 seek=$((2048 * 512 + 4086)) \
+  conv=notrunc status=none || error
+cp ${WIPE_DEV} ${WIPE_DEV}.orig
+$CGPT add -i 1 -b 2048 -s 10000 -t data --wipe ${WIPE_DEV} || error
+# both ends are cleared, the rest is left alone
+cmp -s <(dd if=${WIPE_DEV} bs=512 skip=2048 count=2048 status=none) \
+  <(head -c $((2048 * 512)) /dev/zero) || error 1 "start was not wiped"
+cmp -s <(dd if=${WIPE_DEV} bs=512 skip=10000 count=2048 status=none) \
+  <(head -c $((2048 * 512)) /dev/zero) || error 1 "end was not wiped"
+cmp -s <(dd if=${WIPE_DEV} bs=512 skip=4096 count=5904 status=none) \
+  <(dd if=${WIPE_DEV}.orig bs=512 skip=4096 count=5904 status=none) \
+  || error 1 "wiped too much"
+# changing an existing partition leaves what it holds alone
+dd if=/dev/urandom of=${WIPE_DEV} bs=512 seek=2048 count=12000 \
+  conv=notrunc status=none || error
+cp ${WIPE_DEV} ${WIPE_DEV}.orig
+$CGPT add -i 1 -P 3 -W ${WIPE_DEV} || error
+cmp -s <(dd if=${WIPE_DEV} bs=512 skip=2048 count=10000 status=none) \
+  <(dd if=${WIPE_DEV}.orig bs=512 skip=2048 count=10000 status=none) \
+  || error 1 "existing partition wiped"
+# growing it only wipes the sectors it didn't cover before
+$CGPT add -i 1 -s 12000 -W ${WIPE_DEV} || error
+cmp -s <(dd if=${WIPE_DEV} bs=512 skip=2048 count=10000 status=none) \
+  <(dd if=${WIPE_DEV}.orig bs=512 skip=2048 count=10000 status=none) \
+  || error 1 "old sectors of a grown partition wiped"
+cmp -s <(dd if=${WIPE_DEV} bs=512 skip=12048 count=2000 status=none) \
+  <(head -c $((2000 * 512)) /dev/zero) || error 1 "new sectors not wiped"
+rm -f ${WIPE_DEV} ${WIPE_DEV}.orig
+
+
+echo "Test the cgpt assemble command..."
+ASM=assemble
+rm -f ${ASM}.*
+dd if=/dev/urandom of=${ASM}.usr bs=512 count=3000 status=none || error
+# a sparse payload with data at both ends
+dd if=/dev/urandom of=${ASM}.oem bs=512 count=10 status=none || error
+dd if=/dev/urandom of=${ASM}.oem bs=512 seek=4000 count=10 status=none || error
+$CGPT assemble -s 20000 -o ${ASM}.img \
+  -p 3:2048:4096:coreos-usr:${ASM}.usr:USR-A \
+  -p 1:8192::data:${ASM}.oem:OEM \
+  -p 2:16384:1024:coreos-rootfs::ROOT || error
+[ $(stat --format=%s ${ASM}.img) -eq $((20000 * 512)) ] || error
+$CGPT show -q ${ASM}.img >/dev/null || error
+[ $($CGPT show -i 3 -b ${ASM}.img) -eq 2048 ] || error 1
+[ $($CGPT show -i 3 -s ${ASM}.img) -eq 4096 ] || error 1
+[ "$($CGPT show -i 3 -l ${ASM}.img)" == "USR-A" ] || error 1
+[ $($CGPT show -i 1 -s ${ASM}.img) -eq 4010 ] || error 1
+[ "$($CGPT show -i 2 -l ${ASM}.img)" == "ROOT" ] || error 1
+cmp ${ASM}.usr <(dd if=${ASM}.img bs=512 skip=2048 count=3000 \
+  status=none) || error 1 "usr payload differs"
+cmp ${ASM}.oem <(dd if=${ASM}.img bs=512 skip=8192 count=4010 \
+  status=none) || error 1 "oem payload differs"
+# streaming through a pipe gives the same image, except for GUIDs
+$CGPT assemble -s 20000 \
+  -p 3:2048:4096:coreos-usr:${ASM}.usr:USR-A \
+  -p 1:8192::data:${ASM}.oem:OEM \
+  -p 2:16384:1024:coreos-rootfs::ROOT | cat > ${ASM}.pipe || error
+[ $(stat --format=%s ${ASM}.pipe) -eq $((20000 * 512)) ] || error
+cmp <(dd if=${ASM}.img bs=512 skip=34 count=19933 status=none) \
+  <(dd if=${ASM}.pipe bs=512 skip=34 count=19933 status=none) \
+  || error 1 "streamed image differs"
+[ $($CGPT show -i 1 -s ${ASM}.pipe) -eq 4010 ] || error 1
+# payloads have to fit and partitions can't overlap
+$CGPT assemble -s 20000 -o ${ASM}.bad \
+  -p 1:2048:100:data:${ASM}.usr 2>/dev/null && error
+$CGPT assemble -s 20000 -o ${ASM}.bad \
+  -p 1:2048:100:data -p 2:2100:100:data 2>/dev/null && error
+rm -f ${ASM}.*
+
+
+echo "Test the cgpt stamp command..."
+STAMP=stamp
+rm -f ${STAMP}.*
+$CGPT create -c -s 20000 ${STAMP}.tmpl || error
+$CGPT add -i 1 -b 2048 -s 1000 -t efi -l EFI-SYSTEM ${STAMP}.tmpl || error
+$CGPT add -i 3 -b 4096 -s 4096 -t coreos-usr -l USR-A -P 1 ${STAMP}.tmpl \
+  || error
+$CGPT add -i 9 -b 9000 -s 100 -t data -l ROOT ${STAMP}.tmpl || error
+$CGPT boot -i 3 ${STAMP}.tmpl >/dev/null || error
+$CGPT stamp -j 3 ${STAMP}.tmpl ${STAMP}.{1,2,3,4,5} || error
+for i in 1 2 3 4 5; do
+  img=${STAMP}.$i
+  [ $(stat --format=%s $img) -eq $((20000 * 512)) ] || error
+  [ -z "$($CGPT show $img 2>&1 >/dev/null)" ] || error 1 "$img is invalid"
+  for part in 1 3 9; do
+    for field in b s t l A; do
+      [ "$($CGPT show -i $part -$field $img)" == \
+        "$($CGPT show -i $part -$field ${STAMP}.tmpl)" ] || error 1
+    done
+    $CGPT show -i $part -u $img
+  done
+  [ "$($CGPT boot $img)" == "$($CGPT show -i 3 -u $img)" ] || error 1
+  $CGPT show -v $img | grep "Disk UUID" | sed 's/^.*Disk UUID: //'
+done > ${STAMP}.guids
+$CGPT show -i 1 -u ${STAMP}.tmpl >> ${STAMP}.guids
+[ $(sort -u ${STAMP}.guids | wc -l) -eq 21 ] || error 1 "GUIDs were reused"
+$CGPT stamp ${STAMP}.nonexistent ${STAMP}.6 2>/dev/null && error
+# the table layout is for 512-byte sectors, 4K drives are left alone
+if [ "$(id -u)" -ne 0 ]; then
+  echo "Skipping cgpt stamp tests w/ 4K block devices (requires root)"
+else
+  truncate -s $((20000 * 512)) ${STAMP}.4k || error
+  loop=$(losetup -f --show --sector-size 4096 ${STAMP}.4k) || error
+  trap "losetup -d ${loop}" EXIT
+  $CGPT stamp ${STAMP}.tmpl ${loop} 2>/dev/null && error
+  cmp ${STAMP}.4k <(head -c $((20000 * 512)) /dev/zero) \
+    || error 1 "4K drive was written"
+  $CGPT stamp ${loop} ${STAMP}.6 2>/dev/null && error
+  losetup -d ${loop}
+  trap - EXIT
+fi
+rm -f ${STAMP}.*
+
+
+echo "Test the cgpt dump and apply commands..."
+APPLY=apply
+rm -f ${APPLY}.*
+$CGPT create -c -s 20000 ${APPLY}.a || error
+$CGPT add -i 1 -b 2048 -s 1000 -t efi -l 'EFI "SYSTEM"' ${APPLY}.a || error
+$CGPT add -i 3 -b 4096 -s 4096 -t coreos-usr -l USR-A -P 1 ${APPLY}.a || error
+$CGPT dump ${APPLY}.a > ${APPLY}.manifest || error
+$CGPT dump -j ${APPLY}.a | grep -q '"label":"EFI \\"SYSTEM\\""' || error
+# A table that already matches is not written at all.
+cp ${APPLY}.a ${APPLY}.orig
+touch -d @0 ${APPLY}.a
+$CGPT apply -f ${APPLY}.manifest ${APPLY}.a || error
+[ $(stat --format=%Y ${APPLY}.a) -eq 0 ] || error 1 "unchanged table written"
+# Drifted tables are brought back in one call, and stay put after that.
+$CGPT create -c -s 20000 ${APPLY}.b || error
+$CGPT add -i 2 -b 9000 -s 100 -t data ${APPLY}.b || error
+$CGPT add -i 3 -b 4096 -s 2048 -t data ${APPLY}.b || error
+$CGPT apply -n -f ${APPLY}.manifest ${APPLY}.b | grep -q "would be updated" \
+  || error
+$CGPT apply -f ${APPLY}.manifest ${APPLY}.b || error
+[ "$($CGPT dump ${APPLY}.b)" == "$(cat ${APPLY}.manifest)" ] || error 1
+$CGPT apply < ${APPLY}.manifest ${APPLY}.b || error
+cmp ${APPLY}.a ${APPLY}.orig || error
+# New partitions without a GUID get a random one; bad layouts are refused.
+echo "2: start=10000 size=100 type=data label=NEW" >> ${APPLY}.manifest
+$CGPT apply -f ${APPLY}.manifest ${APPLY}.a || error
+[ "$($CGPT show -i 2 -l ${APPLY}.a)" == "NEW" ] || error
+[ -n "$($CGPT show -i 2 -u ${APPLY}.a)" ] || error
+echo "4: start=4100 size=100 type=data" >> ${APPLY}.manifest
+$CGPT apply -f ${APPLY}.manifest ${APPLY}.a 2>/dev/null && error
+echo "5: start=20 type=data" > ${APPLY}.bad
+$CGPT apply -f ${APPLY}.bad ${APPLY}.a 2>/dev/null && error
+[ -z "$($CGPT show ${APPLY}.a 2>&1 >/dev/null)" ] || error
+rm -f ${APPLY}.*
+
+
+echo "Test the cgpt backup and restore commands..."
+BACKUP=backup
+rm -f ${BACKUP}.*
+$CGPT create -c -s 20000 ${BACKUP}.dev || error
+$CGPT add -i 1 -b 2048 -s 1000 -t efi -l EFI-SYSTEM ${BACKUP}.dev || error
+$CGPT add -i 3 -b 4096 -s 4096 -t coreos-usr -l USR-A -P 1 ${BACKUP}.dev \
+  || error
+$CGPT boot -p -i 3 ${BACKUP}.dev >/dev/null || error
+$CGPT backup -f ${BACKUP}.bak ${BACKUP}.dev || error
+$CGPT backup ${BACKUP}.dev | cmp ${BACKUP}.bak || error
+# The header is little endian: version 1, same entries, 512-byte sectors,
+# 32 entry sectors and 20000 sectors.
+[ "$(od -An -tx1 -j8 -N24 ${BACKUP}.bak | tr -d ' \n')" == \
+  "01000000010000000002000020000000204e000000000000" ] || error
+cp ${BACKUP}.dev ${BACKUP}.orig
+# Wreck both tables and the PMBR, then bring them all back.
+dd if=/dev/zero of=${BACKUP}.dev bs=512 count=34 conv=notrunc status=none
+dd if=/dev/zero of=${BACKUP}.dev bs=512 seek=19967 count=33 conv=notrunc \
+  status=none
+$CGPT show ${BACKUP}.dev >/dev/null 2>&1 && error
+$CGPT restore -f ${BACKUP}.bak ${BACKUP}.dev || error
+cmp ${BACKUP}.dev ${BACKUP}.orig || error
+$CGPT add -i 2 -b 9000 -s 100 -t data ${BACKUP}.dev || error
+$CGPT restore < ${BACKUP}.bak ${BACKUP}.dev || error
+cmp ${BACKUP}.dev ${BACKUP}.orig || error
+# Damaged backups and backups of other drives are refused.
+cp ${BACKUP}.bak ${BACKUP}.bad
+printf 'X' | dd of=${BACKUP}.bad bs=1 seek=1000 conv=notrunc status=none
+$CGPT restore -f ${BACKUP}.bad ${BACKUP}.dev 2>/dev/null && error
+head -c 4000 ${BACKUP}.bak > ${BACKUP}.bad
+$CGPT restore -f ${BACKUP}.bad ${BACKUP}.dev 2>/dev/null && error
+$CGPT create -c -s 30000 ${BACKUP}.other || error
+$CGPT restore -f ${BACKUP}.bak ${BACKUP}.other 2>/dev/null && error
+cmp ${BACKUP}.dev ${BACKUP}.orig || error
+rm -f ${BACKUP}.*
+
+
+echo "Test the cgpt sync command..."
+SYNC=sync
+rm -f ${SYNC}.*
+for img in golden 1 2 3; do
+  $CGPT create -c -s $((20000 + ${#img} * 1000)) ${SYNC}.$img || error
+  $CGPT add -i 1 -b 2048 -s 1000 -t efi -l EFI-SYSTEM ${SYNC}.$img || error
+  $CGPT add -i 3 -b 4096 -s 4096 -t coreos-usr -l USR-A ${SYNC}.$img || error
+done
+# The golden table gains a partition and new attributes, the targets drift.
+$CGPT add -i 2 -b 9000 -s 100 -t data -l NEW ${SYNC}.golden || error
+$CGPT add -i 3 -P 2 -B 1 ${SYNC}.golden || error
+$CGPT add -i 1 -l OLD ${SYNC}.2 || error
+$CGPT add -i 4 -b 10000 -s 100 -t data ${SYNC}.3 || error
+USR_GUID=$($CGPT show -i 3 -u ${SYNC}.1)
+DISK_GUID=$($CGPT show -v ${SYNC}.1 | grep "Disk UUID")
+$CGPT sync -n --from ${SYNC}.golden ${SYNC}.1 | grep -q "sectors differ" \
+  || error
+$CGPT sync -j 2 --from ${SYNC}.golden ${SYNC}.{1,2,3} || error
+for img in 1 2 3; do
+  [ -z "$($CGPT show ${SYNC}.$img 2>&1 >/dev/null)" ] || error 1
+  for part in 1 2 3 4; do
+    for field in b s t l A; do
+      [ "$($CGPT show -i $part -$field ${SYNC}.$img)" == \
+        "$($CGPT show -i $part -$field ${SYNC}.golden)" ] || error 1
+    done
+  done
+  cmp -s --bytes=512 ${SYNC}.$img ${SYNC}.golden || error 1 "PMBR differs"
+done
+[ "$($CGPT show -i 3 -u ${SYNC}.1)" == "$USR_GUID" ] || error
+[ "$($CGPT show -v ${SYNC}.1 | grep "Disk UUID")" == "$DISK_GUID" ] || error
+# Drives that already match are not written.
+touch -d @0 ${SYNC}.{1,2,3}
+$CGPT sync -v -f ${SYNC}.golden ${SYNC}.{1,2,3} | grep -c "already in sync" \
+  | grep -q 3 || error
+[ $(stat --format=%Y ${SYNC}.1 ${SYNC}.2 ${SYNC}.3 | sort -u) -eq 0 ] || error
+$CGPT create -c -s 5000 ${SYNC}.small || error
+$CGPT sync -f ${SYNC}.golden ${SYNC}.small 2>/dev/null && error
+rm -f ${SYNC}.*
+
+
+echo "Test the table fingerprint..."
+FP_DEV=fingerprint.dev
+rm -f ${FP_DEV}
+$CGPT create -c -s 20000 ${FP_DEV} || error
+$CGPT add -i 1 -b 2048 -s 1000 -t efi -l EFI-SYSTEM ${FP_DEV} || error
+FP1=$($CGPT show --fingerprint ${FP_DEV}) || error
+[ "$($CGPT show --fingerprint ${FP_DEV})" == "$FP1" ] || error
+$CGPT add -i 1 -l ESP ${FP_DEV} || error
+FP2=$($CGPT show --fingerprint ${FP_DEV})
+[ "$FP2" != "$FP1" ] || error 1 "label change not detected"
+$CGPT add -i 1 -l EFI-SYSTEM ${FP_DEV} || error
+[ "$($CGPT show --fingerprint ${FP_DEV})" == "$FP1" ] || error
+$CGPT boot -i 1 ${FP_DEV} >/dev/null || error
+FP3=$($CGPT show --fingerprint ${FP_DEV})
+[ "$FP3" != "$FP1" ] || error 1 "boot partition change not detected"
+dd if=/dev/zero of=${FP_DEV} bs=512 seek=19999 count=1 conv=notrunc status=none
+[ "$($CGPT show --fingerprint ${FP_DEV})" != "$FP3" ] || error 1
+$CGPT repair ${FP_DEV} >/dev/null || error
+[ "$($CGPT show --fingerprint ${FP_DEV})" == "$FP3" ] || error
+$CGPT show --fingerprint --format=json ${FP_DEV} &>/dev/null && error
+$CGPT show --fingerprint --fields=label ${FP_DEV} &>/dev/null && error
+# the same table has the same fingerprint on any host
+rm -f ${FP_DEV}
+$CGPT create -c -s 20000 ${FP_DEV} || error
+printf '%s\n' "disk-guid: 01234567-89AB-CDEF-0123-456789ABCDEF" \
+  "1: start=2048 size=1000 type=C12A7328-F81F-11D2-BA4B-00A0C93EC93B \
+guid=11111111-2222-3333-4444-555555555555 attrs=0x0 label=\"EFI-SYSTEM\"" \
+  > ${FP_DEV}.manifest
+$CGPT apply -f ${FP_DEV}.manifest ${FP_DEV} || error
+[ "$($CGPT show --fingerprint ${FP_DEV})" == "e4f391e757193eb9" ] || error 1
+rm -f ${FP_DEV} ${FP_DEV}.manifest
+
+
+echo "Test the JSON output of cgpt show..."
+JSON_DEV=json.dev
+rm -f ${JSON_DEV}
+$CGPT create -c -s 20000 ${JSON_DEV} || error
+$CGPT add -i 1 -b 2048 -s 1000 -t efi -l 'EFI "SYSTEM"' ${JSON_DEV} || error
+$CGPT add -i 3 -b 4096 -s 4096 -t coreos-usr -l USR-A -P 2 ${JSON_DEV} \
+  || error
+$CGPT show --format=json ${JSON_DEV} > ${JSON_DEV}.json || error
+[ $(wc -l < ${JSON_DEV}.json) -eq 1 ] || error
+grep -q '"label":"EFI \\"SYSTEM\\""' ${JSON_DEV}.json || error
+grep -q '"number":3,"start":4096,"size":4096,"label":"USR-A"' \
+  ${JSON_DEV}.json || error
+grep -q '"priority":2,' ${JSON_DEV}.json || error
+grep -q "\"guid\":\"$($CGPT show -i 3 -u ${JSON_DEV})\"" ${JSON_DEV}.json \
+  || error
+$CGPT show --format=ndjson ${JSON_DEV} > ${JSON_DEV}.json || error
+[ $(wc -l < ${JSON_DEV}.json) -eq 2 ] || error
+[ $(grep -c '^{"drive":"json.dev","disk_uuid":' ${JSON_DEV}.json) -eq 2 ] \
+  || error
+[ "$($CGPT show --format=text ${JSON_DEV})" == "$($CGPT show ${JSON_DEV})" ] \
+  || error
+$CGPT show --format=xml ${JSON_DEV} >/dev/null 2>&1 && error
+$CGPT show --format=json -i 1 -b ${JSON_DEV} >/dev/null 2>&1 && error
+
+echo "Test selecting fields with cgpt show..."
+USR_GUID=$($CGPT show -i 3 -u ${JSON_DEV})
+[ "$($CGPT show --fields=number,start,size,priority,uuid ${JSON_DEV})" == \
+  "$(printf '1\t2048\t1000\t0\t%s\n3\t4096\t4096\t2\t%s' \
+     $($CGPT show -i 1 -u ${JSON_DEV}) $USR_GUID)" ] || error
+[ "$($CGPT show -i 1 --fields=label,legacy_boot ${JSON_DEV})" == \
+  "$(printf 'EFI "SYSTEM"\t0')" ] || error
+[ "$($CGPT show -i 3 --fields=label,guid --format=json ${JSON_DEV})" == \
+  "[{\"label\":\"USR-A\",\"guid\":\"$USR_GUID\"}]" ] || error
+[ "$($CGPT show --fields=number --format=ndjson ${JSON_DEV})" == \
+  "$(printf '{"number":1}\n{"number":3}')" ] || error
+$CGPT show --fields=number,bogus ${JSON_DEV} 2>&1 >/dev/null \
+  | grep -q 'unknown field in --fields: "bogus"' || error
+[ "$($CGPT show --fields=label --fields=number ${JSON_DEV})" == \
+  "$(printf '1\n3')" ] || error
+$CGPT show --fields=label -i 1 -l ${JSON_DEV} >/dev/null 2>&1 && error
+rm -f ${JSON_DEV} ${JSON_DEV}.json
+
+
+echo "Test extra partition types from a types file..."
+TYPES_DEV=types.bin
+cat > types.conf <<EOF
+# name        guid                                  description
+vendor-data   11111111-2222-3333-4444-555555555555  Vendor data
+usr-slot      {5dfbf5f4-2848-4bac-aa5e-0d9a20b745a6}
+bogus line
+EOF
+# an empty types file stands in for the host's, which may list anything
+: > types.none
+$CGPT create -c -s 1000 ${TYPES_DEV} || error
+CGPT_TYPES=types.conf $CGPT add -i 1 -b 100 -s 10 -t vendor-data \
+  ${TYPES_DEV} 2>/dev/null || error
+CGPT_TYPES=types.conf $CGPT add -i 2 -b 200 -s 10 -t usr-slot \
+  ${TYPES_DEV} 2>/dev/null || error
+CGPT_TYPES=types.none $CGPT add -i 3 -b 300 -s 10 -t vendor-data \
+  ${TYPES_DEV} 2>/dev/null && error
+[ "$(CGPT_TYPES=types.conf $CGPT show --fields=type_name ${TYPES_DEV} \
+     2>/dev/null)" == "$(printf 'Vendor data\nAlias for coreos-rootfs')" ] \
+  || error
+[ "$(CGPT_TYPES=types.none $CGPT show --fields=type_name ${TYPES_DEV} \
+     2>/dev/null)" == \
+  "$(printf '11111111-2222-3333-4444-555555555555\nAlias for coreos-rootfs')" ] \
+  || error
+# aliases of a known type keep its meaning, so usr-slot is a root partition
+CGPT_TYPES=types.none $CGPT prioritize -i 2 ${TYPES_DEV} || error
+CGPT_TYPES=types.conf $CGPT show -i 2 ${TYPES_DEV} 2>/dev/null | \
+  grep -q "Attr: priority=1 tries=0 successful=0" || error
+CGPT_TYPES=types.conf $CGPT show -i 1 ${TYPES_DEV} 2>&1 >/dev/null | \
+  grep -q "types.conf:4" || error
+rm -f ${TYPES_DEV} types.conf types.none
+
+
+echo "Test watching an image for changes..."
+WATCH_DEV=watch.bin
+rm -f ${WATCH_DEV} watch.out
+$CGPT create -c -s 1000 ${WATCH_DEV} || error
+timeout 20 $CGPT watch -c 4 ${WATCH_DEV} missing.bin > watch.out &
+WATCH_PID=$!
+for i in $(seq 100); do [ -s watch.out ] && break; sleep 0.1; done
+[ -s watch.out ] || error
+FP1=$($CGPT show --fingerprint ${WATCH_DEV})
+# reading the image, or writing it unchanged, is not an event
+$CGPT show ${WATCH_DEV} >/dev/null || error
+$CGPT add -i 1 -b 100 -s 10 -t data -l A ${WATCH_DEV} || error
+for i in $(seq 100); do [ $(wc -l < watch.out) -ge 2 ] && break; sleep 0.1; done
+FP2=$($CGPT show --fingerprint ${WATCH_DEV})
+$CGPT create -c -s 1000 missing.bin || error
+for i in $(seq 100); do [ $(wc -l < watch.out) -ge 3 ] && break; sleep 0.1; done
+rm -f ${WATCH_DEV}
+wait ${WATCH_PID} || error
+[ "$(cat watch.out)" == \
+  "$(printf '%s\n%s\n%s\n%s' \
+     "{\"event\":\"add\",\"drive\":\"${WATCH_DEV}\",\"fingerprint\":\"$FP1\"}" \
+     "{\"event\":\"change\",\"drive\":\"${WATCH_DEV}\",\"fingerprint\":\"$FP2\"}" \
+     "{\"event\":\"add\",\"drive\":\"missing.bin\",\"fingerprint\":\"$($CGPT show --fingerprint missing.bin)\"}" \
+     "{\"event\":\"remove\",\"drive\":\"${WATCH_DEV}\"}")" ] || error
+rm -f watch.out missing.bin
+
+echo "Test that concurrent changes are not overwritten..."
+LOCK_DEV=lock.bin
+rm -f ${LOCK_DEV} other.bin locked
+$CGPT create -c -s 1000 ${LOCK_DEV} || error
+$CGPT create -c -s 1000 other.bin || error
+# Hold the drive's lock, let another cgpt read the table and wait for the
+# lock, then change the table under it before letting it go.
+( flock 9
+  touch locked
+  for i in $(seq 100); do grep -q -- '->' /proc/locks && break; sleep 0.1; done
+  dd if=other.bin of=${LOCK_DEV} conv=notrunc status=none ) 9<${LOCK_DEV} &
+LOCK_PID=$!
+for i in $(seq 100); do [ -e locked ] && break; sleep 0.1; done
+[ -e locked ] || error
+# readers don't wait for the lock
+timeout 5 $CGPT show ${LOCK_DEV} >/dev/null || error
+RC=0
+timeout 20 $CGPT add -i 1 -b 100 -s 10 -t data ${LOCK_DEV} 2>/dev/null || RC=$?
+wait ${LOCK_PID} || error
+[ ${RC} -eq 3 ] || error
+cmp -s ${LOCK_DEV} other.bin || error
+rm -f ${LOCK_DEV} other.bin locked
+
+
+echo "Test the cgpt audit command..."
+AUDIT=audit.d
+rm -rf ${AUDIT}
+mkdir -p ${AUDIT}/sub
+$CGPT create -c -s 20000 ${AUDIT}/good.bin || error
+$CGPT boot -p ${AUDIT}/good.bin >/dev/null || error
+$CGPT add -i 1 -b 2048 -s 1000 -t efi ${AUDIT}/good.bin || error
+cp ${AUDIT}/good.bin ${AUDIT}/sub/odd.bin
+$CGPT add -i 2 -b 4001 -s 100 -t data ${AUDIT}/sub/odd.bin || error
+cp ${AUDIT}/good.bin ${AUDIT}/sub/broken.bin
+dd if=/dev/zero of=${AUDIT}/sub/broken.bin bs=512 seek=19999 count=1 \
+  conv=notrunc status=none
+echo "not an image" > ${AUDIT}/README
+$CGPT audit -j 2 ${AUDIT} > audit.out && error
+grep -q '"path":"audit.d/good.bin",.*"problems":\[\],"ok":true' audit.out \
+  || error
+grep -q '"path":"audit.d/sub/odd.bin",.*"partition 2 is not aligned' \
+  audit.out || error
+grep '"path":"audit.d/sub/broken.bin",.*"headers":"primary"' audit.out \
+  | grep -q '"secondary header is invalid"' || error
+[ "$(tail -n 1 audit.out)" == \
+  '{"summary":{"images":3,"ok":1,"problems":2,"errors":0,"skipped":1}}' ] \
+  || error
+$CGPT audit -a 1 ${AUDIT}/good.bin ${AUDIT}/sub/odd.bin >/dev/null || error
+$CGPT audit ${AUDIT}/README | grep -q '"error":"too small to hold a GPT"' \
+  || error
+rm -rf ${AUDIT} audit.out
+
+
+echo "Test repairing several drives at once..."
+REP=repair
+rm -f ${REP}.*
+for i in 1 2 3; do
+  $CGPT create -c -s 20000 ${REP}.$i || error
+  $CGPT boot -p ${REP}.$i >/dev/null || error
+  $CGPT add -i 1 -b 2048 -s 100 -t data ${REP}.$i || error
+done
+dd if=/dev/zero of=${REP}.1 bs=512 seek=1 count=1 conv=notrunc status=none
+dd if=/dev/urandom of=${REP}.2 bs=512 seek=19967 count=1 conv=notrunc \
+  status=none
+cp ${REP}.1 ${REP}.orig
+$CGPT repair -n ${REP}.{1,2,3} > repair.out || error
+cmp -s ${REP}.1 ${REP}.orig || error
+grep -qx "${REP}.1: would write primary header, 1 sector at LBA 1" \
+  repair.out || error
+grep -qx "${REP}.2: would write secondary entries, 1 sector at LBA 19967" \
+  repair.out || error
+grep -qx "${REP}.3: nothing to repair" repair.out || error
+$CGPT repair -j 2 ${REP}.{1,2,3} | grep -c "1 sector written$" \
+  | grep -qx 2 || error
+$CGPT repair --dry-run ${REP}.{1,2,3} | grep -c "nothing to repair" \
+  | grep -qx 3 || error
+# A drive without any GPT is left alone.
+truncate -s 1M ${REP}.blank
+$CGPT repair ${REP}.3 ${REP}.blank >/dev/null && error
+[ -z "$(tr -d '\0' < ${REP}.blank)" ] || error
+rm -f ${REP}.* repair.out
+
+
+echo "Test finding the backup header of a drive that grew..."
+GROWN=grown.bin
+rm -f ${GROWN}
+$CGPT create -c -s 20000 ${GROWN} || error
+$CGPT add -i 1 -b 2048 -s 100 -t data -l grown ${GROWN} || error
+truncate -s +3M ${GROWN}
+dd if=/dev/zero of=${GROWN} bs=512 seek=1 count=1 conv=notrunc status=none
+cp ${GROWN} ${GROWN}.orig
+$CGPT repair -n ${GROWN} >/dev/null && error
+$CGPT repair -D -n ${GROWN} \
+  | grep -qx "${GROWN}: Backup header found at LBA 19999." || error
+cmp -s ${GROWN} ${GROWN}.orig || error
+$CGPT repair --discover ${GROWN} >/dev/null || error
+[ "$($CGPT show -i 1 -l ${GROWN})" = "grown" ] || error
+$CGPT show ${GROWN} | grep -q "^ *26143 *1 *Sec GPT header" || error
+$CGPT repair -n ${GROWN} | grep -qx "${GROWN}: nothing to repair" || error
+rm -f ${GROWN} ${GROWN}.orig
+
+
+if ! type mkfs.ext4 mkswap >/dev/null 2>&1; then
+  echo "Skipping cgpt rescue tests (requires mkfs.ext4 and mkswap)"
+else
+  echo "Test rescuing partitions from their filesystems..."
+  RESCUE=rescue
+  rm -f ${RESCUE}.*
+  $CGPT create -c -s 131072 ${RESCUE}.bin || error
+  truncate -s 8M ${RESCUE}.ext4
+  mkfs.ext4 -q -F -L ROOT ${RESCUE}.ext4 || error
+  dd if=${RESCUE}.ext4 of=${RESCUE}.bin bs=512 seek=2048 conv=notrunc,sparse \
+    status=none
+  truncate -s 4M ${RESCUE}.swap
+  mkswap ${RESCUE}.swap >/dev/null 2>&1 || error
+  dd if=${RESCUE}.swap of=${RESCUE}.bin bs=512 seek=40960 conv=notrunc,sparse \
+    status=none
+  # Inside the ext4 filesystem, so not a partition of its own.
+  dd if=${RESCUE}.swap of=${RESCUE}.bin bs=512 seek=8192 count=8 \
+    conv=notrunc status=none
+  $CGPT rescue ${RESCUE}.bin > ${RESCUE}.manifest || error
+  [ "$(grep -v '^#' ${RESCUE}.manifest)" = \
+    "$(printf '%s\n' '1: start=2048 size=16384 type=data label="ROOT"' \
+       '2: start=40960 size=8192 type=linux-swap')" ] || error
+  $CGPT rescue -v -j 1 ${RESCUE}.bin \
+    | grep -q "^# left out swap .*inside the partition before$" || error
+  $CGPT create ${RESCUE}.bin || error
+  $CGPT apply -f ${RESCUE}.manifest ${RESCUE}.bin || error
+  [ "$($CGPT show -i 1 -l ${RESCUE}.bin)" = "ROOT" ] || error
+  [ "$($CGPT show -i 2 -b ${RESCUE}.bin)" = "40960" ] || error
+  # Nothing to find.
+  $CGPT create -c -s 4096 ${RESCUE}.blank || error
+  $CGPT rescue ${RESCUE}.blank >/dev/null 2>&1 && error
+  rm -f ${RESCUE}.*
+fi
+
+
 echo "Set the boot partition.."
 $CGPT boot -i ${KERN_NUM} ${DEV} >/dev/null
 
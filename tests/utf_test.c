@@ -0,0 +1,313 @@
+/* Copyright (c) 2026 CoreOS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <string.h>
+
+#include "utf_test.h"
+#include "cgpt.h"
+#include "cgptlib_test.h"
+#include "test_common.h"
+#include "vboot_host.h"
+
+/* The conversions as they were before the ASCII fast paths, which the
+ * current ones must match exactly, return value and output alike. */
+static int RefUTF16ToUTF8(const uint16_t *utf16, unsigned int maxinput,
+                          uint8_t *utf8, unsigned int maxoutput)
+{
+  size_t s16idx, s8idx;
+  uint32_t code_point = 0;
+  int code_point_ready = 1;  // code point is ready to output.
+  int retval = CGPT_OK;
+
+  if (!utf16 || !maxinput || !utf8 || !maxoutput)
+    return CGPT_FAILED;
+
+  maxoutput--;                             /* plan for termination now */
+
+  for (s16idx = s8idx = 0;
+       s16idx < maxinput && utf16[s16idx] && maxoutput;
+       s16idx++) {
+    uint16_t codeunit = le16toh(utf16[s16idx]);
+
+    if (code_point_ready) {
+      if (codeunit >= 0xD800 && codeunit <= 0xDBFF) {
+        /* high surrogate, need the low surrogate. */
+        code_point_ready = 0;
+        code_point = (codeunit & 0x03FF) + 0x0040;
+      } else {
+        /* BMP char, output it. */
+        code_point = codeunit;
+      }
+    } else {
+      /* expect the low surrogate */
+      if (codeunit >= 0xDC00 && codeunit <= 0xDFFF) {
+        code_point = (code_point << 10) | (codeunit & 0x03FF);
+        code_point_ready = 1;
+      } else {
+        /* the second code unit is NOT the low surrogate. Unexpected. */
+        code_point_ready = 0;
+        retval = CGPT_FAILED;
+        break;
+      }
+    }
+
+    /* If UTF code point is ready, output it. */
+    if (code_point_ready) {
+      require(code_point <= 0x10FFFF);
+      if (code_point <= 0x7F && maxoutput >= 1) {
+        maxoutput -= 1;
+        utf8[s8idx++] = code_point & 0x7F;
+      } else if (code_point <= 0x7FF && maxoutput >= 2) {
+        maxoutput -= 2;
+        utf8[s8idx++] = 0xC0 | (code_point >> 6);
+        utf8[s8idx++] = 0x80 | (code_point & 0x3F);
+      } else if (code_point <= 0xFFFF && maxoutput >= 3) {
+        maxoutput -= 3;
+        utf8[s8idx++] = 0xE0 | (code_point >> 12);
+        utf8[s8idx++] = 0x80 | ((code_point >> 6) & 0x3F);
+        utf8[s8idx++] = 0x80 | (code_point & 0x3F);
+      } else if (code_point <= 0x10FFFF && maxoutput >= 4) {
+        maxoutput -= 4;
+        utf8[s8idx++] = 0xF0 | (code_point >> 18);
+        utf8[s8idx++] = 0x80 | ((code_point >> 12) & 0x3F);
+        utf8[s8idx++] = 0x80 | ((code_point >> 6) & 0x3F);
+        utf8[s8idx++] = 0x80 | (code_point & 0x3F);
+      } else {
+        /* buffer underrun */
+        retval = CGPT_FAILED;
+        break;
+      }
+    }
+  }
+  utf8[s8idx++] = 0;
+  return retval;
+}
+
+static int RefUTF8ToUTF16(const uint8_t *utf8, uint16_t *utf16,
+                          unsigned int maxoutput)
+{
+  size_t s16idx, s8idx;
+  uint32_t code_point = 0;
+  unsigned int expected_units = 1;
+  unsigned int decoded_units = 1;
+  int retval = CGPT_OK;
+
+  if (!utf8 || !utf16 || !maxoutput)
+    return CGPT_FAILED;
+
+  maxoutput--;                             /* plan for termination */
+
+  for (s8idx = s16idx = 0;
+       utf8[s8idx] && maxoutput;
+       s8idx++) {
+    uint8_t code_unit;
+    code_unit = utf8[s8idx];
+
+    if (expected_units != decoded_units) {
+      /* Trailing bytes of multi-byte character */
+      if ((code_unit & 0xC0) == 0x80) {
+        code_point = (code_point << 6) | (code_unit & 0x3F);
+        ++decoded_units;
+      } else {
+        /* Unexpected code unit. */
+        retval = CGPT_FAILED;
+        break;
+      }
+    } else {
+      /* parsing a new code point. */
+      decoded_units = 1;
+      if (code_unit <= 0x7F) {
+        code_point = code_unit;
+        expected_units = 1;
+      } else if (code_unit <= 0xBF) {
+        /* 0x80-0xBF must NOT be the heading byte unit of a new code point. */
+        retval = CGPT_FAILED;
+        break;
+      } else if (code_unit >= 0xC2 && code_unit <= 0xDF) {
+        code_point = code_unit & 0x1F;
+        expected_units = 2;
+      } else if (code_unit >= 0xE0 && code_unit <= 0xEF) {
+        code_point = code_unit & 0x0F;
+        expected_units = 3;
+      } else if (code_unit >= 0xF0 && code_unit <= 0xF4) {
+        code_point = code_unit & 0x07;
+        expected_units = 4;
+      } else {
+        /* illegal code unit: 0xC0-0xC1, 0xF5-0xFF */
+        retval = CGPT_FAILED;
+        break;
+      }
+    }
+
+    /* If no more unit is needed, output the UTF16 unit(s). */
+    if ((retval == CGPT_OK) &&
+        (expected_units == decoded_units)) {
+      /* Check if the encoding is the shortest possible UTF-8 sequence. */
+      switch (expected_units) {
+        case 2:
+          if (code_point <= 0x7F) retval = CGPT_FAILED;
+          break;
+        case 3:
+          if (code_point <= 0x7FF) retval = CGPT_FAILED;
+          break;
+        case 4:
+          if (code_point <= 0xFFFF) retval = CGPT_FAILED;
+          break;
+      }
+      if (retval == CGPT_FAILED) break;  /* leave immediately */
+
+      if ((code_point <= 0xD7FF) ||
+          (code_point >= 0xE000 && code_point <= 0xFFFF)) {
+        utf16[s16idx++] = code_point;
+        maxoutput -= 1;
+      } else if (code_point >= 0x10000 && code_point <= 0x10FFFF &&
+                 maxoutput >= 2) {
+        utf16[s16idx++] = 0xD800 | ((code_point >> 10) - 0x0040);
+        utf16[s16idx++] = 0xDC00 | (code_point & 0x03FF);
+        maxoutput -= 2;
+      } else {
+        /* Three possibilities fall into here. Both are failure cases.
+         *   a. surrogate pair (non-BMP characters; 0xD800~0xDFFF)
+         *   b. invalid code point > 0x10FFFF
+         *   c. buffer underrun
+         */
+        retval = CGPT_FAILED;
+        break;
+      }
+    }
+  }
+
+  /* A null-terminator shows up before the UTF8 sequence ends. */
+  if (expected_units != decoded_units) {
+    retval = CGPT_FAILED;
+  }
+
+  utf16[s16idx++] = 0;
+  return retval;
+}
+
+#define NAME_UNITS 36
+
+/* Convert with both versions into identically filled buffers and compare
+ * everything, including what lies past the terminator. */
+static int SameUTF16ToUTF8(const uint16_t *utf16, unsigned int maxinput,
+                           unsigned int maxoutput) {
+  uint8_t got[NAME_UNITS * 4 + 8], want[NAME_UNITS * 4 + 8];
+
+  memset(got, 0xee, sizeof(got));
+  memset(want, 0xee, sizeof(want));
+  return UTF16ToUTF8(utf16, maxinput, got, maxoutput) ==
+         RefUTF16ToUTF8(utf16, maxinput, want, maxoutput) &&
+         !memcmp(got, want, sizeof(got));
+}
+
+static int SameUTF8ToUTF16(const uint8_t *utf8, unsigned int maxoutput) {
+  uint16_t got[NAME_UNITS * 2 + 8], want[NAME_UNITS * 2 + 8];
+
+  memset(got, 0xee, sizeof(got));
+  memset(want, 0xee, sizeof(want));
+  return UTF8ToUTF16(utf8, got, maxoutput) ==
+         RefUTF8ToUTF16(utf8, want, maxoutput) &&
+         !memcmp(got, want, sizeof(got));
+}
+
+static void FillAscii(uint16_t *name, unsigned int count) {
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    name[i] = htole16('A' + i % 26);
+}
+
+int TestUTF16ToUTF8() {
+  uint16_t name[NAME_UNITS];
+  unsigned int pos, unit, hi, lo, maxinput, maxoutput;
+
+  /* Every code unit at every position of an otherwise ASCII name. */
+  for (pos = 0; pos < NAME_UNITS; pos++) {
+    FillAscii(name, NAME_UNITS);
+    for (unit = 0; unit <= 0xffff; unit++) {
+      name[pos] = htole16(unit);
+      EXPECT(SameUTF16ToUTF8(name, NAME_UNITS, sizeof(name) * 2 + 1));
+    }
+  }
+
+  /* Every surrogate pair, and the first and last high surrogates followed
+   * by anything. */
+  FillAscii(name, NAME_UNITS);
+  for (hi = 0xd800; hi <= 0xdbff; hi++) {
+    name[5] = htole16(hi);
+    for (lo = 0; lo <= 0xffff; lo++) {
+      if ((lo < 0xdc00 || lo > 0xdfff) && hi != 0xd800 && hi != 0xdbff)
+        continue;
+      name[6] = htole16(lo);
+      EXPECT(SameUTF16ToUTF8(name, NAME_UNITS, sizeof(name) * 2 + 1));
+    }
+  }
+
+  /* Every input and output limit, with the name ending anywhere. */
+  for (pos = 0; pos <= NAME_UNITS; pos++) {
+    FillAscii(name, NAME_UNITS);
+    if (pos < NAME_UNITS)
+      name[pos] = 0;
+    for (maxinput = 0; maxinput <= NAME_UNITS; maxinput++)
+      for (maxoutput = 0; maxoutput <= sizeof(name) * 2 + 1; maxoutput++)
+        EXPECT(SameUTF16ToUTF8(name, maxinput, maxoutput));
+    if (pos < NAME_UNITS) {
+      name[pos] = htole16(0x20ac);
+      for (maxoutput = 0; maxoutput <= sizeof(name) * 2 + 1; maxoutput++)
+        EXPECT(SameUTF16ToUTF8(name, NAME_UNITS, maxoutput));
+    }
+  }
+  return TEST_OK;
+}
+
+int TestUTF8ToUTF16() {
+  uint8_t label[NAME_UNITS + 8];
+  unsigned int pos, a, b, c, d, maxoutput;
+
+  /* Every one and two byte sequence at every position. */
+  for (pos = 0; pos + 2 < sizeof(label); pos++) {
+    memset(label, 'a', sizeof(label) - 1);
+    label[sizeof(label) - 1] = 0;
+    for (a = 0; a <= 0xff; a++) {
+      label[pos] = a;
+      for (b = 0; b <= 0xff; b++) {
+        label[pos + 1] = b;
+        EXPECT(SameUTF8ToUTF16(label, NAME_UNITS + 1));
+      }
+    }
+  }
+
+  /* Every three byte sequence, and four byte ones with valid leads. */
+  memset(label, 'a', sizeof(label) - 1);
+  label[sizeof(label) - 1] = 0;
+  for (a = 0x80; a <= 0xff; a++) {
+    label[9] = a;
+    for (b = 0; b <= 0xff; b++) {
+      label[10] = b;
+      for (c = 0; c <= 0xff; c++) {
+        label[11] = c;
+        label[12] = 'a';
+        EXPECT(SameUTF8ToUTF16(label, NAME_UNITS + 1));
+        if (a < 0xf0 || a > 0xf4 || (b & 0xc0) != 0x80)
+          continue;
+        for (d = 0; d <= 0xff; d += 0x11) {
+          label[12] = d;
+          EXPECT(SameUTF8ToUTF16(label, NAME_UNITS + 1));
+        }
+      }
+    }
+  }
+
+  /* Every output limit, with the label ending anywhere. */
+  for (pos = 0; pos < sizeof(label); pos++) {
+    memset(label, 'a', sizeof(label) - 1);
+    label[pos] = 0;
+    label[sizeof(label) - 1] = 0;
+    for (maxoutput = 0; maxoutput <= NAME_UNITS + 8; maxoutput++)
+      EXPECT(SameUTF8ToUTF16(label, maxoutput));
+  }
+  return TEST_OK;
+}
@@ -0,0 +1,11 @@
+/* Copyright (c) 2026 CoreOS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+#ifndef VBOOT_REFERENCE_UTF_TEST_H_
+#define VBOOT_REFERENCE_UTF_TEST_H_
+
+int TestUTF16ToUTF8();
+int TestUTF8ToUTF16();
+
+#endif  /* VBOOT_REFERENCE_UTF_TEST_H_ */